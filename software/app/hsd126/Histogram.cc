@@ -1,8 +1,27 @@
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 #include "Histogram.hh"
 
 using namespace HSD;
 
+namespace {
+  //  Header of a binary snapshot; the counts follow, overflow last
+  class SnapshotHeader {
+  public:
+    enum { Magic = 0x48534448 };  // "HSDH"
+    uint32_t magic;
+    uint16_t version;
+    uint8_t  size;
+    uint8_t  subBits;
+    uint32_t bins;
+    uint32_t reserved;
+  };
+}
+
+//  Padding after each shard so that no two shards share a cache line
+static const unsigned PAD = 8;
+
 /*
 ** ++
 **
@@ -11,31 +30,45 @@ using namespace HSD;
 ** --
 */
 
-Histogram::Histogram(unsigned size, double unitsCvt)
+Histogram::Histogram(unsigned size, double unitsCvt) :
+  _size    (size),
+  _subBits (size),
+  _bins    (1U << size),
+  _unitsCvt(unitsCvt)
   {
-  unsigned remaining = 1 << size;
-
-  _buffer   = new unsigned[remaining];
-  _size     = remaining;
-  _mask     = remaining - 1;
-  _unitsCvt = unitsCvt;
-
+  for(unsigned i=0; i<MaxShards; i++)
+    _shards[i].store(0, std::memory_order_relaxed);
   reset();
   }
 
+Histogram::Histogram(unsigned size, double unitsCvt, unsigned subBits) :
+  _size    (size),
+  _subBits (subBits < size ? subBits : size),
+  _bins    ((_size - _subBits + 1) << _subBits),
+  _unitsCvt(unitsCvt)
+  {
+  for(unsigned i=0; i<MaxShards; i++)
+    _shards[i].store(0, std::memory_order_relaxed);
+  reset();
+  }
 
 /*
 ** ++
 **
+**    Racing with bump() only loses the counts of the moment.
 **
 ** --
 */
 
 void Histogram::reset()
   {
-  unsigned  remaining = _size;
-  unsigned* next      = _buffer;
-  do *next++ = 0; while(--remaining);
+  for(unsigned i=0; i<MaxShards; i++)
+    {
+    Counter* s = _shards[i].load(std::memory_order_acquire);
+    if (s)
+      for(unsigned b=0; b<=_bins; b++)
+        s[b].store(0, std::memory_order_relaxed);
+    }
 
   _totalWeight = 0.0;
   _totalCounts = 0.0;
@@ -44,50 +77,230 @@ void Histogram::reset()
 /*
 ** ++
 **
-**    Bump the bin for each client represented by the input argument.
-**    This argument is a bit-list of the clients whose entry are to be
-**    incremented.
 **
 ** --
 */
 
-void Histogram::sum()
+Histogram::Counter* Histogram::_allocate(unsigned slot)
+  {
+  Counter* s = new Counter[_bins+1+PAD];
+  for(unsigned b=0; b<=_bins; b++)
+    s[b].store(0, std::memory_order_relaxed);
+  Counter* expected = 0;
+  if (!_shards[slot].compare_exchange_strong(expected, s,
+                                             std::memory_order_acq_rel))
+    {
+    //  Another thread in the same slot got there first
+    delete[] s;
+    s = expected;
+    }
+  return s;
+  }
+
+/*
+** ++
+**
+**    Sum of the shards, overflow in the last entry.
+**
+** --
+*/
+
+void Histogram::_collect(uint64_t* bins) const
+  {
+  memset(bins, 0, (_bins+1)*sizeof(uint64_t));
+  for(unsigned i=0; i<MaxShards; i++)
+    {
+    const Counter* s = _shards[i].load(std::memory_order_acquire);
+    if (s)
+      for(unsigned b=0; b<=_bins; b++)
+        bins[b] += s[b].load(std::memory_order_relaxed);
+    }
+  }
+
+/*
+** ++
+**
+**
+** --
+*/
+
+uint64_t Histogram::lower(unsigned bin) const
+  {
+  if (bin >> _subBits == 0)
+    return bin;
+  unsigned k   = bin - (1U << _subBits);
+  unsigned e   = _subBits + (k >> _subBits);
+  uint64_t sub = k & ((1U << _subBits) - 1);
+  return ((1ULL << _subBits) + sub) << (e - _subBits);
+  }
+
+uint64_t Histogram::width(unsigned bin) const
+  {
+  if (bin >> _subBits == 0)
+    return 1;
+  unsigned k = bin - (1U << _subBits);
+  return 1ULL << (k >> _subBits);
+  }
+
+uint64_t Histogram::overflows() const
   {
-  unsigned  remaining   = _size;
-  unsigned* next        = &_buffer[remaining];
-  double    totalWeight = 0;
-  double    totalCounts = 0;
+  std::vector<uint64_t> bins(_bins+1);
+  _collect(bins.data());
+  return bins[_bins];
+  }
 
-  remaining--;
+/*
+** ++
+**
+**    Totals of the bins in range, each count weighted by the center
+**    of its bin.
+**
+** --
+*/
+
+void Histogram::sum()
+  {
+  std::vector<uint64_t> bins(_bins+1);
+  _collect(bins.data());
 
-  do
+  double totalWeight = 0;
+  double totalCounts = 0;
+  for(unsigned b=0; b<_bins; b++)
     {
-    double counts = (double) *--next;
-    totalWeight += counts*(double)remaining;
+    double counts = (double) bins[b];
+    totalWeight += counts*(double(lower(b)) + 0.5*double(width(b)-1));
     totalCounts += counts;
     }
-  while(--remaining);
 
   _totalWeight = totalWeight;
   _totalCounts = totalCounts;
   }
 
+double Histogram::mean() const
+  {
+  const_cast<Histogram*>(this)->sum();
+  return _totalCounts > 0 ? _unitsCvt*_totalWeight/_totalCounts : 0;
+  }
+
 /*
 ** ++
 **
-**    Bump the bin for each client represented by the input argument.
-**    This argument is a bit-list of the clients whose entry are to be
-**    incremented.
+**    Overflows count toward the total; a quantile that falls among
+**    them is reported as the top of the range.
 **
 ** --
 */
 
-void Histogram::dump(char* fileSpec)
+double Histogram::quantile(double q) const
+  {
+  std::vector<uint64_t> bins(_bins+1);
+  _collect(bins.data());
+
+  uint64_t total = 0;
+  for(unsigned b=0; b<=_bins; b++)
+    total += bins[b];
+  if (!total)
+    return 0;
+
+  double   target = q*double(total);
+  uint64_t below  = 0;
+  for(unsigned b=0; b<_bins; b++)
+    {
+    if (double(below + bins[b]) >= target && bins[b])
+      {
+      //  Interpolate within the bin
+      double f = (target - double(below))/double(bins[b]);
+      if (f < 0) f = 0;
+      return _unitsCvt*(double(lower(b)) + f*double(width(b)-1));
+      }
+    below += bins[b];
+    }
+  return _unitsCvt*double(lower(_bins));
+  }
+
+/*
+** ++
+**
+**
+** --
+*/
+
+size_t Histogram::snapshotSize() const
   {
-  unsigned  remaining   = _size;
-  unsigned* next        = &_buffer[remaining];
+  return sizeof(SnapshotHeader) + (_bins+1)*sizeof(uint64_t);
+  }
 
-  remaining--;
+size_t Histogram::snapshot(void* buffer, size_t len) const
+  {
+  if (len < snapshotSize())
+    return 0;
+  SnapshotHeader* h = reinterpret_cast<SnapshotHeader*>(buffer);
+  h->magic    = SnapshotHeader::Magic;
+  h->version  = 1;
+  h->size     = _size;
+  h->subBits  = _subBits;
+  h->bins     = _bins;
+  h->reserved = 0;
+  _collect(reinterpret_cast<uint64_t*>(h+1));
+  return snapshotSize();
+  }
+
+bool Histogram::merge(const void* buffer, size_t len)
+  {
+  const SnapshotHeader* h = reinterpret_cast<const SnapshotHeader*>(buffer);
+  if (len < sizeof(*h) ||
+      h->magic   != SnapshotHeader::Magic ||
+      h->version != 1 ||
+      h->size    != _size ||
+      h->subBits != _subBits ||
+      h->bins    != _bins ||
+      len < snapshotSize())
+    {
+    printf ("Histogram::merge: snapshot does not match the binning\n");
+    return false;
+    }
+
+  const uint64_t* bins = reinterpret_cast<const uint64_t*>(h+1);
+  Counter* s = _shard();
+  for(unsigned b=0; b<=_bins; b++)
+    if (bins[b])
+      s[b].fetch_add(bins[b], std::memory_order_relaxed);
+  return true;
+  }
+
+Histogram* Histogram::create(const void* buffer, size_t len, double unitsCvt)
+  {
+  const SnapshotHeader* h = reinterpret_cast<const SnapshotHeader*>(buffer);
+  if (len < sizeof(*h) || h->magic != SnapshotHeader::Magic)
+    return 0;
+  Histogram* o = new Histogram(h->size, unitsCvt, h->subBits);
+  if (!o->merge(buffer, len))
+    {
+    delete o;
+    return 0;
+    }
+  return o;
+  }
+
+bool Histogram::merge(const Histogram& o)
+  {
+  std::vector<char> buffer(o.snapshotSize());
+  o.snapshot(buffer.data(), buffer.size());
+  return merge(buffer.data(), buffer.size());
+  }
+
+/*
+** ++
+**
+**    Non-empty bins as "value count", from the highest bin down.
+**
+** --
+*/
+
+void Histogram::dump(char* fileSpec)
+  {
+  std::vector<uint64_t> bins(_bins+1);
+  _collect(bins.data());
 
   FILE* file = fopen (fileSpec, "w");
   if (!file)
@@ -96,15 +309,16 @@ void Histogram::dump(char* fileSpec)
     return;
     }
 
-  do
+  unsigned remaining = _bins;
+  while(remaining--)
     {
-    unsigned counts = *--next;
+    uint64_t counts = bins[remaining];
     if (counts)
       {
-      fprintf (file, "%f %u\n", (float) remaining * _unitsCvt, counts);
+      fprintf (file, "%f %llu\n", (float) lower(remaining) * _unitsCvt,
+               (unsigned long long)counts);
       }
     }
-  while(remaining--);
 
   if (fclose(file) == -1)
     {
@@ -114,12 +328,25 @@ void Histogram::dump(char* fileSpec)
 
 void Histogram::dump() const
 {
-  printf("_size [%u]\n",_size);
-  for(unsigned i=0; i<_size; i++)
-    printf("%10u%c", _buffer[i], (i%10)==9 ? '\n':' ');
+  std::vector<uint64_t> bins(_bins+1);
+  _collect(bins.data());
+
+  printf("_size [%u]\n",_bins);
+  if (_subBits == _size) {
+    for(unsigned i=0; i<_bins; i++)
+      printf("%10llu%c", (unsigned long long)bins[i], (i%10)==9 ? '\n':' ');
+  }
+  else {
+    unsigned n=0;
+    for(unsigned i=0; i<_bins; i++)
+      if (bins[i])
+        printf("%10llu:%-10llu%c", (unsigned long long)lower(i),
+               (unsigned long long)bins[i], (++n%5)==0 ? '\n':' ');
+  }
   printf("\n------------\n");
-  const_cast<Histogram*>(this)->sum();
-  printf("mean %f\n",_totalWeight/_totalCounts);
+  printf("mean %f  p50 %f  p90 %f  p99 %f  overflow %llu\n",
+         mean(), quantile(0.5), quantile(0.9), quantile(0.99),
+         (unsigned long long)bins[_bins]);
 }
 
 /*
@@ -131,5 +358,6 @@ void Histogram::dump() const
 
 Histogram::~Histogram()
   {
-  delete[] _buffer;
+  for(unsigned i=0; i<MaxShards; i++)
+    delete[] _shards[i].load(std::memory_order_relaxed);
   }
@@ -0,0 +1,287 @@
+#include "Metrics.hh"
+#include "Histogram.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+using namespace Pds::HSD;
+
+class Metrics::Header {
+public:
+  enum { Magic = 0x4853444d, Version = 1 };  // "HSDM"
+  uint32_t              magic;
+  uint32_t              version;
+  uint32_t              capacity;
+  std::atomic<uint32_t> count;      // entries registered
+  uint64_t              arenaSize;  // histogram snapshots
+  uint64_t              arenaUsed;
+  int32_t               pid;
+  uint32_t              reserved[7];
+};
+
+class alignas(64) Metrics::Entry {
+public:
+  std::atomic<int64_t>  value;
+  std::atomic<uint64_t> seq;        // histograms: odd while updating
+  uint32_t              type;
+  int32_t               lane;
+  uint32_t              offset;     // histograms: snapshot in the arena
+  uint32_t              length;
+  char                  name[32];
+};
+
+static double _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return double(tv.tv_sec) + 1.e-9*double(tv.tv_nsec);
+}
+
+static std::string _shmPath(const char* name)
+{
+  return name[0]=='/' ? std::string(name) : std::string("/")+name;
+}
+
+Metrics::Metrics() :
+  _header  (0),
+  _entries (0),
+  _arena   (0),
+  _size    (0),
+  _fd      (-1),
+  _owner   (false),
+  _lastTime(_now())
+{
+}
+
+Metrics::Metrics(const char* shmName,
+                 unsigned    capacity,
+                 size_t      histBytes) :
+  _header  (0),
+  _entries (0),
+  _arena   (0),
+  _fd      (-1),
+  _owner   (true),
+  _lastTime(_now())
+{
+  _size = sizeof(Header) + capacity*sizeof(Entry) + histBytes;
+
+  void* p = MAP_FAILED;
+  if (shmName) {
+    std::string path = _shmPath(shmName);
+    _fd = shm_open(path.c_str(), O_CREAT|O_RDWR, 0644);
+    if (_fd < 0)
+      perror(path.c_str());
+    else if (ftruncate(_fd, _size)) {
+      perror("Metrics ftruncate");
+      close(_fd);
+      _fd = -1;
+    }
+    else
+      p = mmap(0, _size, PROT_READ|PROT_WRITE, MAP_SHARED, _fd, 0);
+  }
+  if (p == MAP_FAILED)
+    p = mmap(0, _size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    perror("Metrics mmap");
+    _size = 0;
+    return;
+  }
+
+  memset(p, 0, _size);
+  _header  = reinterpret_cast<Header*>(p);
+  _entries = reinterpret_cast<Entry*>(_header+1);
+  _arena   = reinterpret_cast<char*>(_entries+capacity);
+  _header->version   = Header::Version;
+  _header->capacity  = capacity;
+  _header->arenaSize = histBytes;
+  _header->pid       = getpid();
+  _header->count.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _header->magic     = Header::Magic;
+
+  if (_fd >= 0)
+    _name = _shmPath(shmName);
+}
+
+Metrics* Metrics::attach(const char* shmName)
+{
+  std::string path = _shmPath(shmName);
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    perror(path.c_str());
+    return 0;
+  }
+  struct stat st;
+  void* p = MAP_FAILED;
+  if (fstat(fd, &st)==0 && size_t(st.st_size) >= sizeof(Header))
+    p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    printf("Metrics: cannot map %s\n", path.c_str());
+    close(fd);
+    return 0;
+  }
+
+  Header* h = reinterpret_cast<Header*>(p);
+  if (h->magic != Header::Magic || h->version != Header::Version) {
+    printf("Metrics: %s is not a metrics segment\n", path.c_str());
+    munmap(p, st.st_size);
+    close(fd);
+    return 0;
+  }
+
+  Metrics* m  = new Metrics;
+  m->_header  = h;
+  m->_entries = reinterpret_cast<Entry*>(h+1);
+  m->_arena   = reinterpret_cast<char*>(m->_entries+h->capacity);
+  m->_size    = st.st_size;
+  m->_fd      = fd;
+  return m;
+}
+
+Metrics::~Metrics()
+{
+  if (_header)
+    munmap(_header, _size);
+  if (_fd >= 0) {
+    close(_fd);
+    if (_owner)
+      shm_unlink(_name.c_str());
+  }
+}
+
+Metrics::Entry* Metrics::_add(const char* name, int lane, Type type)
+{
+  unsigned n = _header ? _header->count.load(std::memory_order_relaxed) : 0;
+  if (!_header || !_owner || n == _header->capacity) {
+    printf("Metrics: no room for %s\n", name);
+    //  Updates go nowhere rather than fault
+    static Entry _dummy;
+    return &_dummy;
+  }
+  Entry* e = &_entries[n];
+  strncpy(e->name, name, sizeof(e->name)-1);
+  e->type = type;
+  e->lane = lane;
+  e->value.store(0, std::memory_order_relaxed);
+  e->seq  .store(0, std::memory_order_relaxed);
+  _header->count.store(n+1, std::memory_order_release);
+  return e;
+}
+
+Metrics::Counter Metrics::counter(const char* name, int lane)
+{
+  Counter c;
+  c._v = &_add(name, lane, CounterType)->value;
+  return c;
+}
+
+Metrics::Gauge Metrics::gauge(const char* name, int lane)
+{
+  Gauge g;
+  g._v = &_add(name, lane, GaugeType)->value;
+  return g;
+}
+
+void Metrics::histogram(const char* name, ::HSD::Histogram* h, int lane)
+{
+  size_t len = (h->snapshotSize()+7) & ~size_t(7);
+  if (_header && _header->arenaUsed + len > _header->arenaSize) {
+    printf("Metrics: no room for histogram %s\n", name);
+    return;
+  }
+  Entry* e = _add(name, lane, HistogramType);
+  if (!_header || e != &_entries[_header->count.load()-1])
+    return;
+  e->offset = _header->arenaUsed;
+  e->length = h->snapshotSize();
+  _header->arenaUsed += len;
+
+  unsigned i = e - _entries;
+  if (_histos.size() <= i)
+    _histos.resize(i+1, 0);
+  _histos[i] = h;
+}
+
+//
+//  Histogram snapshots are updated under a sequence count; a reader
+//  retries if the count changed (or was odd) while it copied.
+//
+void Metrics::publish()
+{
+  for(unsigned i=0; i<_histos.size(); i++) {
+    if (!_histos[i])
+      continue;
+    Entry& e = _entries[i];
+    uint64_t s = e.seq.load(std::memory_order_relaxed);
+    e.seq.store(s+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _histos[i]->snapshot(_arena + e.offset, e.length);
+    e.seq.store(s+2, std::memory_order_release);
+  }
+}
+
+void Metrics::dump()
+{
+  if (!_header)
+    return;
+
+  double t  = _now();
+  double dt = t - _lastTime;
+  _lastTime = t;
+
+  unsigned n = _header->count.load(std::memory_order_acquire);
+  if (_last.size() < n)
+    _last.resize(n, 0);
+
+  std::vector<char> buff;
+  for(unsigned i=0; i<n; i++) {
+    const Entry& e = _entries[i];
+    char name[48];
+    if (e.lane < 0)
+      snprintf(name, sizeof(name), "%.32s", e.name);
+    else
+      snprintf(name, sizeof(name), "%.32s[%d]", e.name, e.lane);
+
+    switch(e.type) {
+    case CounterType:
+      { int64_t v = e.value.load(std::memory_order_relaxed);
+        printf("  %-24.24s %14lld  %+12lld  %12.1f /s\n", name,
+               (long long)v, (long long)(v-_last[i]),
+               dt > 0 ? double(v-_last[i])/dt : 0.);
+        _last[i] = v; }
+      break;
+    case GaugeType:
+      printf("  %-24.24s %14lld\n", name,
+             (long long)e.value.load(std::memory_order_relaxed));
+      break;
+    case HistogramType:
+      { buff.resize(e.length);
+        uint64_t s0, s1;
+        unsigned tries = 0;
+        do {
+          s0 = e.seq.load(std::memory_order_acquire);
+          memcpy(buff.data(), _arena + e.offset, e.length);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          s1 = e.seq.load(std::memory_order_relaxed);
+        } while(((s0&1) || s0!=s1) && ++tries < 1000);
+        ::HSD::Histogram* h = ::HSD::Histogram::create(buff.data(), buff.size());
+        if (!h)
+          break;
+        h->sum();
+        printf("  %-24.24s %14.0f  p50 %g  p99 %g  p999 %g  over %llu\n", name,
+               h->counts(), h->quantile(0.5), h->quantile(0.99), h->quantile(0.999),
+               (unsigned long long)h->overflows());
+        delete h; }
+      break;
+    default:
+      break;
+    }
+  }
+}
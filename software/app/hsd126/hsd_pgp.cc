@@ -19,6 +19,7 @@
 #include "TprCore.hh"
 #include "FexCfg.hh"
 #include "Pgp2bAxi.hh"
+#include "Metrics.hh"
 
 #include <string>
 #include <vector>
@@ -27,34 +28,46 @@ extern int optind;
 
 using namespace Pds::HSD;
 
+//
+//  DMA counters of the card, accumulated into the metrics registry
+//  from the differences of its 32-bit registers
+//
 class DmaStats {
 public:
-  DmaStats() : _values(4) {
-    for(unsigned i=0; i<_values.size(); i++)
-      _values[i]=0;
+  void init(Metrics& m, const QABase& base) {
+    _base = &base;
+    for(unsigned i=0; i<3; i++) {
+      _values[i] = m.counter(names()[i]);
+      _last  [i] = _read(i);
+    }
   }
-  DmaStats(const QABase& o) : _values(4) {
-    frameCount   () = o.countEnable;
-    pauseCount   () = o.countInhibit;
+  void update() {
+    for(unsigned i=0; i<3; i++) {
+      unsigned v = _read(i);
+      _values[i].add(v - _last[i]);
+      _last  [i] = v;
+    }
   }
-
 public:
   static const char** names();
-  std::vector<unsigned> values() const { return _values; }
-public:
-  unsigned& frameCount   () { return _values[0]; }
-  unsigned& pauseCount   () { return _values[1]; }
-  unsigned& overflowCount() { return _values[2]; }
-  unsigned& idleCount    () { return _values[3]; }
 private:
-  std::vector<unsigned> _values;
+  unsigned _read(unsigned i) const {
+    switch(i) {
+    case 0 : return _base->countAcquire;
+    case 1 : return _base->countEnable;
+    default: return _base->countInhibit;
+    }
+  }
+private:
+  const QABase*    _base;
+  Metrics::Counter _values[3];
+  unsigned         _last  [3];
 };  
 
 const char** DmaStats::names() {
-  static const char* _names[] = {"frameCount",
-                                 "pauseCount",
-                                 "overflowCount",
-                                 "idleCount" };
+  static const char* _names[] = {"acquireCount",
+                                 "frameCount",
+                                 "pauseCount" };
   return _names;
 }
 
@@ -148,40 +161,16 @@ private:
   QABase& _base;
 };
 
-template <class T> class RateMonitor {
-public:
-  RateMonitor() {}
-  RateMonitor(const T& o) {
-    clock_gettime(CLOCK_REALTIME,&tv);
-    _t = o;
-  }
-  RateMonitor<T>& operator=(const RateMonitor<T>& o) {
-    tv = o.tv;
-    _t = o._t;
-    return *this;
-  }
-public:
-  void dump(const RateMonitor<T>& o) {
-    double dt = double(o.tv.tv_sec-tv.tv_sec)+1.e-9*(double(o.tv.tv_nsec)-double(tv.tv_nsec));
-    for(unsigned i=0; i<_t.values().size(); i++)
-      printf("%10u %15.15s [%10u] : %g\n",
-             _t.values()[i],
-             _t.names()[i],
-             o._t.values()[i]-_t.values()[i],
-             double(o._t.values()[i]-_t.values()[i])/dt);
-  }
-private:
-  timespec tv;
-  T _t;
-};
-
-static Module* reg=0;
+static Module*  reg=0;
+static Metrics* metrics=0;
 
 void sigHandler( int signal ) {
   if (reg) {
     reg->stop();
     reinterpret_cast<QABase*>((char*)reg->reg()+0x80000)->dump();
   }
+  //  Removes the shared memory segment
+  delete metrics;
 
   ::exit(signal);
 }
@@ -197,6 +186,7 @@ void usage(const char* p) {
   printf("         -t <testpattern>\n");
   printf("         -R (reset)\n");
   printf("         -L (flip loopback settings)\n");
+  printf("         -m <name> (export the counters to shared memory segment <name>)\n");
 }
 
 int main(int argc, char** argv) {
@@ -215,8 +205,9 @@ int main(int argc, char** argv) {
   int  length  = 32;
   unsigned channelMask = 0xf;
   unsigned streamMask  = 0x3;
+  const char* metricsName = 0;
 
-  while ( (c=getopt( argc, argv, "c:s:d:r:l:p:t:LRh")) != EOF ) {
+  while ( (c=getopt( argc, argv, "c:s:d:r:l:p:t:m:LRh")) != EOF ) {
     switch(c) {
     case 'c':
       channelMask = strtoul(optarg,&endptr,0);
@@ -245,6 +236,9 @@ int main(int argc, char** argv) {
     case 'R':
       lReset = true;
       break;
+    case 'm':
+      metricsName = optarg;
+      break;
     case '?':
     default:
       lUsage = true;
@@ -351,14 +345,13 @@ int main(int argc, char** argv) {
   reg = p;
   ::signal( SIGINT, sigHandler );
 
-  DmaStats d;
-  RateMonitor<DmaStats> dstats(d);
-  unsigned och0  =0;
-  unsigned otot  =0;
-
   const QABase& base = *reinterpret_cast<QABase*>(reinterpret_cast<uint32_t*>(p->reg())+0x20000);
   { base.dump(); }
 
+  metrics = new Metrics(metricsName);
+  DmaStats dmaStats;
+  dmaStats.init(*metrics, base);
+
   PgpStats pgp(*p, channelMask);
   FexStats fexs(*p, channelMask, streamMask);
   CacheDump cache(*p);
@@ -371,17 +364,9 @@ int main(int argc, char** argv) {
     printf("--------------\n");
 
 
-    { unsigned uch0 = base.countAcquire;
-      unsigned utot = base.countEnable;
-      printf("eventCount: %08x:%08x [%d:%d]\n",uch0,utot,uch0-och0,utot-otot);
-      och0 = uch0;
-      otot = utot;
-    }
-
-    { DmaStats d(base);
-      RateMonitor<DmaStats> dmaStats(d);
-      dstats.dump(dmaStats);
-      dstats = dmaStats; }
+    dmaStats.update();
+    metrics->publish();
+    metrics->dump();
 
     pgp.dump();
     fexs.dump();
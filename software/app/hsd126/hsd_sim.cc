@@ -7,7 +7,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <new>
+#include <ctype.h>
+#include <charconv>
 
 extern int optind;
 
@@ -55,21 +56,43 @@ int main(int argc, char** argv) {
     return -1;
   }
 
-  uint32_t* event = new uint32_t[0x100000];
+  const unsigned maxwords = 0x100000;
+  uint32_t* event = new uint32_t[maxwords];
   uint16_t* compr = new uint16_t[0x1000];
 
-  const unsigned linesz = 40960;
-  char* line = new char[linesz];
+  size_t linesz = 0x10000;
+  char* line = (char*)malloc(linesz);
 
   while(1) {  // event loop
-    if ( !fgets(line, linesz, f) )
+    ssize_t len = getline(&line, &linesz, f);
+    if (len < 0)
       break;
 
+    //  One event per line of hex words; skip lines that are not
     uint32_t* u = event;
-    char* p = line;
-    while(*p) {
-      *u++ = strtoul(p,&endptr,16);
-      p = endptr+1;
+    const char* p   = line;
+    const char* end = line+len;
+    bool lbad = false;
+    while(1) {
+      while(p < end && isspace(*p))
+        p++;
+      if (p == end)
+        break;
+      if (u-event == maxwords) {
+        lbad = true;
+        break;
+      }
+      std::from_chars_result r = std::from_chars(p, end, *u, 16);
+      if (r.ec != std::errc() || (r.ptr < end && !isspace(*r.ptr))) {
+        lbad = true;
+        break;
+      }
+      u++;
+      p = r.ptr;
+    }
+    if (lbad || u-event < 12) {
+      printf("Skipping malformed line\n");
+      continue;
     }
 
     printf("Event: %08x.%08x %08x.%08x\n",
@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <time.h>
 #include <semaphore.h>
+#include <pthread.h>
 #include <poll.h>
 #include <signal.h>
 #include <arpa/inet.h>
@@ -18,6 +19,8 @@
 #include <vector>
 
 #include "Histogram.hh"
+#include "Metrics.hh"
+#include "Numa.hh"
 #include "Module.hh"
 #include "Event.hh"
 #include "QABase.hh"
@@ -40,28 +43,33 @@ public:
   sem_t sem;
   int reqfd;
   int rate;
+  bool numa;          // buffer and thread on the card's node
+  int  node;
+  int  fifoPriority;
 };
 
 
+//
+//  Bumped by the read thread, reported by the main thread
+//
 class DaqStats {
 public:
-  DaqStats() : _values(7) {
-    for(unsigned i=0; i<_values.size(); i++)
-      _values[i]=0;
+  void init(Metrics& m) {
+    for(unsigned i=0; i<7; i++)
+      _values[i] = m.counter(names()[i]);
   }
 public:
   static const char** names();
-  std::vector<unsigned> values() const { return _values; }
 public:
-  unsigned& eventFrames () { return _values[0]; }
-  unsigned& dropFrames  () { return _values[1]; }
-  unsigned& repeatFrames() { return _values[2]; }
-  unsigned& tagMisses   () { return _values[3]; }
-  unsigned& corrupt     () { return _values[4]; }
-  unsigned& anaTags     () { return _values[5]; }
-  unsigned& anaErrs     () { return _values[6]; }
+  Metrics::Counter& eventFrames () { return _values[0]; }
+  Metrics::Counter& dropFrames  () { return _values[1]; }
+  Metrics::Counter& repeatFrames() { return _values[2]; }
+  Metrics::Counter& tagMisses   () { return _values[3]; }
+  Metrics::Counter& corrupt     () { return _values[4]; }
+  Metrics::Counter& anaTags     () { return _values[5]; }
+  Metrics::Counter& anaErrs     () { return _values[6]; }
 private:
-  std::vector<unsigned> _values;
+  Metrics::Counter _values[7];
 };  
 
 const char** DaqStats::names() {
@@ -76,68 +84,54 @@ const char** DaqStats::names() {
 }
 
 
+//
+//  DMA counters of the card, accumulated into the metrics registry
+//  from the differences of its 32-bit registers
+//
 class DmaStats {
 public:
-  DmaStats() : _values(4) {
-    for(unsigned i=0; i<_values.size(); i++)
-      _values[i]=0;
+  void init(Metrics& m, const QABase& base) {
+    _base = &base;
+    for(unsigned i=0; i<3; i++) {
+      _values[i] = m.counter(names()[i]);
+      _last  [i] = _read(i);
+    }
   }
-  DmaStats(const QABase& o) : _values(4) {
-    frameCount   () = o.countEnable;
-    pauseCount   () = o.countInhibit;
+  void update() {
+    for(unsigned i=0; i<3; i++) {
+      unsigned v = _read(i);
+      _values[i].add(v - _last[i]);
+      _last  [i] = v;
+    }
   }
-
 public:
   static const char** names();
-  std::vector<unsigned> values() const { return _values; }
-public:
-  unsigned& frameCount   () { return _values[0]; }
-  unsigned& pauseCount   () { return _values[1]; }
-  unsigned& overflowCount() { return _values[2]; }
-  unsigned& idleCount    () { return _values[3]; }
 private:
-  std::vector<unsigned> _values;
+  unsigned _read(unsigned i) const {
+    switch(i) {
+    case 0 : return _base->countAcquire;
+    case 1 : return _base->countEnable;
+    default: return _base->countInhibit;
+    }
+  }
+private:
+  const QABase*    _base;
+  Metrics::Counter _values[3];
+  unsigned         _last  [3];
 };  
 
 const char** DmaStats::names() {
-  static const char* _names[] = {"frameCount",
-                                 "pauseCount",
-                                 "overflowCount",
-                                 "idleCount" };
+  static const char* _names[] = {"acquireCount",
+                                 "frameCount",
+                                 "pauseCount" };
   return _names;
 }
 
 
-template <class T> class RateMonitor {
-public:
-  RateMonitor() {}
-  RateMonitor(const T& o) {
-    clock_gettime(CLOCK_REALTIME,&tv);
-    _t = o;
-  }
-  RateMonitor<T>& operator=(const RateMonitor<T>& o) {
-    tv = o.tv;
-    _t = o._t;
-    return *this;
-  }
-public:
-  void dump(const RateMonitor<T>& o) {
-    double dt = double(o.tv.tv_sec-tv.tv_sec)+1.e-9*(double(o.tv.tv_nsec)-double(tv.tv_nsec));
-    for(unsigned i=0; i<_t.values().size(); i++)
-      printf("%10u %15.15s [%10u] : %g\n",
-             _t.values()[i],
-             _t.names()[i],
-             o._t.values()[i]-_t.values()[i],
-             double(o._t.values()[i]-_t.values()[i])/dt);
-  }
-private:
-  timespec tv;
-  T _t;
-};
-  
-
+static Metrics*  metrics = 0;
 static DaqStats  daqStats;
-static HSD::Histogram readSize(8,1);
+static DmaStats  dmaStats;
+static HSD::Histogram readSize(16,1,4);
 static HSD::Histogram adcSync (7,1);
 static HSD::Histogram scorr   (7,1);
 static uint64_t opid = 0;
@@ -168,6 +162,8 @@ void usage(const char* p) {
   printf("\t-T pattern  : Set test pattern\n");
   printf("\t-v nPrint   : Set number of events to dump out\n");
   printf("\t-V          : Dump out all events\n");
+  printf("\t-m <name>   : Export the counters to shared memory segment <name>\n");
+  printf("\t-A <prio>   : Read buffer and thread on the card's NUMA node; SCHED_FIFO at prio if >0\n");
 }
 
 static Module* reg=0;
@@ -196,15 +192,19 @@ int main(int argc, char** argv) {
   unsigned delay=0;
   int      onechannel_input = -1;
   unsigned streams = 0xf;
+  const char* metricsName = 0;
   ThreadArgs args;
   args.fd = -1;
   args.busyTime = 0;
   args.reqfd = -1;
   args.rate = 6;
+  args.numa = false;
+  args.node = -1;
+  args.fifoPriority = 0;
 
   int c;
   bool lUsage = false;
-  while ( (c=getopt( argc, argv, "I:d:D:f:F:S:B:E:F:R:P:T:v:Vh")) != EOF ) {
+  while ( (c=getopt( argc, argv, "I:d:D:f:F:S:B:E:F:R:P:T:v:m:A:Vh")) != EOF ) {
     switch(c) {
     case 'I':
       qI=Q_ABCD;
@@ -244,6 +244,13 @@ int main(int argc, char** argv) {
     case 'v':
       nPrint = strtoul(optarg,NULL,0);
       break;
+    case 'm':
+      metricsName = optarg;
+      break;
+    case 'A':
+      args.numa = true;
+      args.fifoPriority = strtol(optarg,NULL,0);
+      break;
     case 'V':
       lVerbose = true;
       break;
@@ -285,6 +292,10 @@ int main(int argc, char** argv) {
 
   args.fd  = fd;
   sem_init(&args.sem,0,0);
+  if (args.numa) {
+    args.node = Numa::node(dev);
+    printf("%s on NUMA node %d\n", dev, args.node);
+  }
 
   Module* p = reg = Module::create(fd,fmc);
 
@@ -299,6 +310,11 @@ int main(int argc, char** argv) {
   //
   //  Create thread to receive DMAS and validate the data
   //
+  metrics = new Metrics(metricsName);
+  daqStats.init(*metrics);
+  dmaStats.init(*metrics, *reinterpret_cast<const QABase*>((char*)p->reg()+0x100000));
+  metrics->histogram("readSize", &readSize);
+
   { 
     pthread_attr_t tattr;
     pthread_attr_init(&tattr);
@@ -310,10 +326,6 @@ int main(int argc, char** argv) {
 
   ::signal( SIGINT, sigHandler );
 
-  RateMonitor<DaqStats> ostats(daqStats);
-  DmaStats d;
-  RateMonitor<DmaStats> dstats(d);
-
   unsigned och0  =0;
   unsigned otot  =0;
   unsigned rxErrs=0;
@@ -328,9 +340,9 @@ int main(int argc, char** argv) {
 
     printf("--------------\n");
 
-    { RateMonitor<DaqStats> stats(daqStats);
-      ostats.dump(stats);
-      ostats = stats; }
+    dmaStats.update();
+    metrics->publish();
+    metrics->dump();
 
 #if 0    
     { unsigned v = p->tpr().RxDecErrs+p->tpr().RxDspErrs - rxErrs0;
@@ -355,7 +367,17 @@ void* read_thread(void* arg)
   ThreadArgs targs = *reinterpret_cast<ThreadArgs*>(arg);
 
   size_t    maxSize = 1<<26;
-  uint32_t* data = new uint32_t[maxSize>>2];
+  uint32_t* data = 0;
+  if (targs.numa) {
+    Numa::pin(Numa::cpus(targs.node), targs.fifoPriority);
+    data = reinterpret_cast<uint32_t*>(Numa::allocate(maxSize, targs.node));
+    if (!data)
+      printf("Buffer not allocated on the node; using the heap\n");
+  }
+  //  Released as it was allocated
+  bool lNumaData = data != 0;
+  if (!data)
+    data = new uint32_t[maxSize>>2];
   unsigned  flags;
   unsigned  error;
   unsigned  dest;
@@ -397,7 +419,7 @@ void* read_thread(void* arg)
         */
       uint32_t* p     = (uint32_t*)data;
       {
-        daqStats.eventFrames()++;
+        daqStats.eventFrames().add();
         if (lLCLSII) {
           opid = p[4];
           opid = (opid<<32) | p[3];
@@ -450,7 +472,7 @@ void* read_thread(void* arg)
     osnc = p[5];
 
     if (1) {
-      daqStats.eventFrames()++;
+      daqStats.eventFrames().add();
 
       if (nPrint) {
         nPrint--;
@@ -468,7 +490,7 @@ void* read_thread(void* arg)
       }
     
       if (pid==opid) {
-        daqStats.repeatFrames()++;
+        daqStats.repeatFrames().add();
         printf("repeat  [%zd]: exp %016lx: ",nb,opid+dpid);
         uint32_t* p32 = (uint32_t*)data;
         for(unsigned i=0; i<8; i++)
@@ -476,7 +498,7 @@ void* read_thread(void* arg)
         printf("\n"); 
       }
       else if (pid-opid != dpid && (opid+dpid < 0x1ffe0 || opid > 0x20000) ) {
-        daqStats.corrupt()++;
+        daqStats.corrupt().add();
         printf("corrupt [%zd]: exp %016lx: ",nb,opid+dpid);
         uint32_t* p32 = (uint32_t*)data;
         for(unsigned i=0; i<8; i++)
@@ -488,31 +510,31 @@ void* read_thread(void* arg)
       case Module::Flash11:
         if (qI==Q_ABCD) {
           if (!checkFlashN_interleaved(p,11))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         else {
           if (!checkFlashN(p,11))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         break;
       case Module::Flash12:
         if (qI==Q_ABCD) {
           if (!checkFlashN_interleaved(p,12))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         else {
           if (!checkFlashN(p,12))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         break;
       case Module::Flash16:
         if (qI==Q_ABCD) {
           if (!checkFlashN_interleaved(p,16))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         else {
           if (!checkFlashN(p,16))
-            daqStats.corrupt()++;
+            daqStats.corrupt().add();
         }
         break;
       default:
@@ -530,6 +552,11 @@ void* read_thread(void* arg)
 
   printf("read_thread done\n");
 
+  if (lNumaData)
+    Numa::release(data, maxSize);
+  else
+    delete[] data;
+
   return 0;
 }
 
@@ -0,0 +1,301 @@
+#include "BaselineCorr.hh"
+
+#ifdef HSD_X86
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+
+using namespace Pds::HSD;
+
+static const uint16_t ADC_MASK = 0xfff;
+static const uint32_t RUN_MASK = 0xffffff;   // 24-bit running sums
+
+//
+//  Scalar kernels, also used for the tails of the vector kernels.
+//  The shift drops all but 12 bits of the sample.  Vector kernels
+//  start on a super-sample, so lane i%4 is that of the vector.
+//
+static unsigned _correct_scalar(const uint16_t* x, unsigned i, unsigned n,
+                                const uint16_t* corr, uint16_t baseline, uint16_t* y)
+{
+  unsigned oor = 0;
+  for(; i<n; i++) {
+    uint16_t q = uint16_t(x[i]<<BaselineCorr::FracBits) + baseline - corr[i&3];
+    y[i] = q & 0x7fff;
+    oor += q>>15;
+  }
+  return oor;
+}
+
+static unsigned _correct_s(const uint16_t* x, unsigned n,
+                           const uint16_t* corr, uint16_t baseline, uint16_t* y)
+{ return _correct_scalar(x, 0, n, corr, baseline, y); }
+
+//  Lane sums of the first SumRows super-samples
+static void _sum_s(const uint16_t* x, uint16_t* s)
+{
+  for(unsigned i=0; i<BaselineCorr::Ilv; i++)
+    s[i] = 0;
+  for(unsigned k=0; k<BaselineCorr::SumRows*BaselineCorr::Ilv; k++)
+    s[k&3] += x[k];
+}
+
+#ifdef HSD_X86
+__attribute__((target("sse4.2")))
+static unsigned _correct_sse42(const uint16_t* x, unsigned n,
+                               const uint16_t* corr, uint16_t baseline, uint16_t* y)
+{
+  unsigned oor = 0;
+  unsigned i=0;
+  const __m128i vmask = _mm_set1_epi16(0x7fff);
+  const __m128i voff  = _mm_setr_epi16(baseline-corr[0], baseline-corr[1],
+                                       baseline-corr[2], baseline-corr[3],
+                                       baseline-corr[0], baseline-corr[1],
+                                       baseline-corr[2], baseline-corr[3]);
+  for(; i+8<=n; i+=8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i));
+    __m128i q = _mm_add_epi16(_mm_slli_epi16(v, BaselineCorr::FracBits), voff);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y+i), _mm_and_si128(q, vmask));
+    oor += __builtin_popcount(_mm_movemask_epi8(_mm_srai_epi16(q, 15)))>>1;
+  }
+  return oor + _correct_scalar(x, i, n, corr, baseline, y);
+}
+
+__attribute__((target("sse4.2")))
+static void _sum_sse42(const uint16_t* x, uint16_t* s)
+{
+  const __m128i* p = reinterpret_cast<const __m128i*>(x);
+  __m128i a = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128(p+0), _mm_loadu_si128(p+1)),
+                            _mm_add_epi16(_mm_loadu_si128(p+2), _mm_loadu_si128(p+3)));
+  a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(s), a);
+}
+
+__attribute__((target("avx2")))
+static unsigned _correct_avx2(const uint16_t* x, unsigned n,
+                              const uint16_t* corr, uint16_t baseline, uint16_t* y)
+{
+  unsigned oor = 0;
+  unsigned i=0;
+  const __m256i vmask = _mm256_set1_epi16(0x7fff);
+  const __m256i voff  = _mm256_setr_epi16(baseline-corr[0], baseline-corr[1],
+                                          baseline-corr[2], baseline-corr[3],
+                                          baseline-corr[0], baseline-corr[1],
+                                          baseline-corr[2], baseline-corr[3],
+                                          baseline-corr[0], baseline-corr[1],
+                                          baseline-corr[2], baseline-corr[3],
+                                          baseline-corr[0], baseline-corr[1],
+                                          baseline-corr[2], baseline-corr[3]);
+  for(; i+16<=n; i+=16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x+i));
+    __m256i q = _mm256_add_epi16(_mm256_slli_epi16(v, BaselineCorr::FracBits), voff);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(y+i), _mm256_and_si256(q, vmask));
+    oor += __builtin_popcount(unsigned(_mm256_movemask_epi8(_mm256_srai_epi16(q, 15))))>>1;
+  }
+  return oor + _correct_scalar(x, i, n, corr, baseline, y);
+}
+
+__attribute__((target("avx2")))
+static void _sum_avx2(const uint16_t* x, uint16_t* s)
+{
+  const __m256i* p = reinterpret_cast<const __m256i*>(x);
+  __m256i a = _mm256_add_epi16(_mm256_loadu_si256(p+0), _mm256_loadu_si256(p+1));
+  __m128i b = _mm_add_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  b = _mm_add_epi16(b, _mm_srli_si128(b, 8));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(s), b);
+}
+#endif
+
+namespace {
+  class Kernels {
+  public:
+    unsigned (*correct)(const uint16_t*, unsigned, const uint16_t*, uint16_t, uint16_t*);
+    void     (*sum    )(const uint16_t*, uint16_t*);
+  };
+};
+
+static const Kernels _kernels[] = {
+  { _correct_s, _sum_s },
+#ifdef HSD_X86
+  { _correct_sse42, _sum_sse42 },
+  { _correct_avx2 , _sum_avx2  },
+#endif
+};
+
+static Simd::Isa _isa = Simd::best();
+
+unsigned BaselineCorr::correct(const uint16_t* x, unsigned n,
+                               const uint16_t* corr, uint16_t baseline,
+                               uint16_t* y)
+{
+  return _kernels[_isa].correct(x, n, corr, baseline, y);
+}
+
+void BaselineCorr::corrections(const uint16_t* head, uint16_t* corr)
+{
+  for(unsigned i=0; i<Ilv; i++)
+    corr[i] = head[i] + CorrOffset;
+}
+
+unsigned BaselineCorr::gate(const uint16_t* raw, unsigned n,
+                            const uint16_t* corr, uint16_t baseline,
+                            uint16_t* y)
+{
+  if (n < Ilv)
+    return 0;
+  unsigned oor = correct(raw+Ilv, n-Ilv, corr, baseline, y+Ilv);
+  for(unsigned i=0; i<Ilv; i++) {
+    uint16_t q = corr[i] - CorrOffset;
+    y[i] = q & 0x7fff;
+    oor += q>>15;
+  }
+  return oor;
+}
+
+Simd::Isa BaselineCorr::isa() { return _isa; }
+
+bool BaselineCorr::select(Simd::Isa v)
+{
+  if (!Simd::supported(v))
+    return false;
+  _isa = v;
+  return true;
+}
+
+//
+//  The firmware reset values
+//
+BaselineCorr::Config::Config() :
+  accShift(MaxAccum),
+  baseline(1<<14)
+{
+}
+
+BaselineCorr::Config::Config(unsigned shift, unsigned base) :
+  accShift(shift),
+  baseline(base)
+{
+}
+
+BaselineCorr::BaselineCorr(const Config& c) :
+  _config(c)
+{
+  if (_config.accShift < FracBits)
+    _config.accShift = FracBits;
+  if (_config.accShift > MaxAccum)
+    _config.accShift = MaxAccum;
+  _config.baseline &= 0x7fff;
+  reset();
+}
+
+void BaselineCorr::reset()
+{
+  _init   = true;
+  _oor    = true;
+  memset(_tOut  , 0, sizeof(_tOut  ));
+  memset(_tNew  , 0, sizeof(_tNew  ));
+  memset(_adcOut, 0, sizeof(_adcOut));
+  memset(_adcNew, 0, sizeof(_adcNew));
+  memset(_adcSum, 0, sizeof(_adcSum));
+  memset(_adcRun, 0, sizeof(_adcRun));
+  for(unsigned i=0; i<Ilv; i++)
+    _adcCorr[i] = 1<<15;
+  _addr   = 0;
+  _wraddr = 0;
+  _rdaddr = 1;
+  //  Block RAM contents survive reset; the init flag covers them
+  memset(_ram , 0, sizeof(_ram ));
+  memset(_dout, 0, sizeof(_dout));
+}
+
+//
+//  The comb process of hsd_baseline_corr, with the registered state on
+//  the right hand side and the new state assigned at the end
+//
+bool BaselineCorr::clock(const uint16_t* adcIn, const uint8_t* tIn,
+                         uint16_t* out, uint8_t* tout)
+{
+  uint16_t adc[RowSamples];
+  for(unsigned k=0; k<RowSamples; k++)
+    adc[k] = adcIn[k] & ADC_MASK;
+
+  bool start = false;
+  for(unsigned j=0; j<RowSize; j++)
+    start |= tIn[j] & 1;
+
+  //  Latch the correction
+  uint16_t adcCorr[Ilv];
+  memcpy(adcCorr, _adcCorr, sizeof(adcCorr));
+  if (start) {
+    unsigned n = _config.accShift - FracBits;
+    for(unsigned i=0; i<Ilv; i++)
+      adcCorr[i] = (_adcRun[i] >> n) & 0xffff;
+  }
+
+  uint16_t adcNew[RowSamples];
+  bool oor = _kernels[_isa].correct(adc, RowSamples, adcCorr, _config.baseline, adcNew) != 0;
+
+  //  Prepend the correction values
+  uint16_t adcOut[RowSamples];
+  memcpy(adcOut, _adcNew, sizeof(adcOut));
+  for(unsigned j=0; j<RowSize; j++)
+    if (_tNew[j] & 1)
+      for(unsigned i=0; i<Ilv; i++) {
+        uint16_t q = _adcCorr[i] - CorrOffset;
+        adcOut[j*Ilv+i] = q & 0x7fff;
+        oor |= q>>15;
+      }
+
+  uint16_t adcSum[Ilv];
+  _kernels[_isa].sum(adc, adcSum);
+
+  //  The RAM is not reset; the sums are qualified once it is filled
+  unsigned n    = _config.accShift - 3;
+  unsigned mask = (1<<n)-1;
+  bool     init = _init && (_wraddr & mask) != mask;
+
+  uint32_t adcRun[Ilv];
+  for(unsigned i=0; i<Ilv; i++)
+    adcRun[i] = (_init ?
+                 _adcRun[i] + _adcSum[i] :
+                 _adcRun[i] + _adcSum[i] - _dout[i]) & RUN_MASK;
+
+  unsigned addr = (_addr+1) & (RamRows-1);
+
+  //  RAM: registered read, write of the registered sums
+  memcpy(_dout, _ram[_rdaddr], sizeof(_dout));
+  memcpy(_ram[_wraddr], _adcSum, sizeof(_adcSum));
+
+  //  Registers
+  _init   = init;
+  _oor    = oor;
+  memcpy(_tOut   , _tNew , sizeof(_tOut));
+  memcpy(_tNew   , tIn   , sizeof(_tNew));
+  memcpy(_adcOut , adcOut, sizeof(_adcOut));
+  memcpy(_adcNew , adcNew, sizeof(_adcNew));
+  memcpy(_adcSum , adcSum, sizeof(_adcSum));
+  memcpy(_adcRun , adcRun, sizeof(_adcRun));
+  memcpy(_adcCorr, adcCorr, sizeof(_adcCorr));
+  _wraddr = _addr & mask;
+  _rdaddr = addr & mask;
+  _addr   = addr;
+
+  memcpy(out , _adcOut, sizeof(_adcOut));
+  memcpy(tout, _tOut  , sizeof(_tOut));
+  return _oor;
+}
+
+unsigned BaselineCorr::run(const uint16_t* adc, const uint8_t* t, unsigned rows,
+                           uint16_t* out, uint8_t* tout, uint8_t* oor)
+{
+  unsigned noor = 0;
+  for(unsigned r=0; r<rows; r++) {
+    bool o = clock(adc + r*RowSamples, t + r*RowSize,
+                   out + r*RowSamples, tout + r*RowSize);
+    if (oor)
+      oor[r] = o;
+    noor += o;
+  }
+  return noor;
+}
@@ -0,0 +1,88 @@
+#ifndef HSD_BaselineCorr_hh
+#define HSD_BaselineCorr_hh
+
+#include "Simd.hh"
+
+#include <stdint.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Model of the baseline corrector ahead of the sparsifier
+    //  (hsd_baseline_corr), clock by clock.  Each clock takes a row of
+    //  10 super-samples of 4 interleaved 12-bit samples.  Per lane a
+    //  running sum covers the last 2^accShift samples (in sums of the
+    //  first 8 super-samples of each row); a gate opening latches it
+    //  as the correction, 16 times the mean.  Output samples are
+    //  (adc<<4) + baseline - correction in 15 bits, and the super-sample
+    //  with the opening carries the corrections less 16384 instead.
+    //
+    //  On the host, gate() forms the corrected gate from a raw stream
+    //  and the corrections read back from the head of stream 3.
+    //
+    class BaselineCorr {
+    public:
+      enum { RowSize = 10, Ilv = 4, RowSamples = RowSize*Ilv };
+      enum { FracBits = 4, MaxAccum = 12, SumRows = 8 };
+      enum { CorrOffset = 16384 };
+      class Config {
+      public:
+        Config();
+        Config(unsigned accShift, unsigned baseline);
+      public:
+        unsigned accShift;   // 4..12
+        unsigned baseline;   // 15 bits
+      };
+    public:
+      BaselineCorr(const Config&);
+    public:
+      const Config&   config() const { return _config; }
+      //  The corrections latched at the last opening
+      const uint16_t* corr  () const { return _adcCorr; }
+      void reset();
+      //  One clock: RowSamples samples and RowSize trigger bit pairs in,
+      //  the registered outputs out (the previous clock's row).  Returns
+      //  the out of range flag.
+      bool clock(const uint16_t* adc, const uint8_t* t,
+                 uint16_t* out, uint8_t* tout);
+      //  rows clocks; oor gets a flag per row.  Returns the rows out of
+      //  range.
+      unsigned run(const uint16_t* adc, const uint8_t* t, unsigned rows,
+                   uint16_t* out, uint8_t* tout, uint8_t* oor);
+    public:
+      //  y[i] = (x[i]<<4) + baseline - corr[i%4], 15 bits.  Returns the
+      //  number of results out of range.
+      static unsigned correct(const uint16_t* x, unsigned n,
+                              const uint16_t* corr, uint16_t baseline,
+                              uint16_t* y);
+      //  The corrections from the first super-sample of stream 3
+      static void     corrections(const uint16_t* head, uint16_t* corr);
+      //  The gate as the sparsifier sees it, for the n samples of the
+      //  raw interleave from its opening
+      static unsigned gate(const uint16_t* raw, unsigned n,
+                           const uint16_t* corr, uint16_t baseline,
+                           uint16_t* y);
+      static Simd::Isa isa   ();
+      static bool      select(Simd::Isa);   // false if unsupported
+    private:
+      enum { RamRows = 1<<(MaxAccum-3) };
+      Config   _config;
+      //  Registers
+      bool     _init;
+      bool     _oor;
+      uint8_t  _tOut  [RowSize];
+      uint8_t  _tNew  [RowSize];
+      uint16_t _adcOut[RowSamples];
+      uint16_t _adcNew[RowSamples];
+      uint16_t _adcSum [Ilv];
+      uint32_t _adcRun [Ilv];
+      uint16_t _adcCorr[Ilv];
+      unsigned _addr, _wraddr, _rdaddr;
+      //  Sums of the last rows and the read register
+      uint16_t _ram [RamRows][Ilv];
+      uint16_t _dout[Ilv];
+    };
+  };
+};
+
+#endif
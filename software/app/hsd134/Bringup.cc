@@ -0,0 +1,134 @@
+#include "Bringup.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+using namespace Pds::HSD;
+
+namespace {
+  class Phase {
+  public:
+    std::string name;
+    double      begin;     // s
+    double      elapsed;
+    double      waited;    // in polled waits
+    double      settled;   // in fixed delays
+    unsigned    polls;
+    unsigned    timeouts;
+    bool        ok;
+    bool        open;
+  };
+};
+
+static std::vector<Phase> _phases;
+static double             _start = -1;
+
+static double _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return double(tv.tv_sec) + 1.e-9*double(tv.tv_nsec);
+}
+
+static Phase* _current()
+{
+  return (_phases.size() && _phases.back().open) ? &_phases.back() : 0;
+}
+
+void Bringup::begin(const char* name)
+{
+  end();
+  double t = _now();
+  if (_start < 0)
+    _start = t;
+  Phase p;
+  p.name     = name;
+  p.begin    = t;
+  p.elapsed  = 0;
+  p.waited   = 0;
+  p.settled  = 0;
+  p.polls    = 0;
+  p.timeouts = 0;
+  p.ok       = true;
+  p.open     = true;
+  _phases.push_back(p);
+}
+
+void Bringup::end(bool ok)
+{
+  Phase* p = _current();
+  if (!p)
+    return;
+  p->elapsed = _now()-p->begin;
+  p->ok      = ok;
+  p->open    = false;
+}
+
+bool Bringup::wait(const char* what,
+                   Cond        cond,
+                   void*       arg,
+                   unsigned    timeout_ms,
+                   unsigned    interval_us)
+{
+  double t0 = _now();
+  double tmo = t0 + 1.e-3*double(timeout_ms);
+  unsigned polls = 0;
+  bool result;
+  while(1) {
+    polls++;
+    if ((result = cond(arg)))
+      break;
+    if (_now() > tmo)
+      break;
+    if (interval_us)
+      usleep(interval_us);
+  }
+  double dt = _now()-t0;
+
+  Phase* p = _current();
+  if (p) {
+    p->waited += dt;
+    p->polls  += polls;
+    if (!result)
+      p->timeouts++;
+  }
+  if (!result)
+    printf("%s: not ready after %u ms\n", what, timeout_ms);
+  return result;
+}
+
+void Bringup::settle(unsigned ms)
+{
+  double t0 = _now();
+  usleep(ms*1000);
+  Phase* p = _current();
+  if (p)
+    p->settled += _now()-t0;
+}
+
+void Bringup::report(const char* title)
+{
+  end();
+  printf("--bring-up%s%s--\n", title ? " " : "", title ? title : "");
+  printf("  %-20.20s %10s %10s %10s %6s %4s\n",
+         "phase", "ms", "wait ms", "delay ms", "polls", "tmo");
+  for(unsigned i=0; i<_phases.size(); i++) {
+    const Phase& p = _phases[i];
+    printf("  %-20.20s %10.1f %10.1f %10.1f %6u %4u%s\n",
+           p.name.c_str(),
+           p.elapsed*1.e3, p.waited*1.e3, p.settled*1.e3,
+           p.polls, p.timeouts, p.ok ? "" : "  FAILED");
+  }
+  if (_start >= 0)
+    printf("  %-20.20s %10.1f\n", "total", (_now()-_start)*1.e3);
+}
+
+void Bringup::reset()
+{
+  _phases.clear();
+  _start = -1;
+}
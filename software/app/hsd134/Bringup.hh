@@ -0,0 +1,35 @@
+#ifndef HSD_Bringup_hh
+#define HSD_Bringup_hh
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Timing of the board bring-up.  Steps wait on a ready condition
+    //  (PLL lock, calibration done, link valid) polled under a timeout
+    //  rather than sleeping for a fixed time; the time spent in each
+    //  phase, and waiting within it, is kept for the report.
+    //
+    class Bringup {
+    public:
+      typedef bool (*Cond)(void* arg);
+    public:
+      //  Starts a phase, ending any phase in progress
+      static void begin (const char* phase);
+      static void end   (bool ok=true);
+      //  Polls cond every interval_us until it holds.  Returns false
+      //  if it does not hold within timeout_ms.
+      static bool wait  (const char* what,
+                         Cond        cond,
+                         void*       arg,
+                         unsigned    timeout_ms,
+                         unsigned    interval_us=1000);
+      //  Fixed delay for steps that have no ready indicator
+      static void settle(unsigned ms);
+    public:
+      static void report(const char* title=0);
+      static void reset ();
+    };
+  };
+};
+
+#endif
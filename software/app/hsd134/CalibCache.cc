@@ -0,0 +1,150 @@
+#include "CalibCache.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace Pds::HSD;
+
+//
+//  File format, one "name value" per line:
+//    board       <FMC EEPROM hex>
+//    clockmode   <n>
+//    channels    <1|2>
+//    input       <A|B>
+//    temperature <degC>
+//    time        <seconds since epoch>
+//    adc0        <calibration hex>
+//    adc1        <calibration hex>
+//
+
+static uint64_t _fnv1a(const std::string& s)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(unsigned i=0; i<s.size(); i++) {
+    h ^= uint8_t(s[i]);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+CalibCache::CalibCache(const char* dir,
+                       double      tolerance) :
+  _dir      (dir),
+  _tolerance(tolerance)
+{
+}
+
+std::string CalibCache::_path(const Key& key) const
+{
+  char buff[64];
+  snprintf(buff, sizeof(buff), "/fmc134_%016llx_c%u_%u%c.cal",
+           (unsigned long long)_fnv1a(key.board),
+           key.clockmode,
+           key.lDualCh ? 2:1,
+           key.inputCh==CHAN_A0_2 ? 'A':'B');
+  return _dir + buff;
+}
+
+bool CalibCache::lookup(const Key&   key,
+                        double       temperature,
+                        std::string& adc0,
+                        std::string& adc1) const
+{
+  std::string path = _path(key);
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) {
+    printf("CalibCache: no entry %s\n", path.c_str());
+    return false;
+  }
+
+  std::string board, a0, a1;
+  unsigned clockmode = -1U, channels = 0;
+  char     input = 0;
+  double   t = NAN;
+
+  char*  line = 0;
+  size_t sz   = 0;
+  while(getline(&line, &sz, f) > 0) {
+    char* p = strchr(line, ' ');
+    if (!p)
+      continue;
+    *p++ = 0;
+    p[strcspn(p, "\r\n")] = 0;
+    if      (strcmp(line,"board")==0)       board = p;
+    else if (strcmp(line,"clockmode")==0)   clockmode = strtoul(p,NULL,0);
+    else if (strcmp(line,"channels")==0)    channels  = strtoul(p,NULL,0);
+    else if (strcmp(line,"input")==0)       input     = *p;
+    else if (strcmp(line,"temperature")==0) t         = strtod(p,NULL);
+    else if (strcmp(line,"adc0")==0)        a0 = p;
+    else if (strcmp(line,"adc1")==0)        a1 = p;
+  }
+  free(line);
+  fclose(f);
+
+  //  The file name is only a hash of the key
+  if (board     != key.board ||
+      clockmode != key.clockmode ||
+      channels  != (key.lDualCh ? 2u:1u) ||
+      input     != (key.inputCh==CHAN_A0_2 ? 'A':'B')) {
+    printf("CalibCache: %s does not match this board\n", path.c_str());
+    return false;
+  }
+  if (a0.empty() || a1.empty()) {
+    printf("CalibCache: %s is incomplete\n", path.c_str());
+    return false;
+  }
+  if (!(fabs(temperature-t) <= _tolerance)) {
+    printf("CalibCache: %s taken at %.1fC, now %.1fC; recalibrating\n",
+           path.c_str(), t, temperature);
+    return false;
+  }
+
+  printf("CalibCache: using %s taken at %.1fC\n", path.c_str(), t);
+  adc0 = a0;
+  adc1 = a1;
+  return true;
+}
+
+bool CalibCache::store (const Key&   key,
+                        double       temperature,
+                        const std::string& adc0,
+                        const std::string& adc1) const
+{
+  if (adc0.empty() || adc1.empty())
+    return false;
+
+  mkdir(_dir.c_str(), 0775);
+
+  //  Written aside and renamed so a reader never sees a partial entry
+  std::string path = _path(key);
+  char tmp[32];
+  snprintf(tmp, sizeof(tmp), ".%d", getpid());
+  std::string tpath = path + tmp;
+
+  FILE* f = fopen(tpath.c_str(), "w");
+  if (!f) {
+    perror(tpath.c_str());
+    return false;
+  }
+  fprintf(f, "board %s\n", key.board.c_str());
+  fprintf(f, "clockmode %u\n", key.clockmode);
+  fprintf(f, "channels %u\n", key.lDualCh ? 2:1);
+  fprintf(f, "input %c\n", key.inputCh==CHAN_A0_2 ? 'A':'B');
+  fprintf(f, "temperature %.2f\n", temperature);
+  fprintf(f, "time %lu\n", (unsigned long)time(0));
+  fprintf(f, "adc0 %s\n", adc0.c_str());
+  fprintf(f, "adc1 %s\n", adc1.c_str());
+  if (fclose(f) || rename(tpath.c_str(), path.c_str())) {
+    perror(path.c_str());
+    unlink(tpath.c_str());
+    return false;
+  }
+
+  printf("CalibCache: stored %s\n", path.c_str());
+  return true;
+}
@@ -0,0 +1,47 @@
+#ifndef HSD_CalibCache_hh
+#define HSD_CalibCache_hh
+
+#include "Globals.hh"
+
+#include <string>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  On-disk cache of the ADC foreground calibration, one file per
+    //  FMC card and clock configuration.  An entry is used only if it
+    //  was taken at a board temperature within tolerance of the current
+    //  one; otherwise the ADCs are recalibrated and the entry replaced.
+    //
+    class CalibCache {
+    public:
+      class Key {
+      public:
+        std::string board;      // FMC EEPROM contents
+        unsigned    clockmode;  // Fmc134Cpld::CLOCKTREE_*
+        bool        lDualCh;
+        InputChan   inputCh;
+      };
+    public:
+      CalibCache(const char* dir,
+                 double      tolerance=5.);  // degC
+    public:
+      //  Returns false if there is no entry or it is stale
+      bool lookup(const Key&   key,
+                  double       temperature,
+                  std::string& adc0,
+                  std::string& adc1) const;
+      bool store (const Key&   key,
+                  double       temperature,
+                  const std::string& adc0,
+                  const std::string& adc1) const;
+    private:
+      std::string _path(const Key&) const;
+    private:
+      std::string _dir;
+      double      _tolerance;
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "Decompress.hh"
+
+#ifdef HSD_X86
+#include <immintrin.h>
+#endif
+
+using namespace Pds::HSD;
+
+typedef int (*Kernel)(const uint16_t*, unsigned, uint16_t*, unsigned, uint16_t, uint16_t);
+
+//
+//  Expand one input word.  Returns false if the output would pass the gate,
+//  having filled the output up to the gate.
+//
+static inline bool _step(uint16_t w, uint16_t* out, unsigned& j, unsigned gate,
+                         uint16_t filler, uint16_t mask)
+{
+  if (w&0x8000) {
+    unsigned n = w&0x7fff;
+    bool ok = n <= gate-j;
+    if (!ok)
+      n = gate-j;
+    for(unsigned k=0; k<n; k++)
+      out[j++] = filler;
+    return ok;
+  }
+  else {
+    if (j == gate)
+      return false;
+    out[j++] = w&mask;
+  }
+  return true;
+}
+
+static int _scalar(const uint16_t* in, unsigned nin,
+                   uint16_t* out, unsigned gate,
+                   uint16_t filler, uint16_t mask)
+{
+  unsigned j=0;
+  for(unsigned i=0; i<nin; i++)
+    if (!_step(in[i], out, j, gate, filler, mask))
+      return -1;
+  return j;
+}
+
+#ifdef HSD_X86
+//
+//  The vector kernels copy runs of samples a register at a time and
+//  fill suppressed runs with whole registers of filler.  A register may
+//  be stored past the last sample written, but never past the gate.
+//
+__attribute__((target("sse4.2")))
+static int _sse42(const uint16_t* in, unsigned nin,
+                  uint16_t* out, unsigned gate,
+                  uint16_t filler, uint16_t mask)
+{
+  const __m128i vmask = _mm_set1_epi16(mask);
+  const __m128i vfill = _mm_set1_epi16(filler);
+  unsigned i=0, j=0;
+  while(i < nin) {
+    if (i+8 <= nin && j+8 <= gate) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+i));
+      unsigned m = _mm_movemask_epi8(v) & 0xaaaa;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out+j), _mm_and_si128(v, vmask));
+      if (!m) {
+        i += 8;
+        j += 8;
+        continue;
+      }
+      //  Samples preceding the first skip word
+      unsigned lit = __builtin_ctz(m)>>1;
+      i += lit;
+      j += lit;
+    }
+    uint16_t w = in[i++];
+    if (w&0x8000) {
+      unsigned n = w&0x7fff;
+      if (n > gate-j) {
+        _step(w, out, j, gate, filler, mask);
+        return -1;
+      }
+      for(; n>=8; n-=8, j+=8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+j), vfill);
+      if (n) {
+        if (j+8 <= gate)
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out+j), vfill);
+        else
+          for(unsigned k=0; k<n; k++)
+            out[j+k] = filler;
+        j += n;
+      }
+    }
+    else {
+      if (j == gate)
+        return -1;
+      out[j++] = w&mask;
+    }
+  }
+  return j;
+}
+
+__attribute__((target("avx2")))
+static int _avx2(const uint16_t* in, unsigned nin,
+                 uint16_t* out, unsigned gate,
+                 uint16_t filler, uint16_t mask)
+{
+  const __m256i vmask = _mm256_set1_epi16(mask);
+  const __m256i vfill = _mm256_set1_epi16(filler);
+  unsigned i=0, j=0;
+  while(i < nin) {
+    if (i+16 <= nin && j+16 <= gate) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in+i));
+      unsigned m = unsigned(_mm256_movemask_epi8(v)) & 0xaaaaaaaa;
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+j), _mm256_and_si256(v, vmask));
+      if (!m) {
+        i += 16;
+        j += 16;
+        continue;
+      }
+      //  Samples preceding the first skip word
+      unsigned lit = __builtin_ctz(m)>>1;
+      i += lit;
+      j += lit;
+    }
+    uint16_t w = in[i++];
+    if (w&0x8000) {
+      unsigned n = w&0x7fff;
+      if (n > gate-j) {
+        _step(w, out, j, gate, filler, mask);
+        return -1;
+      }
+      for(; n>=16; n-=16, j+=16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+j), vfill);
+      if (n) {
+        if (j+16 <= gate)
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+j), vfill);
+        else
+          for(unsigned k=0; k<n; k++)
+            out[j+k] = filler;
+        j += n;
+      }
+    }
+    else {
+      if (j == gate)
+        return -1;
+      out[j++] = w&mask;
+    }
+  }
+  return j;
+}
+#endif
+
+static const Kernel _kernels[] = { _scalar,
+#ifdef HSD_X86
+                                   _sse42, _avx2
+#else
+                                   0, 0
+#endif
+};
+
+static Simd::Isa _isa = Simd::best();
+
+int Decompress::run(const uint16_t* in,  unsigned nin,
+                    uint16_t*       out, unsigned gate,
+                    uint16_t        filler,
+                    uint16_t        mask)
+{
+  return _kernels[_isa](in, nin, out, gate, filler, mask);
+}
+
+Simd::Isa Decompress::isa() { return _isa; }
+
+bool Decompress::select(Simd::Isa v)
+{
+  if (!Simd::supported(v))
+    return false;
+  _isa = v;
+  return true;
+}
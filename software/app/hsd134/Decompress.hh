@@ -0,0 +1,32 @@
+#ifndef HSD_Decompress_hh
+#define HSD_Decompress_hh
+
+#include "Simd.hh"
+
+#include <stdint.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Expansion of sparsified (fex) streams.  A word with bit 15 set
+    //  stands for (word&0x7fff) suppressed samples, which are replaced
+    //  by the filler value; other words are samples, masked on output.
+    //
+    class Decompress {
+    public:
+      //  Expands nin input words into out[0..gate).  Returns the number
+      //  of samples written, which is less than gate if the input is
+      //  short, or -1 if the input expands beyond gate samples (the
+      //  first gate samples are written).
+      static int  run   (const uint16_t* in,  unsigned nin,
+                         uint16_t*       out, unsigned gate,
+                         uint16_t        filler,
+                         uint16_t        mask = 0x3fff);
+    public:
+      static Simd::Isa isa   ();
+      static bool      select(Simd::Isa);   // false if unsupported
+    };
+  };
+};
+
+#endif
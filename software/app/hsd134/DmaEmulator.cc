@@ -0,0 +1,265 @@
+#include "DmaEmulator.hh"
+#include "Event.hh"
+#include "Sparsifier.hh"
+#include "BaselineCorr.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <string>
+
+using namespace Pds::HSD;
+
+//  Samples in a row of the sparsifier (10 super-samples of 4)
+static const unsigned ROW = Sparsifier::RowSamples;
+//  Level of the pulse pattern without signal
+static const uint16_t PEDESTAL = 0x800;
+//  Timing system seconds count from 1990 (EPICS epoch)
+static const int64_t EPICS_EPOCH = 631152000;
+//  LCLS-II base rate
+static const double  BASE_RATE = 1300.e6/1400.;
+static uint32_t _random(uint32_t& s)
+{
+  s ^= s<<13; s ^= s>>17; s ^= s<<5;
+  return s;
+}
+
+DmaEmulator::Config::Config() :
+  rate      (1000),
+  streams   (0xf),
+  length    (1600),
+  lanes     (1),
+  buffers   (256),
+  pattern   (Pulse),
+  lo        (0x3f00),
+  hi        (0x4100),
+  rowsBefore(1),
+  rowsAfter (1),
+  baseline  (BaselineCorr::Config().baseline),
+  seed      (1)
+{
+}
+
+bool DmaEmulator::Config::parse(const char* options)
+{
+  std::string s(options);
+  char* save = 0;
+  for(char* tok = strtok_r(&s[0], ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+    char* v = strchr(tok, '=');
+    if (!v) {
+      printf("DmaEmulator: option %s has no value\n", tok);
+      return false;
+    }
+    *v++ = 0;
+    if      (!strcmp(tok, "rate"   )) rate       = strtod (v, 0);
+    else if (!strcmp(tok, "streams")) streams    = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "length" )) length     = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "lanes"  )) lanes      = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "buffers")) buffers    = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "lo"     )) lo         = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "hi"     )) hi         = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "before" )) rowsBefore = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "after"  )) rowsAfter  = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "baseline")) baseline  = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "seed"   )) seed       = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "pattern")) {
+      if      (!strcmp(v, "ramp" )) pattern = Ramp;
+      else if (!strcmp(v, "pulse")) pattern = Pulse;
+      else {
+        printf("DmaEmulator: unknown pattern %s\n", v);
+        return false;
+      }
+    }
+    else {
+      printf("DmaEmulator: unknown option %s\n", tok);
+      return false;
+    }
+  }
+  return true;
+}
+
+DmaEmulator::DmaEmulator(const Config& c) :
+  DmaGenerator("Emulator"),
+  _config    (c),
+  _valid     (false),
+  _ilane     (0),
+  _pulseId   (0),
+  _nevent    (0)
+{
+  //  Whole rows of the interleave
+  if (_config.length % ROW)
+    _config.length += ROW - _config.length % ROW;
+  _config.streams &= 0xf;
+  if (!_config.seed)
+    _config.seed = 1;
+
+  for(unsigned i=0; i<8; i++) {
+    if (_config.lanes & (1<<i))
+      _lanes.push_back(i);
+    _count[i] = 0;
+  }
+  if (_lanes.empty())
+    _lanes.push_back(0);
+
+  _period    = _config.rate > 0 ? uint64_t(1.e9/_config.rate) : 0;
+  _pulseStep = _config.rate > 0 ? uint64_t(BASE_RATE/_config.rate + 0.5) : 1;
+  if (!_pulseStep)
+    _pulseStep = 1;
+
+  _build();
+
+  size_t bytes = 0;
+  for(unsigned t=0; t<Templates; t++) {
+    size_t n = sizeof(EventHeader) + _payload[t].size()*sizeof(uint16_t);
+    if (n > bytes)
+      bytes = n;
+  }
+  if (!(_valid = _allocate(_config.buffers, bytes)))
+    return;
+
+  printf("DmaEmulator: %u buffers of 0x%zx B  streams 0x%x  length %u  lanes 0x%x  %.0f Hz  %s\n",
+         _config.buffers, bytes, _config.streams, _config.length,
+         _config.lanes, _config.rate, _config.pattern==Ramp ? "ramp" : "pulse");
+}
+
+DmaEmulator::~DmaEmulator()
+{
+  _stop();
+}
+
+DmaEmulator* DmaEmulator::create(const char* name)
+{
+  Config c;
+  if (name[3]==':' && !c.parse(name+4))
+    return 0;
+  DmaEmulator* e = new DmaEmulator(c);
+  if (!e->_valid) {
+    delete e;
+    return 0;
+  }
+  return e;
+}
+
+//
+//  Each template has its own pattern start (ramp) or pulses and
+//  noise (pulse) and sample clock phase.
+//
+void DmaEmulator::_build()
+{
+  unsigned n    = _config.length;
+  uint32_t seed = _config.seed;
+  Sparsifier sparsifier(Sparsifier::Config(_config.lo, _config.hi,
+                                           _config.rowsBefore, _config.rowsAfter));
+
+  for(unsigned t=0; t<Templates; t++) {
+    //  Both channels in time order
+    std::vector<uint16_t> ilv(2*n);
+    if (_config.pattern == Ramp) {
+      uint16_t s0 = (t*0x89)&0x7ff;
+      for(unsigned i=0; i<n; i++)
+        ilv[2*i] = ilv[2*i+1] = (s0+i)&0x7ff;
+    }
+    else {
+      std::vector<double> w(2*n, PEDESTAL);
+      for(unsigned i=0; i<2*n; i++)
+        w[i] += double(_random(seed)%7) - 3;
+      //  Pulses of a 8 sample rise and 40 sample fall; the peak of the
+      //  difference of exponentials is 0.535
+      unsigned npulses = 1 + _random(seed)%3;
+      for(unsigned k=0; k<npulses; k++) {
+        unsigned p = _random(seed)%(2*n);
+        double   a = double(200 + _random(seed)%1500)/0.535;
+        for(unsigned i=p; i<2*n && i<p+400; i++) {
+          double dt = double(i-p);
+          w[i] += a*(exp(-dt/40.)-exp(-dt/8.));
+        }
+      }
+      for(unsigned i=0; i<2*n; i++)
+        ilv[i] = w[i] < 0 ? 0 : w[i] > 0xfff ? 0xfff : uint16_t(w[i]);
+    }
+
+    std::vector<uint16_t> ch[2];
+    for(unsigned c=0; c<2; c++) {
+      ch[c].resize(n);
+      for(unsigned i=0; i<n; i++)
+        ch[c][i] = ilv[2*i+c];
+    }
+    //  The interleaved streams have as many samples as each channel
+    ilv.resize(n);
+    //  The gate opens at a different point of the sparsifier's row
+    std::vector<uint16_t> fex;
+    if (_config.baseline) {
+      const uint16_t corr[] = { PEDESTAL<<BaselineCorr::FracBits, PEDESTAL<<BaselineCorr::FracBits,
+                                PEDESTAL<<BaselineCorr::FracBits, PEDESTAL<<BaselineCorr::FracBits };
+      std::vector<uint16_t> gate(n);
+      BaselineCorr::gate(ilv.data(), n, corr, _config.baseline, gate.data());
+      sparsifier.stream(gate.data(), n, t%Sparsifier::RowSize, fex);
+    }
+    else
+      sparsifier.stream(ilv.data(), n, t%Sparsifier::RowSize, fex);
+
+    uint32_t toffs = _random(seed)&0xff;
+    std::vector<uint16_t>& payload = _payload[t];
+    for(unsigned s=0; s<4; s++) {
+      if (!(_config.streams & (1<<s)))
+        continue;
+      const std::vector<uint16_t>& samples = s<2 ? ch[s] : s==2 ? ilv : fex;
+      uint32_t hdr[4];
+      hdr[0] = samples.size();
+      hdr[1] = s<<24;
+      hdr[2] = toffs;
+      hdr[3] = 0;
+      _streamOffset[t].push_back(payload.size());
+      const uint16_t* h = reinterpret_cast<const uint16_t*>(hdr);
+      payload.insert(payload.end(), h, h+sizeof(StreamHeader)/sizeof(uint16_t));
+      payload.insert(payload.end(), samples.begin(), samples.end());
+    }
+  }
+}
+
+bool DmaEmulator::_interval(uint64_t& ns)
+{
+  ns = _period;
+  return true;
+}
+
+unsigned DmaEmulator::_fill(void* buffer, uint32_t& dest)
+{
+  unsigned lane = _lanes[_ilane];
+  if (++_ilane == _lanes.size())
+    _ilane = 0;
+  dest = lane<<5;
+
+  const std::vector<uint16_t>& payload = _payload[_nevent % Templates];
+  const std::vector<unsigned>& offsets = _streamOffset[_nevent % Templates];
+
+  timespec tv;
+  clock_gettime(CLOCK_REALTIME, &tv);
+
+  uint32_t* p = reinterpret_cast<uint32_t*>(buffer);
+  p[0] = _pulseId & 0xffffffff;
+  p[1] = (_pulseId >> 32) & 0x00ffffff;
+  p[2] = tv.tv_nsec;
+  p[3] = tv.tv_sec - EPICS_EPOCH;
+  p[4] = _count[lane];
+  p[5] = 0;
+  p[6] = _config.streams << 20;
+  p[7] = 0;
+
+  uint16_t* q = reinterpret_cast<uint16_t*>(p+8);
+  memcpy(q, payload.data(), payload.size()*sizeof(uint16_t));
+  //  Front-end buffer and trigger tag
+  for(unsigned i=0; i<offsets.size(); i++) {
+    uint32_t* hdr = reinterpret_cast<uint32_t*>(q + offsets[i]);
+    hdr[1] |= (_nevent & 0xf)  << 16;
+    hdr[2] |= (_nevent & 0x1f) << 16;
+  }
+
+  _count[lane] = (_count[lane]+1) & 0xffffff;
+  _pulseId    += _pulseStep;
+  _nevent++;
+  return sizeof(EventHeader) + payload.size()*sizeof(uint16_t);
+}
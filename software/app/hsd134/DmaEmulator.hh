@@ -0,0 +1,88 @@
+#ifndef HSD_DmaEmulator_hh
+#define HSD_DmaEmulator_hh
+
+#include "DmaGenerator.hh"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Events in the FMC134 format, made in software, for running the
+    //  readout without a card.  Streams 0 and 1 are the two 3200 MS/s
+    //  channels, stream 2 their interleave (over the first half of the
+    //  window, as many samples as a channel), and stream 3 the
+    //  interleave sparsified by the firmware model (see Sparsifier).
+    //
+    //  Events are generated at the configured rate (see DmaGenerator).
+    //  The payloads are built once from a small set of templates so
+    //  that generating costs little more than the copy.
+    //
+    //  Options, comma separated key=value:
+    //    rate=<Hz>        0 for as fast as the reader returns buffers
+    //    streams=<mask>   of streams 0-3
+    //    length=<n>       samples per channel, a multiple of 40
+    //    lanes=<mask>     lanes the events rotate over
+    //    buffers=<n>      DMA buffers
+    //    pattern=ramp|pulse
+    //    lo=<v>,hi=<v>    stream 3 keeps samples outside [lo,hi], in
+    //                     corrected units [Default: 0x3f00,0x4100]
+    //    before=<n>,after=<n>  super-samples kept around those
+    //    baseline=<v>     of the baseline correction ahead of the
+    //                     sparsifier, as by the firmware, the corrections
+    //                     being the pedestal [Default: 0x4000]; 0 for none
+    //                     (lo/hi are then ADC units)
+    //    seed=<n>
+    //
+    class DmaEmulator : public DmaGenerator {
+    public:
+      enum Pattern { Ramp, Pulse };
+      class Config {
+      public:
+        Config();
+        bool parse(const char* options);
+      public:
+        double   rate;
+        unsigned streams;
+        unsigned length;
+        unsigned lanes;
+        unsigned buffers;
+        Pattern  pattern;
+        unsigned lo;
+        unsigned hi;
+        unsigned rowsBefore;
+        unsigned rowsAfter;
+        unsigned baseline;
+        unsigned seed;
+      };
+    public:
+      DmaEmulator(const Config&);
+      ~DmaEmulator();
+      //  "emu[:options]"; 0 if the options don't parse
+      static DmaEmulator* create(const char* name);
+    public:
+      const Config& config() const { return _config; }
+    protected:
+      bool     _interval (uint64_t& ns);
+      unsigned _fill     (void* buffer, uint32_t& dest);
+    private:
+      void     _build    ();
+    private:
+      enum { Templates=16 };
+      Config                _config;
+      bool                  _valid;
+      std::vector<uint16_t> _payload[Templates];   // after the event header
+      std::vector<unsigned> _streamOffset[Templates];  // of each stream header
+      std::vector<unsigned> _lanes;
+      unsigned              _ilane;
+      uint64_t              _period;
+      uint64_t              _pulseId;
+      uint64_t              _pulseStep;
+      unsigned              _nevent;
+      uint32_t              _count[8];    // per lane
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,277 @@
+#include "DmaGenerator.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+using namespace Pds::HSD;
+
+//  Pacing: sleep until this close to the next event, then spin
+static const uint64_t SPIN_NS = 100000;
+//  Give up catching up with a schedule this far behind
+static const uint64_t LATE_NS = 10000000;
+//  DmaDriver.h error bit for a truncated read
+static const uint32_t ERR_MAX = 0x04;
+
+static uint64_t _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return uint64_t(tv.tv_sec)*1000000000ULL + tv.tv_nsec;
+}
+
+DmaGenerator::DmaGenerator(const char* name) :
+  _name      (name),
+  _fd        (eventfd(0, EFD_NONBLOCK)),
+  _memory    (0),
+  _bufferSize(0),
+  _free      (0),
+  _ready     (0),
+  _started   (false),
+  _done      (false),
+  _exhausted (false),
+  _events    (0),
+  _bytes     (0),
+  _stalls    (0),
+  _dumpTime  (_now()),
+  _dumpEvents(0),
+  _dumpBytes (0),
+  _dumpStalls(0)
+{
+  if (_fd < 0)
+    perror("DmaGenerator eventfd");
+}
+
+DmaGenerator::~DmaGenerator()
+{
+  _stop();
+  if (_memory)
+    munmap(_memory, size_t(_bufferSize)*_buffers.size());
+  if (_fd >= 0)
+    close(_fd);
+  delete _free;
+  delete _ready;
+}
+
+bool DmaGenerator::_allocate(unsigned buffers, unsigned bufferSize)
+{
+  if (_fd < 0 || !buffers)
+    return false;
+
+  _bufferSize = (bufferSize + 4095) & ~4095U;
+  void* p = mmap(0, size_t(_bufferSize)*buffers, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+  if (p == MAP_FAILED) {
+    perror("DmaGenerator buffers");
+    return false;
+  }
+  _memory = reinterpret_cast<char*>(p);
+  _free   = new SpscQueue<uint32_t>(buffers);
+  _ready  = new SpscQueue<Rx>      (buffers);
+  for(unsigned i=0; i<buffers; i++) {
+    _buffers.push_back(_memory + size_t(i)*_bufferSize);
+    _free->push(i);
+  }
+  return true;
+}
+
+void DmaGenerator::_stop()
+{
+  if (_started) {
+    _done.store(true);
+    pthread_join(_thread, 0);
+    _started = false;
+  }
+}
+
+void* DmaGenerator::_routine(void* arg)
+{
+  reinterpret_cast<DmaGenerator*>(arg)->_generate();
+  return 0;
+}
+
+//
+//  Started by the reader's first call, so that events are not queued
+//  up while it sets up
+//
+void DmaGenerator::_start()
+{
+  if (_started || !_memory)
+    return;
+  _started  = true;
+  _dumpTime = _now();
+  if (pthread_create(&_thread, 0, _routine, this)) {
+    perror("DmaGenerator thread");
+    _started = false;
+  }
+}
+
+void DmaGenerator::_generate()
+{
+  uint64_t next = _now();
+
+  while(!_done.load(std::memory_order_relaxed)) {
+    uint64_t interval;
+    if (!_interval(interval))
+      break;
+
+    if (interval) {
+      next += interval;
+      uint64_t t = _now();
+      if (t > next + LATE_NS)
+        next = t;
+      else if (next > t + SPIN_NS) {
+        uint64_t w = next - SPIN_NS;
+        timespec ts;
+        ts.tv_sec  = w / 1000000000ULL;
+        ts.tv_nsec = w % 1000000000ULL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0);
+      }
+      while(_now() < next)
+        ;
+    }
+
+    //  Triggers are held off while the reader has all the buffers
+    uint32_t index;
+    if (!_free->pop(index)) {
+      _stalls.fetch_add(1, std::memory_order_relaxed);
+      for(unsigned spin=0; !_free->pop(index); spin++) {
+        if (_done.load(std::memory_order_relaxed))
+          return;
+        if (spin > 1000)
+          usleep(10);
+      }
+      next = _now();
+    }
+
+    Rx rx;
+    rx.index = index;
+    rx.size  = _fill(_buffers[index], rx.dest);
+    _ready->push(rx);
+    if (_ready->occupancy()==1)
+      _signal();
+
+    _events.fetch_add(1, std::memory_order_relaxed);
+    _bytes .fetch_add(rx.size, std::memory_order_relaxed);
+  }
+
+  //  Wake the reader to find the end
+  _exhausted.store(true, std::memory_order_release);
+  _signal();
+}
+
+bool DmaGenerator::finished() const
+{
+  return _exhausted.load(std::memory_order_acquire) && !_ready->occupancy();
+}
+
+//
+//  The reader clears the eventfd before taking events, so an event
+//  queued after the clear either is taken or sets it again.
+//
+void DmaGenerator::_signal()
+{
+  uint64_t one = 1;
+  if (::write(_fd, &one, sizeof(one)) < 0)
+    perror("DmaGenerator signal");
+}
+
+void DmaGenerator::_clear()
+{
+  uint64_t v;
+  ssize_t r = ::read(_fd, &v, sizeof(v));   // EAGAIN if already clear
+  (void)r;
+}
+
+void** DmaGenerator::map(uint32_t* count, uint32_t* size)
+{
+  _start();
+  if (count) *count = _buffers.size();
+  if (size ) *size  = _bufferSize;
+  return _buffers.data();
+}
+
+void DmaGenerator::unmap(void**)
+{
+}
+
+ssize_t DmaGenerator::readBulk(uint32_t  count,
+                               int32_t*  ret,
+                               uint32_t* index,
+                               uint32_t* flags,
+                               uint32_t* error,
+                               uint32_t* dest)
+{
+  _start();
+  _clear();
+  uint32_t n = 0;
+  Rx rx;
+  while(n < count && _ready->pop(rx)) {
+    ret  [n] = rx.size;
+    index[n] = rx.index;
+    if (flags) flags[n] = 0;
+    if (error) error[n] = 0;
+    if (dest ) dest [n] = rx.dest;
+    n++;
+  }
+  if (_ready->occupancy())
+    _signal();
+  return n;
+}
+
+ssize_t DmaGenerator::release(uint32_t count, uint32_t* index)
+{
+  for(uint32_t i=0; i<count; i++)
+    _free->push(index[i]);
+  return 0;
+}
+
+ssize_t DmaGenerator::read(void*     buf,
+                           size_t    maxSize,
+                           uint32_t* flags,
+                           uint32_t* error,
+                           uint32_t* dest)
+{
+  _start();
+  _clear();
+  Rx rx;
+  if (!_ready->pop(rx))
+    return 0;
+  if (_ready->occupancy())
+    _signal();
+
+  size_t n = rx.size < maxSize ? rx.size : maxSize;
+  memcpy(buf, _buffers[rx.index], n);
+  _free->push(rx.index);
+
+  if (flags) *flags = 0;
+  if (error) *error = n < rx.size ? ERR_MAX : 0;
+  if (dest ) *dest  = rx.dest;
+  return n;
+}
+
+void DmaGenerator::dump()
+{
+  uint64_t t      = _now();
+  uint64_t events = _events.load(std::memory_order_relaxed);
+  uint64_t bytes  = _bytes .load(std::memory_order_relaxed);
+  uint64_t stalls = _stalls.load(std::memory_order_relaxed);
+  double   dt     = double(t - _dumpTime)*1.e-9;
+  if (dt <= 0 || !_ready)
+    return;
+
+  printf("%s %9.1f Hz  %8.2f MB/s  stalls %llu  queued %u/%u\n",
+         _name,
+         double(events - _dumpEvents)/dt,
+         double(bytes  - _dumpBytes )/dt*1.e-6,
+         (unsigned long long)(stalls - _dumpStalls),
+         _ready->occupancy(), unsigned(_buffers.size()));
+
+  _dumpTime   = t;
+  _dumpEvents = events;
+  _dumpBytes  = bytes;
+  _dumpStalls = stalls;
+}
@@ -0,0 +1,93 @@
+#ifndef HSD_DmaGenerator_hh
+#define HSD_DmaGenerator_hh
+
+#include "DmaSource.hh"
+#include "SpscQueue.hh"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Common part of the software sources.  A generator thread fills
+    //  the free buffers as events fall due and queues them to the
+    //  reader, pausing while none are free (as the card does under flow
+    //  control).  An eventfd is readable while events wait, so readers
+    //  poll it as they would the device.
+    //
+    //  Derived classes size the buffers with _allocate(), provide the
+    //  events through _interval() and _fill(), and call _stop() from
+    //  their destructor.
+    //
+    class DmaGenerator : public DmaSource {
+    public:
+      virtual ~DmaGenerator();
+    public:
+      int     fd      () const { return _fd; }
+      bool    finished() const;
+      void**  map     (uint32_t* count, uint32_t* size);
+      void    unmap   (void** buffers);
+      ssize_t readBulk(uint32_t  count,
+                       int32_t*  ret,
+                       uint32_t* index,
+                       uint32_t* flags,
+                       uint32_t* error,
+                       uint32_t* dest);
+      ssize_t release (uint32_t count, uint32_t* index);
+      ssize_t read    (void*     buf,
+                       size_t    maxSize,
+                       uint32_t* flags,
+                       uint32_t* error,
+                       uint32_t* dest);
+      void    dump    ();
+    protected:
+      DmaGenerator(const char* name);
+      bool     _allocate(unsigned buffers, unsigned bufferSize);
+      void     _stop    ();
+      //  Generator thread: the time from the previous event to the
+      //  next, 0 for as soon as a buffer is free; false when there are
+      //  no more events
+      virtual bool     _interval(uint64_t& ns) = 0;
+      //  Generator thread: the next event into the buffer; returns its
+      //  size
+      virtual unsigned _fill    (void* buffer, uint32_t& dest) = 0;
+    private:
+      static void* _routine(void*);
+      void     _start    ();
+      void     _generate ();
+      void     _signal   ();
+      void     _clear    ();
+    private:
+      class Rx {
+      public:
+        uint32_t index;
+        uint32_t size;
+        uint32_t dest;
+      };
+      const char*           _name;
+      int                   _fd;
+      char*                 _memory;
+      uint32_t              _bufferSize;
+      std::vector<void*>    _buffers;
+      SpscQueue<uint32_t>*  _free;
+      SpscQueue<Rx>*        _ready;
+      pthread_t             _thread;
+      bool                  _started;
+      std::atomic<bool>     _done;
+      std::atomic<bool>     _exhausted;
+    private:
+      std::atomic<uint64_t> _events;
+      std::atomic<uint64_t> _bytes;
+      std::atomic<uint64_t> _stalls;      // waits for a free buffer
+      uint64_t              _dumpTime;
+      uint64_t              _dumpEvents;
+      uint64_t              _dumpBytes;
+      uint64_t              _dumpStalls;
+    };
+  };
+};
+
+#endif
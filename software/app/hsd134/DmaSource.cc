@@ -0,0 +1,69 @@
+#include "DmaSource.hh"
+#include "DmaEmulator.hh"
+#include "ReplaySource.hh"
+#include "DmaDriver.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace Pds::HSD;
+
+namespace {
+  //
+  //  The DMA device, through the driver calls
+  //
+  class DeviceSource : public DmaSource {
+  public:
+    DeviceSource(int fd) : _fd(fd) {}
+    ~DeviceSource() { close(_fd); }
+  public:
+    int     fd    () const { return _fd; }
+    bool    device() const { return true; }
+    void**  map   (uint32_t* count, uint32_t* size)
+    { return dmaMapDma(_fd, count, size); }
+    void    unmap (void** buffers)
+    { dmaUnMapDma(_fd, buffers); }
+    ssize_t readBulk(uint32_t count, int32_t* ret, uint32_t* index,
+                     uint32_t* flags, uint32_t* error, uint32_t* dest)
+    { return dmaReadBulkIndex(_fd, count, ret, index, flags, error, dest); }
+    ssize_t release(uint32_t count, uint32_t* index)
+    { return dmaRetIndexes(_fd, count, index); }
+    ssize_t read  (void* buf, size_t maxSize,
+                   uint32_t* flags, uint32_t* error, uint32_t* dest)
+    {
+      DmaReadData r;
+      memset(&r, 0, sizeof(r));
+      r.data = reinterpret_cast<uintptr_t>(buf);
+      r.size = maxSize;
+      r.is32 = (sizeof(void*)==4);
+      ssize_t n = ::read(_fd, &r, sizeof(r));
+      if (n <= 0)
+        return n;
+      if (flags) *flags = r.flags;
+      if (error) *error = r.error;
+      if (dest ) *dest  = r.dest;
+      //  The datadev driver returns the size in ret, the pgpdaq
+      //  driver in size
+      return r.ret ? r.ret : r.size;
+    }
+  private:
+    int _fd;
+  };
+};
+
+DmaSource* DmaSource::open(const char* name)
+{
+  if (strncmp(name, "emu", 3)==0 && (name[3]==0 || name[3]==':'))
+    return DmaEmulator::create(name);
+  if (strncmp(name, "replay:", 7)==0)
+    return ReplaySource::create(name);
+
+  int fd = ::open(name, O_RDWR);
+  if (fd < 0) {
+    perror(name);
+    return 0;
+  }
+  return new DeviceSource(fd);
+}
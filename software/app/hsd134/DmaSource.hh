@@ -0,0 +1,54 @@
+#ifndef HSD_DmaSource_hh
+#define HSD_DmaSource_hh
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Where a reader gets its events: the DMA device, or a software
+    //  source serving events through the same calls.  The calls follow
+    //  DmaDriver.h: events are read by index into the mapped buffers
+    //  and the indices returned when done with, or copied out one at a
+    //  time.  fd() polls readable when an event is waiting.
+    //
+    //  A source is read, and its buffers returned, from one thread.
+    //
+    class DmaSource {
+    public:
+      virtual ~DmaSource() {}
+      //  "emu[:options]" for the emulator (see DmaEmulator),
+      //  "replay:<file>[,options]" for a recording (see ReplaySource),
+      //  anything else is a device file.  Returns 0 on failure.
+      static DmaSource* open(const char* name);
+    public:
+      virtual int     fd      () const = 0;
+      //  True for the hardware, whose registers are mapped through fd()
+      virtual bool    device  () const { return false; }
+      //  True once a finite source has served all of its events
+      virtual bool    finished() const { return false; }
+      virtual void**  map     (uint32_t* count, uint32_t* size) = 0;
+      virtual void    unmap   (void** buffers) = 0;
+      //  Up to count events; returns the number read, <0 on error
+      virtual ssize_t readBulk(uint32_t  count,
+                               int32_t*  ret,
+                               uint32_t* index,
+                               uint32_t* flags,
+                               uint32_t* error,
+                               uint32_t* dest) = 0;
+      virtual ssize_t release (uint32_t count, uint32_t* index) = 0;
+      //  Copies one event; returns its size, 0 if none, <0 on error
+      virtual ssize_t read    (void*     buf,
+                               size_t    maxSize,
+                               uint32_t* flags,
+                               uint32_t* error,
+                               uint32_t* dest) = 0;
+    public:
+      virtual void    dump    () {}
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "DmaWait.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+
+using namespace Pds::HSD;
+
+//  Block at most this long so that the reader still sees its exit
+//  conditions when no events arrive
+static const int      POLL_TIMEOUT_MS = 100;
+//  Adaptive: block immediately when events are further apart than this
+//  many spin windows
+static const unsigned POLL_INTERVALS  = 20;
+//  Wake-up times in ns up to 4.3 s, 1/16 relative resolution
+static const unsigned RANGE_BITS = 32;
+static const unsigned SUB_BITS   = 4;
+
+static uint64_t _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return uint64_t(tv.tv_sec)*1000000000ULL + tv.tv_nsec;
+}
+
+static uint64_t _cpuNow(clockid_t c)
+{
+  timespec tv;
+  if (clock_gettime(c, &tv))
+    return 0;
+  return uint64_t(tv.tv_sec)*1000000000ULL + tv.tv_nsec;
+}
+
+DmaWait::DmaWait(int      fd,
+                 Policy   policy,
+                 unsigned spinUs) :
+  reads     (0),
+  events    (0),
+  blocks    (0),
+  timeouts  (0),
+  spurious  (0),
+  wakeups   (0),
+  wakeNs    (0),
+  wakeMax   (0),
+  wakeHist  (new ::HSD::Histogram(RANGE_BITS, 1.e-3, SUB_BITS)),
+  _fd       (fd),
+  _policy   (policy),
+  _current  (policy==Adaptive ? SpinPoll : policy),
+  _spinNs   (uint64_t(spinUs)*1000),
+  _idle     (false),
+  _idleStart(0),
+  _woken    (false),
+  _wokeAt   (0),
+  _lastEvent(0),
+  _interval (0),
+  _dumpReads (0),
+  _dumpEvents(0)
+{
+  //  Constructed by the reader thread
+  if (pthread_getcpuclockid(pthread_self(), &_cpu))
+    _cpu = CLOCK_PROCESS_CPUTIME_ID;
+  _dumpTime = _now();
+  _dumpCpu  = _cpuNow(_cpu);
+}
+
+DmaWait::~DmaWait()
+{
+  delete wakeHist;
+}
+
+bool DmaWait::policy(const char* s, Policy& p)
+{
+  if      (strcmp(s,"spin"    )==0) p = Spin;
+  else if (strcmp(s,"spinpoll")==0) p = SpinPoll;
+  else if (strcmp(s,"poll"    )==0) p = Poll;
+  else if (strcmp(s,"adaptive")==0) p = Adaptive;
+  else return false;
+  return true;
+}
+
+const char* DmaWait::name(Policy p)
+{
+  static const char* _names[] = { "spin", "spinpoll", "poll", "adaptive" };
+  return p <= Adaptive ? _names[p] : "?";
+}
+
+bool DmaWait::wait()
+{
+  _woken = false;
+
+  //  Events are pending
+  if (!_idle)
+    return true;
+
+  //  Adaptive only learns the interval from reads that return events,
+  //  so a stall is judged by how long the reader has been idle
+  uint64_t idle = _now() - _idleStart;
+  if (_policy == Adaptive) {
+    if (idle > POLL_INTERVALS*_spinNs)
+      _current = Poll;
+    else if (idle > _spinNs && _current == Spin)
+      _current = SpinPoll;
+  }
+
+  //  Events expected soon
+  if (_current==Spin)
+    return true;
+  if (_current==SpinPoll && idle < _spinNs)
+    return true;
+
+  pollfd pfd;
+  pfd.fd      = _fd;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+  blocks++;
+  int r = ::poll(&pfd, 1, POLL_TIMEOUT_MS);
+  if (r < 0) {
+    if (errno == EINTR)
+      return true;
+    perror("DmaWait poll");
+    return false;
+  }
+  if (r == 0) {
+    timeouts++;
+    return true;
+  }
+  _woken  = true;
+  _wokeAt = _now();
+  return true;
+}
+
+void DmaWait::read(unsigned nevents)
+{
+  reads++;
+  if (!nevents) {
+    if (!_idle) {
+      _idle      = true;
+      _idleStart = _now();
+    }
+    if (_woken)
+      spurious++;
+    return;
+  }
+
+  uint64_t t = _now();
+  if (_woken) {
+    uint64_t dt = t - _wokeAt;
+    wakeups++;
+    wakeNs += dt;
+    if (dt > wakeMax)
+      wakeMax = dt;
+    wakeHist->bump(dt > 0xffffffffULL ? 0xffffffffU : unsigned(dt));
+  }
+
+  if (_lastEvent)
+    _adapt((t - _lastEvent)/nevents);
+  _lastEvent = t;
+  events    += nevents;
+  _idle      = false;
+}
+
+void DmaWait::_adapt(uint64_t interval)
+{
+  _interval = _interval ? (7*_interval + interval)/8 : interval;
+  if (_policy != Adaptive)
+    return;
+  if (_interval < _spinNs)
+    _current = Spin;
+  else if (_interval > POLL_INTERVALS*_spinNs)
+    _current = Poll;
+  else
+    _current = SpinPoll;
+}
+
+void DmaWait::dump()
+{
+  uint64_t t   = _now();
+  uint64_t cpu = _cpuNow(_cpu);
+  uint64_t nreads  = reads;
+  uint64_t nevents = events;
+
+  double dt   = double(t - _dumpTime);
+  double load = dt > 0 ? 100.*double(cpu - _dumpCpu)/dt : 0;
+  double rpe  = nevents > _dumpEvents ?
+    double(nreads - _dumpReads)/double(nevents - _dumpEvents) : 0;
+
+  printf("DmaWait: %s [%s]  interval %.1f us  cpu %.1f%%  reads/event %.2f  blocks %llu  timeouts %llu  spurious %llu\n",
+         name(_current), name(_policy),
+         double(_interval)*1.e-3, load, rpe,
+         (unsigned long long)blocks,
+         (unsigned long long)timeouts,
+         (unsigned long long)spurious);
+  if (wakeups) {
+    wakeHist->sum();
+    printf("  wake-up: %llu  mean %.1f us  p50 %.1f us  p99 %.1f us  max %.1f us\n",
+           (unsigned long long)wakeups,
+           double(wakeNs)*1.e-3/double(wakeups),
+           wakeHist->quantile(0.5),
+           wakeHist->quantile(0.99),
+           double(wakeMax)*1.e-3);
+  }
+
+  _dumpTime   = t;
+  _dumpCpu    = cpu;
+  _dumpReads  = nreads;
+  _dumpEvents = nevents;
+}
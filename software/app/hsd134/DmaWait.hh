@@ -0,0 +1,72 @@
+#ifndef HSD_DmaWait_hh
+#define HSD_DmaWait_hh
+
+#include "Histogram.hh"
+
+#include <stdint.h>
+#include <time.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  How a DMA reader waits for the next event.  Spin re-reads
+    //  immediately, Poll blocks in poll() as soon as a read comes back
+    //  empty, and SpinPoll keeps re-reading for a while before
+    //  blocking.  Adaptive chooses among them from the interval between
+    //  events: spin when events come faster than the spin window, block
+    //  when they are far apart.  While no events come it steps down
+    //  from spinning as the idle time passes the same limits.
+    //
+    //  The reader calls wait() before each read and read() after it
+    //  with the number of events returned.
+    //
+    class DmaWait {
+    public:
+      enum Policy { Spin, SpinPoll, Poll, Adaptive };
+      DmaWait(int      fd,
+              Policy   policy = Adaptive,
+              unsigned spinUs = 50);
+      ~DmaWait();
+    public:
+      //  Returns false if waiting failed
+      bool   wait ();
+      void   read (unsigned nevents);
+      Policy current() const { return _current; }
+    public:
+      void        dump  ();
+      static bool policy(const char*, Policy&);
+      static const char* name(Policy);
+    private:
+      void _adapt(uint64_t interval);
+    public:
+      uint64_t reads;
+      uint64_t events;
+      uint64_t blocks;      // calls to poll()
+      uint64_t timeouts;    // poll() returned nothing
+      uint64_t spurious;    // woken, but the read was empty
+      uint64_t wakeups;     // woken with an event
+      uint64_t wakeNs;      // poll() return to event in hand
+      uint64_t wakeMax;
+      ::HSD::Histogram* wakeHist;  // ns
+    private:
+      int       _fd;
+      Policy    _policy;
+      Policy    _current;
+      uint64_t  _spinNs;
+      bool      _idle;       // last read was empty
+      uint64_t  _idleStart;
+      bool      _woken;      // last wait blocked
+      uint64_t  _wokeAt;
+      uint64_t  _lastEvent;
+      uint64_t  _interval;   // ns per event, smoothed
+      clockid_t _cpu;        // reader thread CPU clock
+      //  At the last dump
+      uint64_t  _dumpTime;
+      uint64_t  _dumpCpu;
+      uint64_t  _dumpReads;
+      uint64_t  _dumpEvents;
+    };
+  };
+};
+
+#endif
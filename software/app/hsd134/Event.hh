@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 namespace Pds {
     namespace HSD {
@@ -103,7 +104,73 @@ namespace Pds {
             unsigned            _remaining;
         };
 
-        StreamIterator EventHeader::streams() const { return StreamIterator(*this); }
+        inline StreamIterator EventHeader::streams() const { return StreamIterator(*this); }
+
+        //
+        //  Stream headers of an event located once and checked against
+        //  the extent of the buffer, for direct access by stream id.
+        //  Parsing stops at the first header that is truncated, overruns
+        //  the buffer, or has an unexpected stream id.
+        //
+        class StreamIndex {
+        public:
+            enum { MaxStreams = 8 };
+            enum Error { None, Truncated, Overrun, BadStreamId };
+        public:
+            StreamIndex(const EventHeader* event, unsigned bytes) :
+                _event(event), _streams(0), _error(None)
+            {
+                const char* base = reinterpret_cast<const char*>(event);
+                unsigned    o    = sizeof(EventHeader);
+                if (bytes < o) {
+                    _error = Truncated;
+                    return;
+                }
+                unsigned mask = event->streamMask();
+                for(unsigned i=0; i<MaxStreams; i++) {
+                    if (!(mask & (1<<i)))
+                        continue;
+                    if (o + sizeof(StreamHeader) > bytes) {
+                        _error = Truncated;
+                        return;
+                    }
+                    const StreamHeader& s = *reinterpret_cast<const StreamHeader*>(base+o);
+                    if (s.stream_id() != i) {
+                        _error = BadStreamId;
+                        return;
+                    }
+                    uint64_t end = uint64_t(o) + sizeof(StreamHeader) + 2*uint64_t(s.samples());
+                    if (end > bytes) {
+                        _error = Overrun;
+                        return;
+                    }
+                    _offset[i] = o;
+                    _streams  |= 1<<i;
+                    o = end;
+                }
+            }
+        public:
+            bool     valid  () const { return _error==None; }
+            Error    error  () const { return _error; }
+            unsigned streams() const { return _streams; }   // mask of valid streams
+            //  Null if the stream is absent or invalid
+            const StreamHeader* stream(unsigned id) const
+            {
+                return (id < MaxStreams && (_streams & (1<<id))) ?
+                    reinterpret_cast<const StreamHeader*>(reinterpret_cast<const char*>(_event)+_offset[id]) : 0;
+            }
+            unsigned offset(unsigned id) const { return _offset[id]; }  // bytes from the event header
+            static const char* name(Error e)
+            {
+                static const char* _names[] = { "none", "truncated header", "stream overruns buffer", "bad stream id" };
+                return _names[e];
+            }
+        private:
+            const EventHeader* _event;
+            unsigned           _streams;
+            Error              _error;
+            unsigned           _offset[MaxStreams];
+        };
     };
 };
 
@@ -0,0 +1,180 @@
+#include "EventIndex.hh"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace Pds::HSD;
+
+void IndexEntry::fill(const uint32_t* p, unsigned size)
+{
+  memset(this, 0, sizeof(*this));
+  this->size = size;
+  if (size < 32)
+    return;
+
+  pulseId    = (uint64_t(p[1])<<32) | p[0];
+  timestamp  = (uint64_t(p[3])<<32) | p[2];
+  streamMask = (p[6]>>20)&0xff;
+
+  //  Walk the stream headers for the sample counts
+  const uint32_t* end = p + size/4;
+  const uint32_t* q   = p + 8;
+  for(unsigned i=0; i<4; i++) {
+    if (!(streamMask & (1<<i)))
+      continue;
+    if (q+4 > end)
+      break;
+    unsigned nsamples = q[0]&0x3fffffff;
+    samples[i] = nsamples;
+    q += 4 + nsamples/2;
+  }
+}
+
+void IndexEntry::dump() const
+{
+  printf("%10u  %14llu  %8u  %u.%09u  %014llx  %u  %02x  %6u %6u %6u %6u\n",
+         event,
+         (unsigned long long)offset,
+         size,
+         seconds(), nanoseconds(),
+         (unsigned long long)pulseId,
+         lane, streamMask,
+         samples[0], samples[1], samples[2], samples[3]);
+}
+
+IndexWriter::IndexWriter() : _f(0), _buffer(0) {}
+
+IndexWriter::~IndexWriter()
+{
+  close();
+}
+
+bool IndexWriter::open(const char* path)
+{
+  close();
+  if (!(_f = fopen(path,"w"))) {
+    perror(path);
+    return false;
+  }
+  _buffer = new char[1<<20];
+  setvbuf(_f, _buffer, _IOFBF, 1<<20);
+
+  IndexHeader hdr;
+  hdr.magic     = IndexHeader::Magic;
+  hdr.version   = IndexHeader::Version;
+  hdr.entrySize = sizeof(IndexEntry);
+  hdr.reserved  = 0;
+  fwrite(&hdr, sizeof(hdr), 1, _f);
+  return true;
+}
+
+void IndexWriter::close()
+{
+  if (_f) {
+    fclose(_f);
+    _f = 0;
+  }
+  delete[] _buffer;
+  _buffer = 0;
+}
+
+void IndexWriter::write(const IndexEntry& e)
+{
+  if (_f)
+    fwrite(&e, sizeof(e), 1, _f);
+}
+
+IndexReader::IndexReader() : _map(0), _mapSize(0), _entries(0), _n(0) {}
+
+IndexReader::~IndexReader()
+{
+  close();
+}
+
+bool IndexReader::open(const char* path)
+{
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat s;
+  if (fstat(fd, &s) || size_t(s.st_size) < sizeof(IndexHeader)) {
+    printf("%s: not an index file\n", path);
+    ::close(fd);
+    return false;
+  }
+  _mapSize = s.st_size;
+  _map = mmap(0, _mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (_map == MAP_FAILED) {
+    perror("mmap index");
+    _map = 0;
+    return false;
+  }
+
+  const IndexHeader& hdr = *reinterpret_cast<const IndexHeader*>(_map);
+  if (hdr.magic   != IndexHeader::Magic   ||
+      hdr.version != IndexHeader::Version ||
+      hdr.entrySize != sizeof(IndexEntry)) {
+    printf("%s: bad index header [%08x v%u %u]\n",
+           path, hdr.magic, hdr.version, hdr.entrySize);
+    close();
+    return false;
+  }
+
+  _entries = reinterpret_cast<const IndexEntry*>(&hdr+1);
+  //  A truncated last entry (run still being written) is ignored
+  _n = (_mapSize - sizeof(hdr)) / sizeof(IndexEntry);
+  madvise(_map, _mapSize, MADV_RANDOM);
+  return true;
+}
+
+void IndexReader::close()
+{
+  if (_map)
+    munmap(_map, _mapSize);
+  _map     = 0;
+  _mapSize = 0;
+  _entries = 0;
+  _n       = 0;
+}
+
+unsigned IndexReader::findEvent(uint32_t event) const
+{
+  //  Event numbers are strictly increasing within a file
+  unsigned lo = 0, hi = _n;
+  while(lo < hi) {
+    unsigned mid = lo + (hi-lo)/2;
+    if (_entries[mid].event < event)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return (lo < _n && _entries[lo].event == event) ? lo : _n;
+}
+
+unsigned IndexReader::findTime(uint64_t timestamp, unsigned window) const
+{
+  unsigned lo = 0, hi = _n;
+  while(lo < hi) {
+    unsigned mid = lo + (hi-lo)/2;
+    if (_entries[mid].timestamp < timestamp)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  unsigned first = lo;
+  unsigned begin = lo > window ? lo-window : 0;
+  for(unsigned i=begin; i<lo; i++)
+    if (_entries[i].timestamp >= timestamp) {
+      first = i;
+      break;
+    }
+  return first;
+}
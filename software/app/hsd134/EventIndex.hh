@@ -0,0 +1,81 @@
+#ifndef HSD_EventIndex_hh
+#define HSD_EventIndex_hh
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Binary index of a recorded data file.  The index file holds an
+    //  IndexHeader followed by one fixed-size IndexEntry per event in
+    //  recording order, so entries can be located by binary search.
+    //
+    class IndexHeader {
+    public:
+      enum { Magic = 0x58445348, Version = 1 };   // "HSDX"
+      uint32_t magic;
+      uint32_t version;
+      uint32_t entrySize;
+      uint32_t reserved;
+    };
+
+    class IndexEntry {
+    public:
+      //  Fill from an event (EventHeader followed by its streams)
+      void     fill(const uint32_t* event, unsigned size);
+      unsigned seconds    () const { return timestamp>>32; }
+      unsigned nanoseconds() const { return timestamp&0xffffffff; }
+      void     dump() const;
+    public:
+      uint64_t offset;       // byte offset of the event in the data file
+      uint64_t timestamp;    // seconds<<32 | nanoseconds
+      uint64_t pulseId;
+      uint32_t event;        // recorded event number
+      uint32_t size;         // bytes
+      uint8_t  lane;
+      uint8_t  streamMask;
+      uint16_t reserved;
+      uint32_t samples[4];   // per stream
+      uint32_t reserved2[3];
+    };
+
+    class IndexWriter {
+    public:
+      IndexWriter();
+      ~IndexWriter();
+    public:
+      bool open (const char* path);
+      void close();
+      void write(const IndexEntry&);
+    private:
+      FILE* _f;
+      char* _buffer;
+    };
+
+    class IndexReader {
+    public:
+      IndexReader();
+      ~IndexReader();
+    public:
+      bool     open (const char* path);
+      void     close();
+      unsigned entries() const { return _n; }
+      const IndexEntry& operator[](unsigned i) const { return _entries[i]; }
+    public:
+      //  Position of the given event number (entries() if absent)
+      unsigned findEvent(uint32_t event) const;
+      //  First entry at or after the timestamp.  Lanes are interleaved
+      //  so timestamps are only nearly ordered; the result is refined
+      //  over a window of entries preceding the binary search result.
+      unsigned findTime (uint64_t timestamp, unsigned window=64) const;
+    private:
+      void*             _map;
+      size_t            _mapSize;
+      const IndexEntry* _entries;
+      unsigned          _n;
+    };
+  };
+};
+
+#endif
@@ -1,8 +1,11 @@
 #include "hsd134/Fmc134Cpld.hh"
+#include "hsd134/Bringup.hh"
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
+#include <vector>
 
 #include "hsd134/SysLog.hh"
 #define logging psalg::SysLog
@@ -607,21 +610,28 @@ void Fmc134Cpld::adc_dump(unsigned a)
 #undef RDSTAT3
 }
 
-void Fmc134Cpld::writeRegister(DevSel   dev,
-                               unsigned address,
-                               unsigned value)
+static bool     _verify = false;
+static unsigned _settle = 0;
+
+void Fmc134Cpld::verifyTables(bool v) { _verify = v; }
+void Fmc134Cpld::spiSettle   (unsigned us) { _settle = us; }
+
+//
+//  SPI word shifted out by the CPLD for a register write
+//
+static unsigned _spiWord(unsigned dev, unsigned address, unsigned value)
 {
     unsigned data=0;
     switch(dev) {
-    case LMK:
+    case Fmc134Cpld::LMK:
         data |= (address & 0x1fff) << 16;
         data |= (value & 0xff) << 8;
         break;
-    case LMX:
+    case Fmc134Cpld::LMX:
         data |= (address & 0xf);
         data |= (value & 0xfffffff) <<4;
         break;
-    case HMC:
+    case Fmc134Cpld::HMC:
         data |= (1<<16);
         data |= (address & 0xf) << 19;
         data |= (value & 0x1ff) << 23;
@@ -631,17 +641,37 @@ void Fmc134Cpld::writeRegister(DevSel   dev,
         data |= (value & 0xff) << 8;
         break;
     }
+    return data;
+}
 
-    _i2c_data[0] = data>>0;
-    _i2c_data[1] = data>>8;
-    _i2c_data[2] = data>>16;
-    _i2c_data[3] = data>>24;
+//
+//  Wait for the last SPI command.  The proxied read of the command
+//  register is issued only after every queued write has completed on
+//  the I2C bus, which takes far longer than the CPLD needs to shift
+//  out a 32-bit word.
+//
+void Fmc134Cpld::_spiWait()
+{
+    volatile unsigned v __attribute__((unused));
+    v = _command;
+    if (_settle)
+        usleep(_settle);
+}
 
-    _command = dev;
-    usleep(10000);
+void Fmc134Cpld::writeRegister(DevSel   dev,
+                               unsigned address,
+                               unsigned value)
+{
+    unsigned data = _spiWord(dev, address, value);
 
-    volatile unsigned v __attribute__((unused));
-    v = (_i2c_read[1]<<8) | (_i2c_read[2]<<16) | (_i2c_read[3]<<24);
+    //  posted; the command write waits for them
+    _i2c_data[0].post(data>>0);
+    _i2c_data[1].post(data>>8);
+    _i2c_data[2].post(data>>16);
+    _i2c_data[3].post(data>>24);
+
+    _command = dev;
+    _spiWait();
 }
 
 unsigned Fmc134Cpld::readRegister(DevSel   dev,
@@ -666,17 +696,18 @@ unsigned Fmc134Cpld::readRegister(DevSel   dev,
         break;
     }
 
-    _i2c_data[0] = data>>0;
-    _i2c_data[1] = data>>8;
-    _i2c_data[2] = data>>16;
-    _i2c_data[3] = data>>24;
+    //  posted; the command write waits for them
+    _i2c_data[0].post(data>>0);
+    _i2c_data[1].post(data>>8);
+    _i2c_data[2].post(data>>16);
+    _i2c_data[3].post(data>>24);
 
     _command = dev;
-    usleep(10000);
+    _spiWait();
 
     if (dev==LMX) {
         _command = dev;
-        usleep(10000);
+        _spiWait();
 
         data = _read();
     }
@@ -687,6 +718,56 @@ unsigned Fmc134Cpld::readRegister(DevSel   dev,
     return data;
 }
 
+unsigned Fmc134Cpld::writeTable(const SpiReg* t,
+                                unsigned      n,
+                                bool          verify)
+{
+    //  The data bytes are held by the CPLD, so only those that change
+    //  from one entry to the next are sent.
+    unsigned last = 0;
+    for(unsigned i=0; i<n; i++) {
+        unsigned data = _spiWord(t[i].dev, t[i].address, t[i].value);
+        for(unsigned b=0; b<4; b++) {
+            unsigned v = (data>>(8*b))&0xff;
+            if (i==0 || v != ((last>>(8*b))&0xff))
+                _i2c_data[b].post(v);
+        }
+        _command.post(t[i].dev);
+        last = data;
+    }
+    _spiWait();
+
+    if (!verify)
+        return 0;
+
+    unsigned nerr = 0;
+    for(unsigned i=0; i<n; i++) {
+        const SpiReg& r = t[i];
+        if (r.flags & SpiReg::NoVerify)
+            continue;
+        if (r.dev==LMX || r.dev==HMC)
+            continue;
+        //  Only the last write to a register is expected to read back
+        bool lrewritten = false;
+        for(unsigned j=i+1; j<n; j++)
+            if (t[j].address==r.address && (t[j].dev & r.dev))
+                lrewritten = true;
+        if (lrewritten)
+            continue;
+        for(unsigned m=ADC0; m<=LMK; m<<=1) {
+            if (!(r.dev & m))
+                continue;
+            unsigned q = readRegister(DevSel(m), r.address);
+            if (q != (r.value&0xff)) {
+                printf("SPI dev 0x%x wrote(0x%04x): %02x[%02x]\n",
+                       m, r.address, r.value&0xff, q);
+                nerr++;
+            }
+        }
+    }
+    return nerr;
+}
+
 unsigned Fmc134Cpld::_read()
 { return
         ((_i2c_read[0]&0xff)<< 0) |
@@ -713,344 +794,415 @@ static const int32_t FMC134_CLOCKTREE_ERR_OK = 0;
 static const int32_t FMC134_ADC_ERR_OK       = 0;
 static const int32_t FMC134_ERR_ADC_INIT     = 1;
 
-int32_t Fmc134Cpld::default_clocktree_init(unsigned clockmode)
+//
+//  Ready conditions polled during initialization
+//
+static bool _lmx_locked(void* arg)
 {
-    logging::info("*** default_clocktree_init ***\n");
-    uint32_t dword;
-    uint32_t samplingrate_setting;
-    unsigned i2c_unit=0;
-    int32_t rc = UNITAPI_OK;     
+    //  R6 readback: DLD set, VCO calibration not running
+    unsigned v = reinterpret_cast<Fmc134Cpld*>(arg)->readRegister(Fmc134Cpld::LMX,6);
+    return (v&(1<<3)) && !(v&(1<<10));
+}
 
-    logging::info("Configured the sampling rate to 3200MSPs\n");
-    samplingrate_setting = 0x6020000;                       //0x6020000 default N=/32
-    rc = internal_ref_and_lmx_enable(i2c_unit, clockmode);
+static bool _lmk_pll2_locked(void* arg)
+{
+    unsigned v = reinterpret_cast<Fmc134Cpld*>(arg)->readRegister(Fmc134Cpld::LMK,0x183);
+    return v&2;
+}
 
-    usleep(100000);
+namespace {
+    class AdcStatus {
+    public:
+        AdcStatus(Fmc134Cpld* c, unsigned r, unsigned m) :
+            cpld(c), reg(r), mask(m), done(0) {}
+    public:
+        Fmc134Cpld* cpld;
+        unsigned    reg;
+        unsigned    mask;
+        unsigned    done;   // bit per ADC
+    };
+};
+
+//  Both ADCs report the status bits; each is read until it does
+static bool _adcs_ready(void* arg)
+{
+    AdcStatus& s = *reinterpret_cast<AdcStatus*>(arg);
+    for(unsigned ch=0; ch<2; ch++) {
+        if (s.done & (1<<ch))
+            continue;
+        unsigned v = s.cpld->readRegister(ch==0 ? Fmc134Cpld::ADC0 : Fmc134Cpld::ADC1, s.reg);
+        if ((v&s.mask)==s.mask)
+            s.done |= (1<<ch);
+    }
+    return s.done==3;
+}
 
-    // LMX Programming for 3.2GHz
-    spi_write(i2c_unit, LMX_SELECT,  5, 0x4087001);    // Force a Reset (default from codebuilder) 0x021F7001 << from data sheet default
+//
+//  Clock tree programming tables, 3200 MSPS
+//
+#define NV Fmc134Cpld::SpiReg::NoVerify
 
-    spi_write(i2c_unit, LMX_SELECT, 13, 0x4080C10);    // FOR 100MHz PDF  DLD TOL 1.7ns  0x4080C10
+// LMX Programming for 3.2GHz
+static constexpr Fmc134Cpld::SpiReg _lmx_3200[] = {
+    { Fmc134Cpld::LMX, 0, 5, 0x4087001 },               // Force a Reset (default from codebuilder) 0x021F7001 << from data sheet default
+
+    { Fmc134Cpld::LMX, 0, 13, 0x4080C10 },              // FOR 100MHz PDF  DLD TOL 1.7ns  0x4080C10
     //spi_write(i2c_unit, LMX_SELECT, 13, 0x4081C10);  // FOR 50MHz PDF  DLD TOL 6ns  0x4081C10
 
-    spi_write(i2c_unit, LMX_SELECT, 10, 0x210050C);
-    spi_write(i2c_unit, LMX_SELECT,  9, 0x03C7C03); 
-    spi_write(i2c_unit, LMX_SELECT,  8, 0x207DDBF);
-    spi_write(i2c_unit, LMX_SELECT,  7, 0x004E211)     ;       // Works R/2 output on mux
+    { Fmc134Cpld::LMX, 0, 10, 0x210050C },
+    { Fmc134Cpld::LMX, 0, 9, 0x03C7C03 },
+    { Fmc134Cpld::LMX, 0, 8, 0x207DDBF },
+    { Fmc134Cpld::LMX, 0, 7, 0x004E211 },               // Works R/2 output on mux
 
-    spi_write(i2c_unit, LMX_SELECT,  6, 0x000004C);
+    { Fmc134Cpld::LMX, 0, 6, 0x000004C },
 
     //                if(rc!=UNITAPI_OK)     return rc;                                               // lOOK AT CHANGE mode TO USE CE pin... vco_sel_mode = 1
 
-    spi_write(i2c_unit, LMX_SELECT,  5, 0x0030808);    // 0x0030800 = 68MHz < OSC_FREQ < 128M     0x005080 = OSC_Freq > 512MHz         0x0010800 = OSC_FREQ =< 64MHz
+    { Fmc134Cpld::LMX, 0, 5, 0x0030808 },               // 0x0030800 = 68MHz < OSC_FREQ < 128M     0x005080 = OSC_Freq > 512MHz         0x0010800 = OSC_FREQ =< 64MHz
     //spi_write(i2c_unit, LMX_SELECT,  5, 0x0030A80);  // = 1600MHz
 
-    spi_write(i2c_unit, LMX_SELECT,  4, 0x0000000);
+    { Fmc134Cpld::LMX, 0, 4, 0x0000000 },
 
-    spi_write(i2c_unit, LMX_SELECT,  3, 0x20040BE);   // 68B4: A=45 B=40  63B4: A=45 B=35   6DBC: A=47 B=45
+    { Fmc134Cpld::LMX, 0, 3, 0x20040BE },               // 68B4: A=45 B=40  63B4: A=45 B=35   6DBC: A=47 B=45
     //spi_write(i2c_unit, LMX_SELECT,  3, 0x2002DB4);  //      = 1600MHz
     //              if(rc!=UNITAPI_OK)     return rc;                                               // OUT A and OUT B _PD deasserted  With the LR pullup a setting of 45:45 gives teh best noise/snr performance
     // original A = B = 0x2006DB4 = 45:45   0x20068A0 = 40:40   0x200638C = 35:35    0x2005E78 = 30:30    0x2004F3C = 15:15    0x2004003 = 0:0(nNonFunc)
 
+    { Fmc134Cpld::LMX, 0, 2, 0x0FD0902 },               // 0,0,OSCx2 = 0, 0, CPP=1, 1, PLL denom dont care
+    //default is 0x0FD0902
 
-    spi_write(i2c_unit, LMX_SELECT,  2, 0x0FD0902);    // 0,0,OSCx2 = 0, 0, CPP=1, 1, PLL denom dont care 
-    if(rc!=UNITAPI_OK)     return rc;                                               //default is 0x0FD0902
-
-    spi_write(i2c_unit, LMX_SELECT,  1, 0xF800001);    // C6000001  Rdivider = 1 no division   C6000008  Rdivider = 8 (800 MHz Ref 100PFD)    C6000009  Rdivider = 9 (900MHz Ref 100PFD)
+    { Fmc134Cpld::LMX, 0, 1, 0xF800001 },               // C6000001  Rdivider = 1 no division   C6000008  Rdivider = 8 (800 MHz Ref 100PFD)    C6000009  Rdivider = 9 (900MHz Ref 100PFD)
     //if(rc!=UNITAPI_OK)     return rc;                                               // 0xC640000 <<< VCO_SEL 2
-                                                                                                
+
     //0xC200001 is default
 
-    // for 10MHz ref N=320 // R0 06140000  Register, Dither disabled,VCO-CAL_Enabled, 12Nin N 020 = 32, 010 
-    //spi_write(i2c_unit, LMX_SELECT,  0, 0x6020000);  // R0 06020000  Register, Dither disabled,VCO-CAL_Enabled, 12Nin N 020 = 32, 010 
-    spi_write(i2c_unit, LMX_SELECT,  0, samplingrate_setting); //      
+    // for 10MHz ref N=320 // R0 06140000  Register, Dither disabled,VCO-CAL_Enabled, 12Nin N 020 = 32, 010
+    //spi_write(i2c_unit, LMX_SELECT,  0, 0x6020000);  // R0 06020000  Register, Dither disabled,VCO-CAL_Enabled, 12Nin N 020 = 32, 010
+    { Fmc134Cpld::LMX, 0, 0, 0x6020000 },               // R0 06020000  Register, Dither disabled,VCO-CAL_Enabled, 12Nin N 020 = 32, 010
     //if(rc!=UNITAPI_OK)     return rc;                                               // 0x6440000 <<< VCO_SEL 3
     // For 'R' = 1, Use ext red Directly 0x6280000-5MHz, 0x614000-10MHz 0x6020000-100Mhz 0x6040000-200Mhz
+};
 
-    usleep(300000);
+// HMC Programming
+static constexpr Fmc134Cpld::SpiReg _hmc_3200[] = {
+    { Fmc134Cpld::HMC, 0, 0x0, 0x1 },                   // Clear Reset
 
-    //spi_write(i2c_unit, LMX_SELECT,  0, 0x6020000);
-    spi_write(i2c_unit, LMX_SELECT,  0, samplingrate_setting);
+    { Fmc134Cpld::HMC, 0, 0x1, 0x1 },                   // Chip enable
 
-    // HMC Programming
-    spi_write(i2c_unit, HMC_SELECT, 0x0, 0x1);         // Clear Reset
+    { Fmc134Cpld::HMC, 0, 0x2, 0x91 },                  // Enable buffers 1, 5, and 8 x91 default
 
-    spi_write(i2c_unit, HMC_SELECT, 0x1, 0x1 );                // Chip enable
-        
-    spi_write(i2c_unit, HMC_SELECT, 0x2, 0x91);                // Enable buffers 1, 5, and 8 x91 default
-        
-    spi_write(i2c_unit, HMC_SELECT, 0x3, 0x1A);                // Use internal DC bias string, no internal LVPECL term, 100 ohm differential input term, toggle RFBUF XOR
-    if(rc!=UNITAPI_OK)     return rc;                                               //default 1A
-        
-    spi_write(i2c_unit, HMC_SELECT, 0x4, 0x00 );               // (x05) 3dBm gain FOR BRING-UP ONLY!!!
-        
-    spi_write(i2c_unit, HMC_SELECT, 0x5, 0x3A);                // "Biases" with reserved values...
+    { Fmc134Cpld::HMC, 0, 0x3, 0x1A },                  // Use internal DC bias string, no internal LVPECL term, 100 ohm differential input term, toggle RFBUF XOR
+    //default 1A
 
-    // LMK Programming
-    rc = reset_clock_chip(i2c_unit);                                                // Reset clock chip
+    { Fmc134Cpld::HMC, 0, 0x4, 0x00 },                  // (x05) 3dBm gain FOR BRING-UP ONLY!!!
 
-    usleep(5000);
+    { Fmc134Cpld::HMC, 0, 0x5, 0x3A },                  // "Biases" with reserved values...
+};
 
-    spi_write(i2c_unit, LMK_SELECT, 0x000 , 0x80 );    // Force a Reset
-    spi_write(i2c_unit, LMK_SELECT, 0x000 , 0x00 );    // Clear reset
-    spi_write(i2c_unit, LMK_SELECT, 0x000 , 0x10 );    // Force SPI to be 4-Wire
-    spi_write(i2c_unit, LMK_SELECT, 0x148 , 0x33 );    // CLKIN_SEL0_MUX Configured as LMK MISO Push Pull Output
-    spi_write(i2c_unit, LMK_SELECT, 0x002 , 0x00 );    // POWERDOWN Disabled (Normal Operation)     
+// LMK Programming
+static constexpr Fmc134Cpld::SpiReg _lmk_init_a[] = {
+    { Fmc134Cpld::LMK, NV, 0x000, 0x80 },               // Force a Reset
+    { Fmc134Cpld::LMK, NV, 0x000, 0x00 },               // Clear reset
+    { Fmc134Cpld::LMK, NV, 0x000, 0x10 },               // Force SPI to be 4-Wire
+    { Fmc134Cpld::LMK, 0, 0x148, 0x33 },                // CLKIN_SEL0_MUX Configured as LMK MISO Push Pull Output
+    { Fmc134Cpld::LMK, 0, 0x002, 0x00 },                // POWERDOWN Disabled (Normal Operation)
     // CLK0/1 Settings GBTCLK0 and GBTCLK1 M2C LVDS both at 320MHz
-    spi_write(i2c_unit, LMK_SELECT, 0x100 , 0x0A );    // DCLK0_1_DIV DIV_BY_10 = 320MHz 
-    spi_write(i2c_unit, LMK_SELECT, 0x101 , 0x00 );    // DCLK0_1_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x102 , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout0_1 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK0_1_DDLY[9:8] = 0, DCLK0_1_DIV[9:8 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x103 , 0x40 );    // 0 1 0 0      0 0 0 0         n/a, halfstep delay PD, CLK0 = DCLK, DCLK0 active, Dclk use divider, no_duty_cyc_cor, DCLK0_Norm_Polarity, DCLK0_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x104 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, CLK1 = DCLK, DCLK1 active, SCLK_DIS_MODE = 00, DCLK1_Norm_Polarity, DCLK1_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x105 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x106 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x107 , 0x11 );    // 0 0 0 1  0 0 0 1             LVDS, LVDS 
+    { Fmc134Cpld::LMK, 0, 0x100, 0x0A },                // DCLK0_1_DIV DIV_BY_10 = 320MHz
+    { Fmc134Cpld::LMK, 0, 0x101, 0x00 },                // DCLK0_1_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x102, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout0_1 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK0_1_DDLY[9:8] = 0, DCLK0_1_DIV[9:8 = 0
+    { Fmc134Cpld::LMK, 0, 0x103, 0x40 },                // 0 1 0 0      0 0 0 0         n/a, halfstep delay PD, CLK0 = DCLK, DCLK0 active, Dclk use divider, no_duty_cyc_cor, DCLK0_Norm_Polarity, DCLK0_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x104, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, CLK1 = DCLK, DCLK1 active, SCLK_DIS_MODE = 00, DCLK1_Norm_Polarity, DCLK1_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x105, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x106, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x107, 0x11 },                // 0 0 0 1  0 0 0 1             LVDS, LVDS
     // CLK2/3 Settings Output to FPGA 160MHz and SYSREF     may want to turn off DCLK
-    spi_write(i2c_unit, LMK_SELECT, 0x108 , 0x14 );    // DCLK2_3_DIV DIV_BY_20 = 160MHz 
-    spi_write(i2c_unit, LMK_SELECT, 0x109 , 0x00 );    // DCLK2_3_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x10A , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout2_3 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK2_DIV8,9 = 0 DCLK3_DIV8,9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x10B , 0x40 );    // 0 1 0 0      0 0 0 0         n/a, halfstep_delay_PD, CLK2 = DCLK, DCLK2 active, Dclk use divider, no_duty_cyc_cor, DCLK2_Norm_Polarity, DCLK2_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x10C , 0x20 );    // 0 0 1 0  0 0 0 0             n/a,  na, CLK3 = SCLK, DCLK3 active, SCLK_DIS_MODE = 00, DCLK3_Norm_Polarity, DCLK3_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x10D , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, SYSREF Analog_Delay disable, analog delay = 00000
-    spi_write(i2c_unit, LMK_SELECT, 0x10E , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x10F , 0x11 );    // 0 0 0 1  0 0 0 1             LVDS, LVDS
- 
+    { Fmc134Cpld::LMK, 0, 0x108, 0x14 },                // DCLK2_3_DIV DIV_BY_20 = 160MHz
+    { Fmc134Cpld::LMK, 0, 0x109, 0x00 },                // DCLK2_3_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x10A, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout2_3 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK2_DIV8,9 = 0 DCLK3_DIV8,9 = 0
+    { Fmc134Cpld::LMK, 0, 0x10B, 0x40 },                // 0 1 0 0      0 0 0 0         n/a, halfstep_delay_PD, CLK2 = DCLK, DCLK2 active, Dclk use divider, no_duty_cyc_cor, DCLK2_Norm_Polarity, DCLK2_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x10C, 0x20 },                // 0 0 1 0  0 0 0 0             n/a,  na, CLK3 = SCLK, DCLK3 active, SCLK_DIS_MODE = 00, DCLK3_Norm_Polarity, DCLK3_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x10D, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, SYSREF Analog_Delay disable, analog delay = 00000
+    { Fmc134Cpld::LMK, 0, 0x10E, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x10F, 0x11 },                // 0 0 0 1  0 0 0 1             LVDS, LVDS
+
     // CLK4/5 Settings  CLK4 Power-down CLK5 = ADC1_SYSREF LVPECL
-    spi_write(i2c_unit, LMK_SELECT, 0x110 , 0x20 );    // DCLK4_5_DIV DIV_BY_16 = 200MHz - not used
-    spi_write(i2c_unit, LMK_SELECT, 0x111 , 0x00 );    // DCLK4_5_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x112 , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout4_5 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK4_DIV8,9 = 0 DCLK5_DIV8,9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x113 , 0x40 );    // 0 1 0 1      0 0 0 0         n/a, halfstep_delay_PD, CLK4 = DCLK, DCLK4_5_PD, DCLK4_5_BYP, no_duty_cyc_cor, DCLK4_Norm_Polarity, DCLK4_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x114 , 0x20 );    // 0 0 1 0  0 0 0 0             n/a,  na, CLK5 = SYSREF, SCLK4_5_PD active, SCLK_DIS_MODE = 00, DCLK3_Norm_Polarity, DCLK3_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x115 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x116 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x117 , 0x60 );    // 0 1 1 0  0 0 0 0             CLK5 = LVPECL 2000mV, clk4_OFF
- 
+    { Fmc134Cpld::LMK, 0, 0x110, 0x20 },                // DCLK4_5_DIV DIV_BY_16 = 200MHz - not used
+    { Fmc134Cpld::LMK, 0, 0x111, 0x00 },                // DCLK4_5_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x112, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout4_5 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK4_DIV8,9 = 0 DCLK5_DIV8,9 = 0
+    { Fmc134Cpld::LMK, 0, 0x113, 0x40 },                // 0 1 0 1      0 0 0 0         n/a, halfstep_delay_PD, CLK4 = DCLK, DCLK4_5_PD, DCLK4_5_BYP, no_duty_cyc_cor, DCLK4_Norm_Polarity, DCLK4_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x114, 0x20 },                // 0 0 1 0  0 0 0 0             n/a,  na, CLK5 = SYSREF, SCLK4_5_PD active, SCLK_DIS_MODE = 00, DCLK3_Norm_Polarity, DCLK3_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x115, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x116, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x117, 0x60 },                // 0 1 1 0  0 0 0 0             CLK5 = LVPECL 2000mV, clk4_OFF
+
     // CLK6/7 CLK6 = ************** POWERDOWN *********** ADC1 CLOCK @ 3200MHz
-    spi_write(i2c_unit, LMK_SELECT, 0x118 , 0x02 );    // DCLK6_7_DIV DIV_BY_2 = 1600MHz  - not used
-    spi_write(i2c_unit, LMK_SELECT, 0x119 , 0x00 );    // DCLK6_7_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x11A , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout6 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK6_DIV 8,9 = 0 DCLK7_DIV 8,9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x11B , 0x48 );    // 0 1 0 0      1 0     0 0            n/a, halfstep delay PD, CLK6 = DCLK, DCLK6 active, Dclk6_BYPASS_DIV, no_duty_cyc_cor, DCLK6_Norm_Polarity, DCLK6_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x11C , 0x30 );    // 0 0 1 1  0 0 0 0             n/a,  na, CLK7 = SYSCLK, DCLK7_PD, SCLK_DIS_MODE = 00, DCLK7_Norm_Polarity, DCLK7_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x11D , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x11E , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x11F , 0x00 );    // 0 0 0 0  0 0 0 0             Off
- 
+    { Fmc134Cpld::LMK, 0, 0x118, 0x02 },                // DCLK6_7_DIV DIV_BY_2 = 1600MHz  - not used
+    { Fmc134Cpld::LMK, 0, 0x119, 0x00 },                // DCLK6_7_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x11A, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout6 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK6_DIV 8,9 = 0 DCLK7_DIV 8,9 = 0
+    { Fmc134Cpld::LMK, 0, 0x11B, 0x48 },                // 0 1 0 0      1 0     0 0            n/a, halfstep delay PD, CLK6 = DCLK, DCLK6 active, Dclk6_BYPASS_DIV, no_duty_cyc_cor, DCLK6_Norm_Polarity, DCLK6_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x11C, 0x30 },                // 0 0 1 1  0 0 0 0             n/a,  na, CLK7 = SYSCLK, DCLK7_PD, SCLK_DIS_MODE = 00, DCLK7_Norm_Polarity, DCLK7_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x11D, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x11E, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x11F, 0x00 },                // 0 0 0 0  0 0 0 0             Off
+
     // CLK8/9 CLK8 = ************** POWERDOWN *********** ADC0 CLOCK @ 3200MHz
-    spi_write(i2c_unit, LMK_SELECT, 0x120 , 0x02 );    // DCLK8_9_DIV DIV_BY_2 = 1600MHz  - not used
-    spi_write(i2c_unit, LMK_SELECT, 0x121 , 0x00 );    // DCLK8_9_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x122 , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout8 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK8_DIV 8,9 = 0 DCLK9_DIV 8,9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x123 , 0x48 );    // 0 1 0 0      1 0     0 0            n/a, halfstep delay PD, CLK8 = DCLK, DCLK8 active, Dclk8_BYPASS_DIV, no_duty_cyc_cor, DCLK8_Norm_Polarity, DCLK8_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x124 , 0x30 );    // 0 0 1 1  0 0 0 0             n/a,  na, CLK9 = SYSCLK, DCLK9_PD, SCLK_DIS_MODE = 00, DCLK9_Norm_Polarity, DCLK9_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x125 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x126 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x127 , 0x00 );    // 0 0 0 0  0 0 0 0             Off
- 
+    { Fmc134Cpld::LMK, 0, 0x120, 0x02 },                // DCLK8_9_DIV DIV_BY_2 = 1600MHz  - not used
+    { Fmc134Cpld::LMK, 0, 0x121, 0x00 },                // DCLK8_9_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x122, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout8 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK8_DIV 8,9 = 0 DCLK9_DIV 8,9 = 0
+    { Fmc134Cpld::LMK, 0, 0x123, 0x48 },                // 0 1 0 0      1 0     0 0            n/a, halfstep delay PD, CLK8 = DCLK, DCLK8 active, Dclk8_BYPASS_DIV, no_duty_cyc_cor, DCLK8_Norm_Polarity, DCLK8_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x124, 0x30 },                // 0 0 1 1  0 0 0 0             n/a,  na, CLK9 = SYSCLK, DCLK9_PD, SCLK_DIS_MODE = 00, DCLK9_Norm_Polarity, DCLK9_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x125, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x126, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x127, 0x00 },                // 0 0 0 0  0 0 0 0             Off
+
     // CLK10/11 Settings  CLK10 Power-down CLK11 = ADC0_SYSREF LVPECL
-    spi_write(i2c_unit, LMK_SELECT, 0x128 , 0x20 );    // DCLK10_11_DIV DIV_BY_16 = 200MHz - not used
-    spi_write(i2c_unit, LMK_SELECT, 0x129 , 0x00 );    // DCLK10_11_DDLY = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x12A , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout10_11 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK10_11_DIV8,9 = 0 DCLK10_11_DIV8,9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x12B , 0x40 );    // 0 1 0 1      0 0 0 0         n/a, halfstep_delay_PD, CLK10 = DCLK, DCLK10_11_PD, DCLK10_11_BYP, no_duty_cyc_cor, DCLK10_Norm_Polarity, DCLK10_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x12C , 0x20 );    // 0 0 1 0  0 0 0 0             n/a,  na, CLK11 = SYSREF, SCLK10_11_PD active, SCLK_DIS_MODE = 00, DCLK11_Norm_Polarity, DCLK11_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x12D , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x12E , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x12F , 0x60 );    // 0 1 0 1  0 0 0 0             CLK11 = LVPECL-2000mV, clk10_OFF  << This may Change to lower Amplitude: 0x40LVPECV-1600, 0x50=LVPECL-2000 0x60=LCPECL 
- 
+    { Fmc134Cpld::LMK, 0, 0x128, 0x20 },                // DCLK10_11_DIV DIV_BY_16 = 200MHz - not used
+    { Fmc134Cpld::LMK, 0, 0x129, 0x00 },                // DCLK10_11_DDLY = 0
+    { Fmc134Cpld::LMK, 0, 0x12A, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout10_11 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK10_11_DIV8,9 = 0 DCLK10_11_DIV8,9 = 0
+    { Fmc134Cpld::LMK, 0, 0x12B, 0x40 },                // 0 1 0 1      0 0 0 0         n/a, halfstep_delay_PD, CLK10 = DCLK, DCLK10_11_PD, DCLK10_11_BYP, no_duty_cyc_cor, DCLK10_Norm_Polarity, DCLK10_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x12C, 0x20 },                // 0 0 1 0  0 0 0 0             n/a,  na, CLK11 = SYSREF, SCLK10_11_PD active, SCLK_DIS_MODE = 00, DCLK11_Norm_Polarity, DCLK11_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x12D, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x12E, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x12F, 0x60 },                // 0 1 0 1  0 0 0 0             CLK11 = LVPECL-2000mV, clk10_OFF  << This may Change to lower Amplitude: 0x40LVPECV-1600, 0x50=LVPECL-2000 0x60=LCPECL
+
     // CLK12/13 GBTCLK2  and GBTCLK3 M2C LVDS both at 320MHz
-    spi_write(i2c_unit, LMK_SELECT, 0x130 , 0x0A );    // DIV_CLKOUT0 DIV_BY_10 = 320MHz 
-    spi_write(i2c_unit, LMK_SELECT, 0x131 , 0x00 );    // delay unused
-    spi_write(i2c_unit, LMK_SELECT, 0x132 , 0x70 );    // 0 1 1 1  0 0 0 0             CLKout0 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK0_DIV8, 9 = 0 DCLK1_DIV8, 9 = 0
-    spi_write(i2c_unit, LMK_SELECT, 0x133 , 0x40 );    // 0 1 0 0      0 0 0 0         n/a, halfstep delay PD, CLK0 = DCLK, DCLK0 active, Dclk use divider, no_duty_cyc_cor, DCLK0_Norm_Polarity, DCLK0_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x134 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, na, CLK1 = DCLK,  DCLK1 active, SCLK_DIS_MODE = 00, DCLK1_Norm_Polarity, DCLK1_No_Halfstep
-    spi_write(i2c_unit, LMK_SELECT, 0x135 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
-    spi_write(i2c_unit, LMK_SELECT, 0x136 , 0x00 );    // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay 
-    spi_write(i2c_unit, LMK_SELECT, 0x137 , 0x11 );    // 0 0 0 1  0 0 0 1             LVDS, LVDS
- 
+    { Fmc134Cpld::LMK, 0, 0x130, 0x0A },                // DIV_CLKOUT0 DIV_BY_10 = 320MHz
+    { Fmc134Cpld::LMK, 0, 0x131, 0x00 },                // delay unused
+    { Fmc134Cpld::LMK, 0, 0x132, 0x70 },                // 0 1 1 1  0 0 0 0             CLKout0 active, Hi-perf_out, Hi-Perf_In, Dig_Delay_Powered_down, DCLK0_DIV8, 9 = 0 DCLK1_DIV8, 9 = 0
+    { Fmc134Cpld::LMK, 0, 0x133, 0x40 },                // 0 1 0 0      0 0 0 0         n/a, halfstep delay PD, CLK0 = DCLK, DCLK0 active, Dclk use divider, no_duty_cyc_cor, DCLK0_Norm_Polarity, DCLK0_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x134, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, na, CLK1 = DCLK,  DCLK1 active, SCLK_DIS_MODE = 00, DCLK1_Norm_Polarity, DCLK1_No_Halfstep
+    { Fmc134Cpld::LMK, 0, 0x135, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, No_analog_Delay, 00000= analog delay
+    { Fmc134Cpld::LMK, 0, 0x136, 0x00 },                // 0 0 0 0  0 0 0 0             n/a, n/a, n/a, n/a, 0000 = digital delay
+    { Fmc134Cpld::LMK, 0, 0x137, 0x11 },                // 0 0 0 1  0 0 0 1             LVDS, LVDS
+
     // the default mode uses the LMX2581 as a clock source so PLL1 must be disabled
 
     // Select VCO1 PLL1 source
-    spi_write(i2c_unit, LMK_SELECT, 0x138 , 0x40 );    // 0 1 0 0  0 0 0 0   CLKin1(externla VCO) Buf_osc_in, PowerDown 
-    spi_write(i2c_unit, LMK_SELECT, 0x139 , 0x03 );    // SYSREF_MUX, SYSREF_Free_Running_Output     SYSREF MUST BE initially ON (TBD) 
- 
+    { Fmc134Cpld::LMK, 0, 0x138, 0x40 },                // 0 1 0 0  0 0 0 0   CLKin1(externla VCO) Buf_osc_in, PowerDown
+    { Fmc134Cpld::LMK, 0, 0x139, 0x03 },                // SYSREF_MUX, SYSREF_Free_Running_Output     SYSREF MUST BE initially ON (TBD)
+
     // SYSREF Divider
-    spi_write(i2c_unit, LMK_SELECT, 0x13A , 0x01 );    // SYSREF_DIV(MS) SYSREF Divider    3200 / 320 = 10MHz
-    spi_write(i2c_unit, LMK_SELECT, 0x13B , 0x40 );    // SYSREF_DIV(LS) SYSREF Divider
-   
+    { Fmc134Cpld::LMK, 0, 0x13A, 0x01 },                // SYSREF_DIV(MS) SYSREF Divider    3200 / 320 = 10MHz
+    { Fmc134Cpld::LMK, 0, 0x13B, 0x40 },                // SYSREF_DIV(LS) SYSREF Divider
+
     // SYSREF Digital Delay
-    spi_write(i2c_unit, LMK_SELECT, 0x13C , 0x00 );    // SYSREF_DDLY(MS) SYSREF Digital Delay  - Not Used
-    spi_write(i2c_unit, LMK_SELECT, 0x13D , 0x08 );    // SYSREF_DDLY(LS) SYSREF Digital Delay  - Not Used     
-   
-    spi_write(i2c_unit, LMK_SELECT, 0x13E , 0x00 );    // SYSREF_PULSE_CNT 8 Pulses - Not Used
-   
+    { Fmc134Cpld::LMK, 0, 0x13C, 0x00 },                // SYSREF_DDLY(MS) SYSREF Digital Delay  - Not Used
+    { Fmc134Cpld::LMK, 0, 0x13D, 0x08 },                // SYSREF_DDLY(LS) SYSREF Digital Delay  - Not Used
+
+    { Fmc134Cpld::LMK, 0, 0x13E, 0x00 },                // SYSREF_PULSE_CNT 8 Pulses - Not Used
+
     // PLL2
-    spi_write(i2c_unit, LMK_SELECT, 0x13F , 0x00 );    // (defaults not used) FB_CTRL PLL2_FB=prescaler, PLL1_FB=OSCIN   This is default for internal Oscillator, this changes on EXT osc   
-    spi_write(i2c_unit, LMK_SELECT, 0x140 , 0xF1 );    // 1 1 1 1   0 0 0 0    PLL1_PD, VCO_LDO_PD, VCO_PD, OSCin_PD, All SYSREF Normal
+    { Fmc134Cpld::LMK, 0, 0x13F, 0x00 },                // (defaults not used) FB_CTRL PLL2_FB=prescaler, PLL1_FB=OSCIN   This is default for internal Oscillator, this changes on EXT osc
+    { Fmc134Cpld::LMK, 0, 0x140, 0xF1 },                // 1 1 1 1   0 0 0 0    PLL1_PD, VCO_LDO_PD, VCO_PD, OSCin_PD, All SYSREF Normal
     //if(rc!=UNITAPI_OK)     return rc;                                               // 0x01 default
     //try 0xf1
-    spi_write(i2c_unit, LMK_SELECT, 0x141 , 0x00 );    // Dynamic digital delay step = no adjust
-    spi_write(i2c_unit, LMK_SELECT, 0x142 , 0x00 );    // DIG_DLY_STEP_CNT No Adjustment of Digital Delay     
-   
-    spi_write(i2c_unit, LMK_SELECT, 0x143 , 0x70 );    // SYNC_SYSREF SYNC functionality enabled, prevent SYNC pin and DLD flags from generating SYNC event
+    { Fmc134Cpld::LMK, 0, 0x141, 0x00 },                // Dynamic digital delay step = no adjust
+    { Fmc134Cpld::LMK, 0, 0x142, 0x00 },                // DIG_DLY_STEP_CNT No Adjustment of Digital Delay
+
+    { Fmc134Cpld::LMK, 0, 0x143, 0x70 },                // SYNC_SYSREF SYNC functionality enabled, prevent SYNC pin and DLD flags from generating SYNC event
     //if(rc!=UNITAPI_OK)     return rc;                                               // DCLK12, DCLK10, DCLK8 do not re-sync during a sync event   ((*** SAME as 120 ***))??
-    spi_write(i2c_unit, LMK_SELECT, 0x144 , 0xFF );    // DISABLE_DCLK_SYNC Prevent SYSREF clocks from synchronizing     
+    { Fmc134Cpld::LMK, 0, 0x144, 0xFF },                // DISABLE_DCLK_SYNC Prevent SYSREF clocks from synchronizing
 
     // new R counter sync function
-    spi_write(i2c_unit, LMK_SELECT, 0x145 , 0x00 );    // No Information yet and probably not applicable     
-   
-    spi_write(i2c_unit, LMK_SELECT, 0x146 , 0x00 );    // CLKIN_SRC No AutoSwitching of clock inputs, all 3 CLKINx pins are set t0 Bipolar
-   
-    // fmc134 LMK Clock inputs are : clkin0 = trigger, clkin1 = LMX_OUT, clkin2 = off, OSCin = low frequency LMK, OSCout not used
-    // Buffer LMX PLL as Clock Source
-    if (clockmode == CLOCKTREE_CLKSRC_INTERNAL)                     
-        {                                                                                       
-            spi_write(i2c_unit, LMK_SELECT, 0x147 , 0x10 );  // 0 0 0 1  1 1 1 1  CLK_SEL_POL=hi, CLKIN_MUX_SEL= CLKIN_1 Manual = LMX2581E_ !INVERT, CLKIN1=Fin CLKIN0=SYSREF MUX
-            printf("Using LMX2581 PLL as Clock Source\n") ;
-            // !!!JOHN!!! explicitly clear ext_sample_clk_3p3 in CPLD !!!JOHN!!!
-        }
+    { Fmc134Cpld::LMK, 0, 0x145, 0x00 },                // No Information yet and probably not applicable
+
+    { Fmc134Cpld::LMK, 0, 0x146, 0x00 },                // CLKIN_SRC No AutoSwitching of clock inputs, all 3 CLKINx pins are set t0 Bipolar
+};
+
+// Buffer LMX PLL as Clock Source (internal clock mode)
+static constexpr Fmc134Cpld::SpiReg _lmk_clkin_lmx[] = {
+    { Fmc134Cpld::LMK, 0, 0x147, 0x10 },                // 0 0 0 1  1 1 1 1  CLK_SEL_POL=hi, CLKIN_MUX_SEL= CLKIN_1 Manual = LMX2581E_ !INVERT, CLKIN1=Fin CLKIN0=SYSREF MUX
+};
+
+static constexpr Fmc134Cpld::SpiReg _lmk_init_b[] = {
+    { Fmc134Cpld::LMK, 0, 0x148, 0x33 },                // CLKIN_SEL0_MUX Configured as LMK MISO Push Pull Output
+    { Fmc134Cpld::LMK, 0, 0x149, 0x00 },                // LKIN_SEL1=input     << Not used
+    { Fmc134Cpld::LMK, 0, 0x14A, 0x00 },                //  RESET_MUX RESET Pin=Input Active High
+    { Fmc134Cpld::LMK, 0, 0x14B, 0x02 },                // default      Disabled holdover DAC but leave at 0x200
+    { Fmc134Cpld::LMK, 0, 0x14C, 0x00 },                // default      disabled but leave DAC at midscale 0x0200
+    { Fmc134Cpld::LMK, 0, 0x14D, 0x00 },                // default      DAC_TRIP_LOW Min Voltage to force HOLDOVER
+    { Fmc134Cpld::LMK, 0, 0x14E, 0x00 },                // default      DAC_TRIP_HIGH Mult=4 Max Voltage to force HOLDOVER
+    { Fmc134Cpld::LMK, 0, 0x14F, 0x7F },                // default      DAC_UPDATE_CNTR
+    { Fmc134Cpld::LMK, 0, 0x150, 0x00 },                // default      HOLDOVER_SET HOLDOVER disable  << NEW Functionality
+    { Fmc134Cpld::LMK, 0, 0x151, 0x02 },                // default      HOLD_EXIT_COUNT(MS)
+    { Fmc134Cpld::LMK, 0, 0x152, 0x00 },                // default      HOLD_EXIT_COUNT(LS)
 
-    spi_write(i2c_unit, LMK_SELECT, 0x148 , 0x33 );    // CLKIN_SEL0_MUX Configured as LMK MISO Push Pull Output
-    spi_write(i2c_unit, LMK_SELECT, 0x149 , 0x00 );    // LKIN_SEL1=input     << Not used
-    spi_write(i2c_unit, LMK_SELECT, 0x14A , 0x00 );    //  RESET_MUX RESET Pin=Input Active High
-    spi_write(i2c_unit, LMK_SELECT, 0x14B , 0x02 );    // default      Disabled holdover DAC but leave at 0x200
-    spi_write(i2c_unit, LMK_SELECT, 0x14C , 0x00 );    // default      disabled but leave DAC at midscale 0x0200
-    spi_write(i2c_unit, LMK_SELECT, 0x14D , 0x00 );    // default      DAC_TRIP_LOW Min Voltage to force HOLDOVER
-    spi_write(i2c_unit, LMK_SELECT, 0x14E , 0x00 );    // default      DAC_TRIP_HIGH Mult=4 Max Voltage to force HOLDOVER
-    spi_write(i2c_unit, LMK_SELECT, 0x14F , 0x7F );    // default      DAC_UPDATE_CNTR
-    spi_write(i2c_unit, LMK_SELECT, 0x150 , 0x00 );    // default      HOLDOVER_SET HOLDOVER disable  << NEW Functionality
-    spi_write(i2c_unit, LMK_SELECT, 0x151 , 0x02 );    // default      HOLD_EXIT_COUNT(MS)
-    spi_write(i2c_unit, LMK_SELECT, 0x152 , 0x00 );    // default      HOLD_EXIT_COUNT(LS)
-   
     //PLL1 CLKIN0 R Divider Not Used
-    spi_write(i2c_unit, LMK_SELECT, 0x153 , 0x00 );    //not used      CLKIN0_DIV (MS)
-    spi_write(i2c_unit, LMK_SELECT, 0x154 , 0x80 );    //not used      CLKIN0_DIV (LS)
-   
-    //PLL1 CLKIN1 R Divider Not Used 
-    spi_write(i2c_unit, LMK_SELECT, 0x155 , 0x00 );    // Not Used     CLKIN1_DIV (MS)     
-    spi_write(i2c_unit, LMK_SELECT, 0x156 , 0X80 );    // Not Used     CLKIN1_DIV (LS)   
-
-    //PLL1 CLKIN2 R Divider not Used 
-    spi_write(i2c_unit, LMK_SELECT, 0x157 , 0x03 );    // Not Used     CLKIN2_DIV (MS) 
-        
-    spi_write(i2c_unit, LMK_SELECT, 0x158 , 0xE8 );    // Not Used     CLKIN2_DIV (LS)      
-   
+    { Fmc134Cpld::LMK, 0, 0x153, 0x00 },                //not used      CLKIN0_DIV (MS)
+    { Fmc134Cpld::LMK, 0, 0x154, 0x80 },                //not used      CLKIN0_DIV (LS)
+
+    //PLL1 CLKIN1 R Divider Not Used
+    { Fmc134Cpld::LMK, 0, 0x155, 0x00 },                // Not Used     CLKIN1_DIV (MS)
+    { Fmc134Cpld::LMK, 0, 0x156, 0X80 },                // Not Used     CLKIN1_DIV (LS)
+
+    //PLL1 CLKIN2 R Divider not Used
+    { Fmc134Cpld::LMK, 0, 0x157, 0x03 },                // Not Used     CLKIN2_DIV (MS)
+
+    { Fmc134Cpld::LMK, 0, 0x158, 0xE8 },                // Not Used     CLKIN2_DIV (LS)
+
     // This is part of a secondary configuration
-    // LMX2581 Low frequency Output for use with LMK04832 VCO & PLL2, nominal frequency 500MHz 
+    // LMX2581 Low frequency Output for use with LMK04832 VCO & PLL2, nominal frequency 500MHz
     // configured for 100MHz reference to PLL2
     // PLL1 N divider, Divide 500MHz VCSO down to PDF
-    spi_write(i2c_unit, LMK_SELECT, 0x159 , 0x00 );    // PLL1_NDIV (MS)  PLL1 Ndivider = 5000 for 100HHz PDF    
-    spi_write(i2c_unit, LMK_SELECT, 0x15A , 0x05 );    // PLL1_NDIV (LS)       500MHz/5 = 100MHz PFD
-   
+    { Fmc134Cpld::LMK, 0, 0x159, 0x00 },                // PLL1_NDIV (MS)  PLL1 Ndivider = 5000 for 100HHz PDF
+    { Fmc134Cpld::LMK, 0, 0x15A, 0x05 },                // PLL1_NDIV (LS)       500MHz/5 = 100MHz PFD
+
     // PLL1 Configuration
-    spi_write(i2c_unit, LMK_SELECT, 0x15B , 0xF4 );    // PLL1 Pasive CPout1 tristate, Pos Slope, 50uA 
-    spi_write(i2c_unit, LMK_SELECT, 0x15C , 0x20 );    // Default not used 
-    spi_write(i2c_unit, LMK_SELECT, 0x15D , 0x00 );    // Default not used 
-    spi_write(i2c_unit, LMK_SELECT, 0x15E , 0x00 );    // default not used 
-    spi_write(i2c_unit, LMK_SELECT, 0x15F , 0x03 );    // Pasive Forced Logic Low Push_Pull 
-   
+    { Fmc134Cpld::LMK, 0, 0x15B, 0xF4 },                // PLL1 Pasive CPout1 tristate, Pos Slope, 50uA
+    { Fmc134Cpld::LMK, 0, 0x15C, 0x20 },                // Default not used
+    { Fmc134Cpld::LMK, 0, 0x15D, 0x00 },                // Default not used
+    { Fmc134Cpld::LMK, 0, 0x15E, 0x00 },                // default not used
+    { Fmc134Cpld::LMK, 0, 0x15F, 0x03 },                // Pasive Forced Logic Low Push_Pull
+
     //      In the default usage PLL2 is pasivated
-    // default mode is LMK provides a 400MHz reference clock and the PLL multiples it up to 3200? TBD 
+    // default mode is LMK provides a 400MHz reference clock and the PLL multiples it up to 3200? TBD
     // PLL2 onfigured to lock VCO1 at 3000MHz to 500MHz from LMX with a PFD of 125MHz, (4N * 6P = 24) * 125MHz = 3000MHz
-    // a prescale value of 6 allows the PLL2 N and R to match 
-    spi_write(i2c_unit, LMK_SELECT, 0x160 , 0x00 ) ;   // PLL2_RDIV (MS) PLL2 Reference Divider = 4 refference frequency = 125MHz   
-    spi_write(i2c_unit, LMK_SELECT, 0x161 , 0x04 ) ;   // PLL2_RDIV (LS)     
-    spi_write(i2c_unit, LMK_SELECT, 0x162 , 0xCC ) ;   // D0 changed to 0xCC per new Migration doc
-    spi_write(i2c_unit, LMK_SELECT, 0x163 , 0x00 ) ;   // PLL2_NCAL (HI) Only used during CAL
-    spi_write(i2c_unit, LMK_SELECT, 0x164 , 0x00 ) ;   // PLL2_NCAL (MID)              
-    spi_write(i2c_unit, LMK_SELECT, 0x165 , 0x04 ) ;   // PLL2_NCAL (LOW)
-   
+    // a prescale value of 6 allows the PLL2 N and R to match
+    { Fmc134Cpld::LMK, 0, 0x160, 0x00 },                // PLL2_RDIV (MS) PLL2 Reference Divider = 4 refference frequency = 125MHz
+    { Fmc134Cpld::LMK, 0, 0x161, 0x04 },                // PLL2_RDIV (LS)
+    { Fmc134Cpld::LMK, 0, 0x162, 0xCC },                // D0 changed to 0xCC per new Migration doc
+    { Fmc134Cpld::LMK, 0, 0x163, 0x00 },                // PLL2_NCAL (HI) Only used during CAL
+    { Fmc134Cpld::LMK, 0, 0x164, 0x00 },                // PLL2_NCAL (MID)
+    { Fmc134Cpld::LMK, 0, 0x165, 0x04 },                // PLL2_NCAL (LOW)
+
     // the following 5 writes are out of sequence per the TI programming sequence recomendations in the data sheet
-    spi_write(i2c_unit, LMK_SELECT, 0x145 , 0x00 ) ;   // << Ignore, modify R divider Sync is needed
-    spi_write(i2c_unit, LMK_SELECT, 0x171 , 0xAA ) ;   //      << Specified by TI
-    spi_write(i2c_unit, LMK_SELECT, 0x171 , 0x02 ) ;   //      << Specified by TI
-   
-    spi_write(i2c_unit, LMK_SELECT, 0x17C , 0x15 ) ;   // OPT_REG1     **** VERIFY when new data sheet arives
-    spi_write(i2c_unit, LMK_SELECT, 0x17D , 0x33 ) ;   // OPT_REG2     **** VERIFY when new data sheet arives
-   
-    spi_write(i2c_unit, LMK_SELECT, 0x166 , 0x00 ) ;   // PLL2_NDIV (HI) Allow CAL     
-    spi_write(i2c_unit, LMK_SELECT, 0x167 , 0x00 ) ;   // PLL2_NDIV (MID) PLL2 N-Divider     
-    spi_write(i2c_unit, LMK_SELECT, 0x168 , 0x04 ) ;   //      // PLL2_NDIV (LOW) Cal after writing this register     >>P = 3, N = 8  (24 * 125Mhz_ref = 3G)   
-    spi_write(i2c_unit, LMK_SELECT, 0x169 , 0x49 ) ;   // PLL2_SETUP Window 3.7nS,  I(cp)=1.6mA, Pos Slope, CP ! Tristate, Bit 0 always 1  
+    { Fmc134Cpld::LMK, 0, 0x145, 0x00 },                // << Ignore, modify R divider Sync is needed
+    { Fmc134Cpld::LMK, 0, 0x171, 0xAA },                //      << Specified by TI
+    { Fmc134Cpld::LMK, 0, 0x171, 0x02 },                //      << Specified by TI
+
+    { Fmc134Cpld::LMK, 0, 0x17C, 0x15 },                // OPT_REG1     **** VERIFY when new data sheet arives
+    { Fmc134Cpld::LMK, 0, 0x17D, 0x33 },                // OPT_REG2     **** VERIFY when new data sheet arives
+
+    { Fmc134Cpld::LMK, 0, 0x166, 0x00 },                // PLL2_NDIV (HI) Allow CAL
+    { Fmc134Cpld::LMK, 0, 0x167, 0x00 },                // PLL2_NDIV (MID) PLL2 N-Divider
+    { Fmc134Cpld::LMK, 0, 0x168, 0x04 },                //      // PLL2_NDIV (LOW) Cal after writing this register     >>P = 3, N = 8  (24 * 125Mhz_ref = 3G)
+    { Fmc134Cpld::LMK, 0, 0x169, 0x49 },                // PLL2_SETUP Window 3.7nS,  I(cp)=1.6mA, Pos Slope, CP ! Tristate, Bit 0 always 1
     // 1.6mA gives better close in phase  noise than 3.2mA
 
-    spi_write(i2c_unit, LMK_SELECT, 0x16A , 0x00 ) ;   // PLL2_LOCK_CNT (MS)      
-    spi_write(i2c_unit, LMK_SELECT, 0x16B , 0x20 ) ;   // PLL2_LOCK_CNT (LS)  PD must be in lock for 16 cycles    
-    spi_write(i2c_unit, LMK_SELECT, 0x16C , 0x00 ) ;   // PLL2_LOOP_FILTER_R Disable Internal Resistors        << Uses externla Loop Filter 
+    { Fmc134Cpld::LMK, 0, 0x16A, 0x00 },                // PLL2_LOCK_CNT (MS)
+    { Fmc134Cpld::LMK, 0, 0x16B, 0x20 },                // PLL2_LOCK_CNT (LS)  PD must be in lock for 16 cycles
+    { Fmc134Cpld::LMK, 0, 0x16C, 0x00 },                // PLL2_LOOP_FILTER_R Disable Internal Resistors        << Uses externla Loop Filter
     // R3 = 200 Ohms  R4 = 200 Ohms
 
-    spi_write(i2c_unit, LMK_SELECT, 0x16D , 0x00 ) ;   // PLL2_LOOP_FILTER_C Disable Internal Caps             << uses externla loop filter
+    { Fmc134Cpld::LMK, 0, 0x16D, 0x00 },                // PLL2_LOOP_FILTER_C Disable Internal Caps             << uses externla loop filter
     // C3 = 10pF  C4 = 10pF
 
-    spi_write(i2c_unit, LMK_SELECT, 0x16E , 0x12 ) ;   // // STATUS_LD2_MUX LD2=Locked   Push Pull Output
-   
-    // this disables PLL2
-    if(1) {
-        spi_write(i2c_unit, LMK_SELECT, 0x173 , 0x60 ) ;   // 0 1 1 0 0 0 0 0  0x60 PLL2_Prescale_PD PLL2_PD 
-        //if(rc!=UNITAPI_OK)     return rc;                                               //0x00 original
-        printf("LMK PLL2 Powered Down\n") ;
-    }
-
-    // This Enables PLL2
-    if(0) {
-        spi_write(i2c_unit, LMK_SELECT, 0x173 , 0x00 ) ;   // PLL2_MISC PLL2 Active, normal opperation  
-        printf("LMK PLL2 Active \n") ;
-    }       
+    { Fmc134Cpld::LMK, 0, 0x16E, 0x12 },                // // STATUS_LD2_MUX LD2=Locked   Push Pull Output
 
-    usleep(100000);  // allow PLL to lock, not required in buffermode but does not hurt
-
-    // Clear LMK PLL2 Erros regardless of if we use them
-    spi_write(i2c_unit, LMK_SELECT, 0x183, 0x01 ) ;
-    if(rc!=UNITAPI_OK)     return rc;
-    spi_write(i2c_unit, LMK_SELECT, 0x183, 0x00 ) ;
-    if(rc!=UNITAPI_OK)     return rc;
-
-    // IF we are using LMK04832 PLL2 then wait500ms  to see if we ever go out of lock
-    if (clockmode == CLOCKTREE_CLKSRC_INTERNAL )
-        {
-            unitapi_sleep_ms(500);          //      Look for half a sec to see if PLL is unlocked
+    // this disables PLL2 (0x00 enables it)
+    { Fmc134Cpld::LMK, 0, 0x173, 0x60 },                // 0 1 1 0 0 0 0 0  0x60 PLL2_Prescale_PD PLL2_PD
+};
 
-            // verify LMK04832 PLL2 status
-            spi_read(i2c_unit, LMK_SELECT, 0x183, &dword ) ;
-            if(rc!=UNITAPI_OK)
-                return rc;
+// Clear LMK PLL2 Erros regardless of if we use them
+static constexpr Fmc134Cpld::SpiReg _lmk_pll2_clear[] = {
+    { Fmc134Cpld::LMK, NV, 0x183, 0x01 },
+    { Fmc134Cpld::LMK, NV, 0x183, 0x00 },
+};
 
-            //dword2 = (dword & 0x07);
-            if ((dword&0x02)!=0x02) {
-                //printf("LMK04832 PLL2 not locked!!! reg 0x183 = 0x%X\n",dword2);      
-                // not an error
-                //return FMC134_CLOCKTREE_ERR_CLK0_PLL_NOT_LOCKED;
-            }
-            else {
-                printf("PLL2 locked!!! \n");
-            }
-        }
-    // try to sync all the output dividers
+// try to sync all the output dividers
+static constexpr Fmc134Cpld::SpiReg _lmk_sync_a[] = {
     // SYNC_MODE enable to SYNC event
     // SYSREF_CLR = 1
     // SYNC_1SHOT_EN = 1
     // SYNC_POL = 0 (Normal)
     // SYNC_EN = 1
     // SYNC_MODE = 1 (sync_event_generatedfrom SYNC pin)
-    spi_write(i2c_unit, LMK_SELECT, 0x143, 0xD1);
+    { Fmc134Cpld::LMK, 0, 0x143, 0xD1 },
 
     // change SYSREF_MUX to normal SYNC (0)
-    spi_write(i2c_unit, LMK_SELECT, 0x139, 0x00);
+    { Fmc134Cpld::LMK, 0, 0x139, 0x00 },
 
     // Enable dividers reset
-    spi_write(i2c_unit, LMK_SELECT, 0x144, 0x00);
+    { Fmc134Cpld::LMK, 0, 0x144, 0x00 },
 
     //toggle the polarity (keep SYSREF_CLR active)
-    spi_write(i2c_unit, LMK_SELECT, 0x143, 0xF1);
-
-    unitapi_sleep_ms(10);
+    { Fmc134Cpld::LMK, 0, 0x143, 0xF1 },
+};
 
-    spi_write(i2c_unit, LMK_SELECT, 0x143, 0xD1);
+static constexpr Fmc134Cpld::SpiReg _lmk_sync_b[] = {
+    { Fmc134Cpld::LMK, 0, 0x143, 0xD1 },
     // disable dividers
-    spi_write(i2c_unit, LMK_SELECT, 0x144, 0xFF);
+    { Fmc134Cpld::LMK, 0, 0x144, 0xFF },
 
     // change SYSREF_MUX back to continuous
-    spi_write(i2c_unit, LMK_SELECT, 0x139, 0x03);
+    { Fmc134Cpld::LMK, 0, 0x139, 0x03 },
 
     // restore SYNC_MODE & remove SYSREF_CLR
-    spi_write(i2c_unit, LMK_SELECT, 0x143, 0x50);
+    { Fmc134Cpld::LMK, 0, 0x143, 0x50 },
+};
+
+#undef NV
+
+int32_t Fmc134Cpld::default_clocktree_init(unsigned clockmode)
+{
+    logging::info("*** default_clocktree_init ***\n");
+    uint32_t samplingrate_setting;
+    unsigned i2c_unit=0;
+    int32_t rc = UNITAPI_OK;     
+
+    logging::info("Configured the sampling rate to 3200MSPs\n");
+    samplingrate_setting = 0x6020000;                       //0x6020000 default N=/32
+    rc = internal_ref_and_lmx_enable(i2c_unit, clockmode);
+
+    Bringup::settle(100);
+
+    // LMX Programming for 3.2GHz
+    writeTable(_lmx_3200, _verify);
+    if(rc!=UNITAPI_OK)     return rc;
+
+    //  Wait for the VCO calibration and lock (up to 300 ms)
+    Bringup::wait("LMX lock", _lmx_locked, this, 300, 0);
+
+    spi_write(i2c_unit, LMX_SELECT,  0, samplingrate_setting);
+
+    // HMC Programming
+    writeTable(_hmc_3200, _verify);
+
+    // LMK Programming
+    rc = reset_clock_chip(i2c_unit);                                                // Reset clock chip
+
+    usleep(5000);
+
+    unsigned nerr = writeTable(_lmk_init_a, _verify);
+
+    // fmc134 LMK Clock inputs are : clkin0 = trigger, clkin1 = LMX_OUT, clkin2 = off, OSCin = low frequency LMK, OSCout not used
+    // Buffer LMX PLL as Clock Source
+    if (clockmode == CLOCKTREE_CLKSRC_INTERNAL)                     
+        {                                                                                       
+            nerr += writeTable(_lmk_clkin_lmx, _verify);
+            printf("Using LMX2581 PLL as Clock Source\n") ;
+            // !!!JOHN!!! explicitly clear ext_sample_clk_3p3 in CPLD !!!JOHN!!!
+        }
+
+    nerr += writeTable(_lmk_init_b, _verify);
+    printf("LMK PLL2 Powered Down\n") ;
+
+    if (nerr)
+        logging::error("LMK readback: %u registers differ\n", nerr);
+
+    // Clear LMK PLL2 Erros regardless of if we use them
+    writeTable(_lmk_pll2_clear);
+
+    // IF we are using LMK04832 PLL2 then wait500ms  to see if we ever go out of lock
+    if (clockmode == CLOCKTREE_CLKSRC_INTERNAL )
+        {
+            //      Look for half a sec for the PLL to lock
+            // verify LMK04832 PLL2 status
+            if (!Bringup::wait("LMK PLL2 lock", _lmk_pll2_locked, this, 500, 0)) {
+                //printf("LMK04832 PLL2 not locked!!! reg 0x183 = 0x%X\n",dword2);      
+                // not an error
+                //return FMC134_CLOCKTREE_ERR_CLK0_PLL_NOT_LOCKED;
+            }
+            else {
+                printf("PLL2 locked!!! \n");
+            }
+        }
+    // try to sync all the output dividers
+    writeTable(_lmk_sync_a);
+
+    unitapi_sleep_ms(10);
+
+    writeTable(_lmk_sync_b);
 
     logging::info("*** default_clocktree_init done ***\n");
     return 0;
@@ -1197,6 +1349,44 @@ int32_t Fmc134Cpld::reset_clock_chip(int32_t)
     return 0;
 }
 
+//
+//  ADC programming up to the SYSREF calibration, both chips at once
+//
+#define NV Fmc134Cpld::SpiReg::NoVerify
+static constexpr Fmc134Cpld::SpiReg _adc_config[] = {
+    // Reset part
+    { Fmc134Cpld::ADC_BOTH, NV, 0x0000, 0xB0 },
+
+    // Set the D Clock  and SYSREF input pins to LVPECL
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x002A, 0x06 },
+
+    // Set Timestamp input pins to LVPECL but do not enable timestamp
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x003B, 0x02 },
+
+    // Invert ADC0 Clock            (write to only ADC0)
+    { Fmc134Cpld::ADC0    , 0 , 0x02B7, 0x01 },
+
+    // Enable SYSREF Processor
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x0029, 0x20 },
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x0029, 0x60 },
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // JESD Initializaton
+    // Reset JESD during configuration
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x0200, 0x00 },
+
+    // Clear Cal Enable AFTER clearing JESD Enable during configuration
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x0061, 0x00 },
+
+    // Enable SYSREF Calibration while background calibration is disabled
+    // Set 256 averages with 256 cycles per accumulation
+    { Fmc134Cpld::ADC_BOTH, 0 , 0x02B1, 0x0F },
+
+    // Start SYSREF Calibration (~0.1 sec)
+    { Fmc134Cpld::ADC_BOTH, NV, 0x02B0, 0x01 },
+};
+#undef NV
+
 int32_t Fmc134Cpld::default_adc_init(AdcCalibMode cmode,
                                      std::string& calib_adc0,
                                      std::string& calib_adc1,
@@ -1231,67 +1421,19 @@ int32_t Fmc134Cpld::default_adc_init(AdcCalibMode cmode,
 
     unitapi_sleep_ms(2);            
 
-    // Reset part
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0000, 0xB0);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Set the D Clock  and SYSREF input pins to LVPECL
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x002A, 0x06);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Set Timestamp input pins to LVPECL but do not enable timestamp
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x003B, 0x02);
-    if(rc!=UNITAPI_OK) return rc;
+    writeTable(_adc_config, _verify);
         
-    // Invert ADC0 Clock            (write to only ADC0)
-    spi_write(i2c_unit, ADC0_SELECT, 0x02B7, 0x01);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Enable SYSREF Processor
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0029, 0x20);
-    if(rc!=UNITAPI_OK) return rc;
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0029, 0x60);
-    if(rc!=UNITAPI_OK) return rc;
-
-    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    // JESD Initializaton
-    // Reset JESD during configuration
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0200, 0x00);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Clear Cal Enable AFTER clearing JESD Enable during configuration
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0061, 0x00);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Enable SYSREF Calibration while background calibration is disabled
-    // Set 256 averages with 256 cycles per accumulation
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x02B1, 0x0F);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Start SYSREF Calibration
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x02B0, 0x01);
-    if(rc!=UNITAPI_OK) return rc;
-        
-    unitapi_sleep_ms(500);
-
     // Read SYSREF Calibration status
-    spi_read(i2c_unit, ADC0_SELECT, 0x02B4, &dword0);
-    if(rc!=UNITAPI_OK) return rc;
-
-    if ((dword0 & 0x2) == 0x2)
-        logging::info("ADC0 SYSREF Calibration Done\n");
-    else {
-        logging::error("ADC0 SYSREF Calibration NOT Done!\n");
-        return FMC134_ERR_ADC_INIT;
-    }
-    spi_read(i2c_unit, ADC1_SELECT, 0x02B4, &dword0);
-    if(rc!=UNITAPI_OK) return rc;
-
-    if ((dword0 & 0x2) == 0x2)
-        logging::info("ADC1 SYSREF Calibration Done\n");
-    else {
-        logging::error("ADC1 SYSREF Calibration NOT Done!\n");
-        return FMC134_ERR_ADC_INIT;
+    { AdcStatus status(this, 0x02B4, 0x2);
+      Bringup::wait("ADC SYSREF calibration", _adcs_ready, &status, 1000, 10000);
+      for(unsigned ch=0; ch<2; ch++) {
+          if (status.done & (1<<ch))
+              logging::info("ADC%d SYSREF Calibration Done\n",ch);
+          else {
+              logging::error("ADC%d SYSREF Calibration NOT Done!\n",ch);
+              return FMC134_ERR_ADC_INIT;
+          }
+      }
     }
         
     switch(cmode) {
@@ -1310,47 +1452,31 @@ int32_t Fmc134Cpld::default_adc_init(AdcCalibMode cmode,
     if(rc!=UNITAPI_OK) return rc;
 
     // Set JMODE = 2 (or 0 for single channel mode)
-    if (lDualChannel) {
-        spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0060, (inputCh==CHAN_A0_2 ? 0:0x10));
-        spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0201, 0x02);
-        if(rc!=UNITAPI_OK) return rc;
-    } else {
-        spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0060, (inputCh==CHAN_A0_2 ? 1:2));
-        spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0201, 0x00);
-        if(rc!=UNITAPI_OK) return rc;
-    }
-
-    // Set K = 16
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0202, 0x0F);
-    if(rc!=UNITAPI_OK) return rc;
-
-    // Keep output format as 2's complement and ENABLE Scrambler
-    //spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0204, 0x03);
-    // Use binary offset output format and ENABLE Scrambler
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0204, 0x01);
-    if(rc!=UNITAPI_OK) return rc;
-
-        
-    if (cmode!=NO_CAL) {
+    unsigned input = lDualChannel ?
+        (inputCh==CHAN_A0_2 ? 0:0x10) :
+        (inputCh==CHAN_A0_2 ? 1:2);
+    const SpiReg jesd[] = {
+        { ADC_BOTH, 0, 0x0060, input },
+        { ADC_BOTH, 0, 0x0201, lDualChannel ? 0x02u:0x00u },
+        // Set K = 16
+        { ADC_BOTH, 0, 0x0202, 0x0F },
+        // Keep output format as 2's complement and ENABLE Scrambler
+        //{ ADC_BOTH, 0, 0x0204, 0x03 },
+        // Use binary offset output format and ENABLE Scrambler
+        { ADC_BOTH, 0, 0x0204, 0x01 },
         // Set Cal Enable BEFORE setting JESD Enable after configuration
-        spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0061, 0x01);
-    }
-
-    // Take JESD out of reset after configuration
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0200, 0x01);
-    if(rc!=UNITAPI_OK) return rc;
-
-#if 1
-    // full scale range ** this setting directly affects the ADC SNR  **
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0030, 0xFF);        // NOTE this setting directly affects the ADC SNR
-    if(rc!=UNITAPI_OK) return rc;                                                           // 0x0000 ~500mVp-p puts the max SNR at ~ 48.8dBFS
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0031, 0xFF);        // 0xA4C4 ~725mVp-p puts the max SNR at ~ 55.5dBFS (Default value at reset)
-    if(rc!=UNITAPI_OK) return rc;                                                           // 0xFFFF ~950mVp-p puts the max SNR at ~ 56.5dBFS
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0032, 0xFF);
-    if(rc!=UNITAPI_OK) return rc;
-    spi_write(i2c_unit, ADC_SELECT_BOTH, 0x0033, 0xFF);
-    if(rc!=UNITAPI_OK) return rc;
-#endif
+        { ADC_BOTH, 0, 0x0061, cmode!=NO_CAL ? 0x01u:0x00u },
+        // Take JESD out of reset after configuration
+        { ADC_BOTH, 0, 0x0200, 0x01 },
+        // full scale range ** this setting directly affects the ADC SNR  **
+        { ADC_BOTH, 0, 0x0030, 0xFF },      // NOTE this setting directly affects the ADC SNR
+                                            // 0x0000 ~500mVp-p puts the max SNR at ~ 48.8dBFS
+        { ADC_BOTH, 0, 0x0031, 0xFF },      // 0xA4C4 ~725mVp-p puts the max SNR at ~ 55.5dBFS (Default value at reset)
+                                            // 0xFFFF ~950mVp-p puts the max SNR at ~ 56.5dBFS
+        { ADC_BOTH, 0, 0x0032, 0xFF },
+        { ADC_BOTH, 0, 0x0033, 0xFF },
+    };
+    writeTable(jesd, _verify);
 
     // verify ADC1 is present, This verifys the SPI connection to ADC 1 is present
     unsigned dw[4];
@@ -1377,49 +1503,42 @@ int32_t Fmc134Cpld::default_adc_init(AdcCalibMode cmode,
     if(rc!=UNITAPI_OK) return rc;
 #endif
 
-    if (cmode==FG_CAL) {
-        // Dump trim registers
-        adc_cal_dump(0);
-        adc_cal_dump(1);
+    //  Restore the trims of a previous calibration in place of running one
+    bool lrestored = false;
+    if (cmode==FG_CAL && !calib_adc0.empty() && !calib_adc1.empty()) {
+        lrestored = adc_cal_load(0, calib_adc0) && adc_cal_load(1, calib_adc1);
+        if (lrestored)
+            logging::info("ADC FG Calibration restored\n");
+        else
+            logging::warning("ADC FG Calibration restore failed; recalibrating\n");
+    }
 
+    if (cmode==FG_CAL && !lrestored) {
         spi_write(i2c_unit, ADC_SELECT_BOTH, 0x006C, 0x00); // trigger
         spi_read(i2c_unit, ADC0_SELECT, 0x006C, &dword0);
         logging::info("CAL_TRIG 0x%x\n",dword0);
         spi_write(i2c_unit, ADC_SELECT_BOTH, 0x006C, 0x01); // trigger
         spi_read(i2c_unit, ADC0_SELECT, 0x006C, &dword0);
         logging::info("CAL_TRIG 0x%x\n",dword0);
+        // Read CAL status of both ADCs, calibrating together
+        AdcStatus status(this, 0x006A, 0x1);
+        Bringup::wait("ADC FG calibration", _adcs_ready, &status, 50000, 10000);
         for(unsigned ch=0; ch<2; ch++) {
-            DevSel adcsel = ch==0 ? ADC0_SELECT : ADC1_SELECT;
-            for(unsigned i=0; i<100; i++) {
-                unitapi_sleep_ms(500);
-
-                // Read CAL status
-                spi_read(i2c_unit, adcsel, 0x006A, &dword0);
-                if(rc!=UNITAPI_OK) return rc;
-                if ((dword0 & 0x1) == 0x1) {
-                    logging::info("ADC%d FG Calibration Done\n",ch);
-                    break;
-                }
-                else {
-                    logging::warning("ADC%d FG Calibration NOT Done! [%x]\n",ch,dword0);
-                }
-            }
-            if ((dword0 & 0x1) == 0)
+            if (status.done & (1<<ch))
+                logging::info("ADC%d FG Calibration Done\n",ch);
+            else {
+                logging::error("ADC%d FG Calibration NOT Done!\n",ch);
                 return FMC134_ERR_ADC_INIT;
+            }
         }
 
+        // Dump trim registers
+        calib_adc0 = adc_cal_dump(0);
+        calib_adc1 = adc_cal_dump(1);
+        logging::debug("Calib[0]: %s\n",calib_adc0.c_str());
+        logging::debug("Calib[1]: %s\n",calib_adc1.c_str());
     }
 
-    adc_cal_load(0, calib_adc0);
-    adc_cal_load(1, calib_adc1);
-
-    // Dump trim registers
-    calib_adc0 = adc_cal_dump(0);
-    logging::info("Calib[0]: %s\n",calib_adc0.c_str());
-
-    calib_adc1 = adc_cal_dump(1);
-    logging::info("Calib[1]: %s\n",calib_adc1.c_str());
-
     unitapi_sleep_ms(5);
 
     // Configure the transceiver pre-emphasis setting (0 to 0xF)
@@ -1472,12 +1591,82 @@ void Fmc134Cpld::adc_range(unsigned chip,unsigned fsrng)
     spi_write(0, dev, 0x213, (1<<3)); 
 }
 
-std::string Fmc134Cpld::adc_cal_dump(unsigned)
+//
+//  The foreground calibration result is read out (and written back)
+//  through the CAL_DATA register: with CAL_DATA_EN set, each access
+//  steps through the next byte of the calibration data.  The data may
+//  only be accessed with CAL_EN clear, which requires JESD_EN clear.
+//
+static const unsigned CAL_DATA_SIZE = 673;
+
+std::string Fmc134Cpld::adc_cal_dump(unsigned a)
 {
-  return std::string();
+    DevSel dev = (a==0) ? ADC0 : ADC1;
+    unsigned jesd_en = readRegister(dev, 0x200);
+    unsigned cal_en  = readRegister(dev, 0x061);
+
+    const SpiReg open[] = {
+        { dev, 0, 0x0200, 0x00 },
+        { dev, 0, 0x0061, 0x00 },
+        { dev, 0, 0x0070, 0x01 },
+    };
+    writeTable(open);
+
+    std::string s;
+    s.reserve(2*CAL_DATA_SIZE);
+    static const char _hex[] = "0123456789abcdef";
+    for(unsigned i=0; i<CAL_DATA_SIZE; i++) {
+        unsigned v = readRegister(dev, 0x071);
+        s += _hex[(v>>4)&0xf];
+        s += _hex[(v>>0)&0xf];
+    }
+
+    const SpiReg close[] = {
+        { dev, 0, 0x0070, 0x00 },
+        { dev, 0, 0x0061, cal_en  },
+        { dev, 0, 0x0200, jesd_en },
+    };
+    writeTable(close);
+
+    return s;
 }
 
-void        Fmc134Cpld::adc_cal_load(unsigned,const std::string&)
+bool        Fmc134Cpld::adc_cal_load(unsigned a,const std::string& s)
 {
-}
+    if (s.size() != 2*CAL_DATA_SIZE) {
+        logging::error("ADC%u calibration data has %zu characters, expected %u\n",
+                       a, s.size(), 2*CAL_DATA_SIZE);
+        return false;
+    }
+
+    DevSel dev = (a==0) ? ADC0 : ADC1;
+    unsigned jesd_en = readRegister(dev, 0x200);
+    unsigned cal_en  = readRegister(dev, 0x061);
+
+    std::vector<SpiReg> t;
+    t.reserve(CAL_DATA_SIZE+6);
+    SpiReg r;
+    r.dev   = dev;
+    r.flags = 0;
+    r.address = 0x0200; r.value = 0x00; t.push_back(r);
+    r.address = 0x0061; r.value = 0x00; t.push_back(r);
+    r.address = 0x0070; r.value = 0x01; t.push_back(r);
+    r.address = 0x0071;
+    r.flags   = SpiReg::NoVerify;
+    for(unsigned i=0; i<CAL_DATA_SIZE; i++) {
+        char* e;
+        char  b[3] = { s[2*i], s[2*i+1], 0 };
+        r.value = strtoul(b, &e, 16);
+        if (*e) {
+            logging::error("ADC%u calibration data is not hex at %u\n", a, 2*i);
+            return false;
+        }
+        t.push_back(r);
+    }
+    r.flags = 0;
+    r.address = 0x0070; r.value = 0x00;    t.push_back(r);
+    r.address = 0x0061; r.value = cal_en;  t.push_back(r);
+    r.address = 0x0200; r.value = jesd_en; t.push_back(r);
 
+    return writeTable(t.data(), t.size(), _verify)==0;
+}
@@ -4,6 +4,7 @@
 #include "RegProxy.hh"
 #include "Globals.hh"
 #include <string>
+#include <stdint.h>
 
 namespace Pds {
     namespace HSD {
@@ -20,8 +21,9 @@ namespace Pds {
             void lmk_dump();
             void lmx_dump();
             void adc_dump(unsigned);
+            //  Foreground calibration result as a hex string
             std::string adc_cal_dump(unsigned);
-            void        adc_cal_load(unsigned,const std::string&);
+            bool        adc_cal_load(unsigned,const std::string&);
             //      void adc_range(unsigned,float fs_vpp);
             void adc_range(unsigned,unsigned fsrng);
         private:
@@ -37,8 +39,33 @@ namespace Pds {
                                     unsigned data );
             unsigned readRegister ( DevSel   dev,
                                     unsigned address );
+        public:
+            //  One entry of a register programming table
+            class SpiReg {
+            public:
+                enum { NoVerify=1 };  // self-clearing or not readable
+                uint8_t  dev;         // DevSel
+                uint8_t  flags;
+                uint16_t address;
+                uint32_t value;
+            };
+            //  Streams the writes of a table, waiting for completion once
+            //  at the end.  With verify, the ADC and LMK registers are read
+            //  back; returns the number that differ.
+            unsigned writeTable   ( const SpiReg* table,
+                                    unsigned      n,
+                                    bool          verify=false );
+            template <unsigned N>
+            unsigned writeTable   ( const SpiReg (&table)[N],
+                                    bool          verify=false )
+            { return writeTable(table, N, verify); }
+            //  Readback verification of the default init tables
+            static void verifyTables(bool);
+            //  Extra delay after each SPI command (default none)
+            static void spiSettle   (unsigned us);
         private:
             unsigned _read();
+            void     _spiWait();
         public:
             void dump() const;
         public:
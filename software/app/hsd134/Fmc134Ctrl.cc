@@ -1,5 +1,6 @@
 #include "Fmc134Ctrl.hh"
 #include "Fmc134Cpld.hh"
+#include "Bringup.hh"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -72,6 +73,12 @@ public:
 static const int32_t FMC134_ERR_ADC_INIT = 1;
 static const int32_t FMC134_ERR_OK = 0;
 
+static bool _qplls_locked(void* arg)
+{
+        unsigned v = reinterpret_cast<Pds::Mmhw::Reg*>(arg)[FMC134Offset::AddrCtrl+0x02];
+        return (v&0xF00000) == 0xF00000;
+}
+
 void    Fmc134Ctrl::remote_sync ()
 {
         // Assert SYNC pin
@@ -177,7 +184,7 @@ int32_t Fmc134Ctrl::default_init(Fmc134Cpld& cpld, unsigned mode)
 
         // Wait for MGTs to adapt
         //unitapi_sleep_ms(100);
-        unitapi_sleep_ms(1000);
+        Bringup::settle(1000);
 
         // Hold TAP values, CDR, and AGCs
         unitapi_write_register(fmc_unit,  FMC134Offset::AddrCtrl+0x1, 0x1FF00); 
@@ -186,7 +193,7 @@ int32_t Fmc134Ctrl::default_init(Fmc134Cpld& cpld, unsigned mode)
         cpld.config_prbs(mode);
 
         // Wait for QPLLs to lock
-        unitapi_sleep_ms(100);
+        Bringup::wait("QPLL lock", _qplls_locked, this, 100);
 
         // Assert DIV2 Reset
         unitapi_write_register(fmc_unit,  FMC134Offset::AddrCtrl+0x01, 0x1FF02); 
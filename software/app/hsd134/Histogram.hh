@@ -1,11 +1,30 @@
 #ifndef HSD_HISTOGRAM
 #define HSD_HISTOGRAM
 
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
 namespace HSD {
+/*
+** ++
+**
+**   Counts are kept in per-thread shards, each bumped with a single
+**   relaxed increment, and summed when read.  Values beyond the last
+**   bin go to a separate overflow bin.
+**
+**   Linear binning has 1<<size bins of unit width.  Log-linear binning
+**   covers values below 1<<size with 1<<subBits bins per power of two,
+**   exact below 1<<subBits; the relative bin width is 2^-subBits.
+**
+** --
+*/
+
 class Histogram
   {
   public:
     Histogram(unsigned size, double unitsCvt);
+    Histogram(unsigned size, double unitsCvt, unsigned subBits);
    ~Histogram();
   public:
     void     sum();
@@ -14,13 +33,37 @@ class Histogram
     double   units()     const;
     double   weight()    const;
     double   counts()    const;
-    unsigned overflows() const;
-    void     bump(unsigned index);
+    uint64_t overflows() const;
+    void     bump(unsigned value);
     void     reset();
+  public:
+    double   mean    ()           const;
+    //  Value (in units) below which the fraction q of the counts lie
+    double   quantile(double q)   const;
+    unsigned bins    ()           const;
+    unsigned bin     (unsigned value) const;   // bins() for overflow
+    uint64_t lower   (unsigned bin)   const;   // lowest value in bin
+    uint64_t width   (unsigned bin)   const;
+  public:
+    //  Binary snapshot of the counts, to be merged into a histogram
+    //  with the same binning (possibly in another process)
+    size_t   snapshotSize() const;
+    size_t   snapshot(void* buffer, size_t len) const;
+    bool     merge   (const void* buffer, size_t len);
+    bool     merge   (const Histogram&);
+    //  New histogram with the binning and counts of a snapshot
+    static Histogram* create(const void* buffer, size_t len, double unitsCvt=1);
+  private:
+    enum { MaxShards = 16 };
+    typedef std::atomic<uint64_t> Counter;
+    Counter* _shard   ();
+    Counter* _allocate(unsigned);
+    void     _collect (uint64_t*) const;
   private:
-    unsigned* _buffer;        // Histogram buffer
-    unsigned  _mask;          // Control overflows
-    unsigned  _size;          // Number of entries
+    unsigned  _size;          // log2 of the range
+    unsigned  _subBits;       // log2 of the bins per octave
+    unsigned  _bins;          // in range; the overflow bin follows
+    std::atomic<Counter*> _shards[MaxShards];
     double    _totalCounts;   // # of times histogram incrmented
     double    _totalWeight;   // # of times histogram incrmented
     double    _unitsCvt;
@@ -69,25 +112,57 @@ inline double HSD::Histogram::weight() const
 ** --
 */
 
-inline unsigned HSD::Histogram::overflows() const
+inline unsigned HSD::Histogram::bins() const
+  {
+  return _bins;
+  }
+
+/*
+** ++
+**
+**    Values below 1<<subBits have their own bin.  Above, the bin is
+**    the power of two and the next subBits bits below the leading one.
+**
+** --
+*/
+
+inline unsigned HSD::Histogram::bin(unsigned value) const
+  {
+  if (value >> _subBits == 0)
+    return value;
+  if (uint64_t(value) >> _size)
+    return _bins;
+  unsigned e   = 31 - __builtin_clz(value);
+  unsigned sub = (value >> (e - _subBits)) - (1U << _subBits);
+  return ((e - _subBits + 1) << _subBits) + sub;
+  }
+
+/*
+** ++
+**
+**
+** --
+*/
+
+inline void HSD::Histogram::bump(unsigned value)
   {
-  return *_buffer;
+  _shard()[bin(value)].fetch_add(1, std::memory_order_relaxed);
   }
 
 /*
 ** ++
 **
+**    Each thread has a fixed slot; its shard is allocated on first use.
 **
 ** --
 */
 
-inline void HSD::Histogram::bump(unsigned index)
+inline HSD::Histogram::Counter* HSD::Histogram::_shard()
   {
-  unsigned* buffer = _buffer;
-  if (index < _size)
-    buffer[index]++;
-  else
-    (*buffer)++;
+  static std::atomic<unsigned> threads(0);
+  static thread_local unsigned slot = threads++ % MaxShards;
+  Counter* s = _shards[slot].load(std::memory_order_acquire);
+  return s ? s : _allocate(slot);
   }
 
 #endif
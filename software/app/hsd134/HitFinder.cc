@@ -0,0 +1,282 @@
+#include "HitFinder.hh"
+#include "Event.hh"
+
+#ifdef HSD_X86
+#include <immintrin.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+using namespace Pds::HSD;
+
+//
+//  Crossing search.  Samples are compared as signed 16-bit values
+//  after xor with flip, which turns "below level" into "above ~level"
+//  for negative pulses.  Scalar kernel also used for the tails of the
+//  vector kernels.
+//
+static unsigned _first_scalar(const uint16_t* x, unsigned i, unsigned end,
+                              uint16_t flip, int16_t level, bool v)
+{
+  for(; i<end; i++)
+    if ((int16_t(x[i]^flip) > level) == v)
+      break;
+  return i;
+}
+
+#ifdef HSD_X86
+__attribute__((target("sse4.2")))
+static unsigned _first_sse42(const uint16_t* x, unsigned i, unsigned end,
+                             uint16_t flip, int16_t level, bool v)
+{
+  const __m128i vflip  = _mm_set1_epi16(flip);
+  const __m128i vlevel = _mm_set1_epi16(level);
+  const unsigned miss  = v ? 0 : 0xffff;
+  for(; i+8<=end; i+=8) {
+    __m128i q = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i)), vflip);
+    unsigned m = unsigned(_mm_movemask_epi8(_mm_cmpgt_epi16(q, vlevel))) ^ miss;
+    if (m)
+      return i + (__builtin_ctz(m)>>1);
+  }
+  return _first_scalar(x, i, end, flip, level, v);
+}
+
+__attribute__((target("avx2")))
+static unsigned _first_avx2(const uint16_t* x, unsigned i, unsigned end,
+                            uint16_t flip, int16_t level, bool v)
+{
+  const __m256i vflip  = _mm256_set1_epi16(flip);
+  const __m256i vlevel = _mm256_set1_epi16(level);
+  const unsigned miss  = v ? 0 : 0xffffffff;
+  for(; i+16<=end; i+=16) {
+    __m256i q = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x+i)), vflip);
+    unsigned m = unsigned(_mm256_movemask_epi8(_mm256_cmpgt_epi16(q, vlevel))) ^ miss;
+    if (m)
+      return i + (__builtin_ctz(m)>>1);
+  }
+  return _first_scalar(x, i, end, flip, level, v);
+}
+#endif
+
+namespace {
+  class Kernels {
+  public:
+    unsigned (*first)(const uint16_t*, unsigned, unsigned, uint16_t, int16_t, bool);
+  };
+};
+
+static const Kernels _kernels[] = {
+  { _first_scalar },
+#ifdef HSD_X86
+  { _first_sse42 },
+  { _first_avx2  },
+#endif
+};
+
+static Simd::Isa _isa = Simd::best();
+
+unsigned HitFinder::first(const uint16_t* x, unsigned begin, unsigned end,
+                          uint16_t level, bool negative, bool v)
+{
+  uint16_t flip = negative ? 0xffff : 0;
+  return _kernels[_isa].first(x, begin, end, flip, int16_t(level^flip), v);
+}
+
+Simd::Isa HitFinder::isa() { return _isa; }
+
+bool HitFinder::select(Simd::Isa v)
+{
+  if (!Simd::supported(v))
+    return false;
+  _isa = v;
+  return true;
+}
+
+HitFinder::Config::Config() :
+  streams   (0x3),
+  keep      (0),
+  threshold (32),
+  fraction  (128),
+  baseline  (-1),
+  negative  (false),
+  pre       (2),
+  post      (8),
+  toffsScale(256)
+{
+}
+
+bool HitFinder::Config::parse(const char* options)
+{
+  std::string s(options);
+  char* save = 0;
+  for(char* tok = strtok_r(&s[0], ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+    char* v = strchr(tok, '=');
+    if (!v) {
+      printf("HitFinder: option %s has no value\n", tok);
+      return false;
+    }
+    *v++ = 0;
+    if      (!strcmp(tok, "streams"  )) streams    = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "keep"     )) keep       = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "threshold")) threshold  = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "fraction" )) fraction   = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "baseline" )) baseline   = strtol (v, 0, 0);
+    else if (!strcmp(tok, "negative" )) negative   = strtoul(v, 0, 0) != 0;
+    else if (!strcmp(tok, "pre"      )) pre        = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "post"     )) post       = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "toffs"    )) toffsScale = strtol (v, 0, 0);
+    else {
+      printf("HitFinder: unknown option %s\n", tok);
+      return false;
+    }
+  }
+  return true;
+}
+
+HitFinder::HitFinder(const Config& c, unsigned maxHits) :
+  _config  (c),
+  _hits    (maxHits ? maxHits : 1),
+  pulses   (0),
+  truncated(0)
+{
+  _config.streams &= (1<<MaxStreams)-1;
+  _config.keep    &= (1<<MaxStreams)-1;
+  if (!_config.threshold)
+    _config.threshold = 1;
+  if (_config.fraction < 1)
+    _config.fraction = 1;
+  if (_config.fraction > 256)
+    _config.fraction = 256;
+}
+
+unsigned HitFinder::find(const uint16_t* x, unsigned n, unsigned toffs,
+                         Hit* hits, unsigned maxHits)
+{
+  int b = _config.baseline;
+  if (b < 0) {
+    if (n < BaselineSamples)
+      return 0;
+    unsigned sum = 0;
+    for(unsigned i=0; i<BaselineSamples; i++)
+      sum += x[i];
+    b = (sum + BaselineSamples/2)/BaselineSamples;
+  }
+
+  //  The crossing level, kept where a sample can still pass it
+  bool neg  = _config.negative;
+  int  sign = neg ? -1 : 1;
+  int  lv   = b + sign*int(_config.threshold);
+  if (lv < 0)
+    lv = 0;
+  if (lv > 0x7fff)
+    lv = 0x7fff;
+  uint16_t flip  = neg ? 0xffff : 0;
+  int16_t  level = int16_t(uint16_t(lv)^flip);
+  const Kernels& k = _kernels[_isa];
+
+  int32_t  toff = -int32_t(toffs)*_config.toffsScale;
+  unsigned nh   = 0;
+  unsigned last = 0;   // end of the previous pulse window
+  unsigned s    = k.first(x, 0, n, flip, level, true);
+  while(s < n) {
+    unsigned e  = k.first(x, s, n, flip, level, false);
+    unsigned s1 = e < n ? k.first(x, e, n, flip, level, true) : n;
+    unsigned ws = s > last + _config.pre ? s - _config.pre : last;
+    unsigned we = e + _config.post < s1 ? e + _config.post : s1;
+    pulses++;
+
+    if (nh == maxHits)
+      truncated++;
+    else {
+      //  The peak is among the samples beyond threshold
+      int64_t  sum = 0;
+      int      pk  = 0;
+      unsigned ip  = s;
+      for(unsigned i=ws; i<we; i++) {
+        int a = sign*(int(x[i]) - b);
+        sum += a;
+        if (i >= s && i < e && a > pk) {
+          pk = a;
+          ip = i;
+        }
+      }
+
+      //  Back from the peak to the fraction, down to the previous window
+      int32_t  l256 = pk*int(_config.fraction);
+      unsigned j    = ip;
+      while(j > last && 256*sign*(int(x[j-1]) - b) >= l256)
+        j--;
+      int32_t t256;
+      if (j == last)
+        t256 = int32_t(j)*256;
+      else {
+        int a0 = sign*(int(x[j-1]) - b);
+        int a1 = sign*(int(x[j  ]) - b);
+        t256 = int32_t(j-1)*256 + (l256 - 256*a0)/(a1 - a0);
+      }
+
+      Hit& h = hits[nh++];
+      h.time     = t256 + toff;
+      h.integral = sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : int32_t(sum);
+      h.peak     = pk > 0xffff ? 0xffff : pk;
+      h.width    = e - s > 0xffff ? 0xffff : e - s;
+    }
+    last = we;
+    s    = s1;
+  }
+  return nh;
+}
+
+unsigned HitFinder::encode(const uint32_t* event, unsigned bytes,
+                           std::vector<uint16_t>& out)
+{
+  StreamIndex index(reinterpret_cast<const EventHeader*>(event), bytes);
+  if (!index.valid())
+    return 0;
+
+  const uint16_t* base = reinterpret_cast<const uint16_t*>(event);
+  out.assign(base, base + sizeof(EventHeader)/sizeof(uint16_t));
+  unsigned mask = 0;
+
+  //  Streams copied ahead of the hit streams, in stream id order
+  for(unsigned i=0; i<MaxStreams; i++) {
+    const StreamHeader* s = index.stream(i);
+    if (!s || !(_config.keep & (1<<i)))
+      continue;
+    const uint16_t* p = reinterpret_cast<const uint16_t*>(s);
+    out.insert(out.end(), p, s->data() + s->samples());
+    mask |= 1<<i;
+  }
+
+  for(unsigned i=0; i<MaxStreams; i++) {
+    const StreamHeader* s = index.stream(i);
+    if (!s || !(_config.streams & (1<<i)))
+      continue;
+    unsigned pad = s->boffs() + s->eoffs();
+    unsigned n   = s->samples() > pad ? s->samples() - pad : 0;
+    unsigned nh  = find(s->data() + s->boffs(), n, s->toffs(), _hits.data(), _hits.size());
+    //  Times from the first sample of the stream, not of the search
+    for(unsigned j=0; j<nh; j++)
+      _hits[j].time += int32_t(s->boffs())*256;
+
+    const uint32_t* w = reinterpret_cast<const uint32_t*>(s);
+    uint32_t hdr[4];
+    hdr[0] = nh*HitWords;
+    hdr[1] = ((HitStream+i)<<24) | (w[1] & 0x00ff0000);   // keep the buffer
+    hdr[2] = w[2];
+    hdr[3] = w[3];
+    const uint16_t* h = reinterpret_cast<const uint16_t*>(hdr);
+    out.insert(out.end(), h, h + sizeof(StreamHeader)/sizeof(uint16_t));
+    const uint16_t* q = reinterpret_cast<const uint16_t*>(_hits.data());
+    out.insert(out.end(), q, q + nh*HitWords);
+    mask |= 1<<(HitStream+i);
+  }
+
+  uint32_t* info = reinterpret_cast<uint32_t*>(out.data()) + 6;
+  *info = (*info & ~(0xffu<<20)) | (mask<<20);
+  return out.size()*sizeof(uint16_t);
+}
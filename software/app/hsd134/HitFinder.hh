@@ -0,0 +1,98 @@
+#ifndef HSD_HitFinder_hh
+#define HSD_HitFinder_hh
+
+#include "Simd.hh"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  A pulse found in a raw stream.  The time is that of the constant
+    //  fraction point of the leading edge, interpolated between
+    //  samples, in 1/256 samples from the first sample of the stream
+    //  less the sample clock phase (toffs).  Amplitudes are from the
+    //  baseline, in the direction of the pulse.
+    //
+    class Hit {
+    public:
+      int32_t  time;       // 1/256 samples
+      int32_t  integral;   // sum of amplitudes over the pulse window
+      uint16_t peak;       // amplitude
+      uint16_t width;      // samples beyond threshold
+    };
+
+    //
+    //  Host side hit finder for raw streams.  Vector kernels find the
+    //  threshold crossings, which leaves the per-pulse work (peak,
+    //  integral and constant fraction time) to the few samples of each
+    //  pulse.  A pulse window extends the samples beyond threshold by
+    //  pre samples before and post samples after, up to the start of
+    //  the next pulse.
+    //
+    //  encode() reduces an event to its hit lists: stream s becomes
+    //  stream HitStream+s, whose "samples" are the hits (HitWords each),
+    //  so the result is read like any recorded event.
+    //
+    //  Options, comma separated key=value:
+    //    streams=<mask>   raw streams searched [Default: 0x3]
+    //    keep=<mask>      streams copied alongside the hits [Default: 0]
+    //    threshold=<v>    amplitude of a crossing [Default: 32]
+    //    fraction=<v>     constant fraction of the peak, 1/256 [Default: 128]
+    //    baseline=<v>     -1 for the mean of the first 16 samples
+    //                     of each stream [Default: -1]
+    //    negative=<0|1>   polarity of the pulses [Default: 0]
+    //    pre=<n>,post=<n> pulse window around the crossing [Default: 2,8]
+    //    toffs=<v>        1/256 samples per count of toffs [Default: 256]
+    //
+    class HitFinder {
+    public:
+      enum { HitStream = 4, MaxStreams = 4 };
+      enum { HitWords = sizeof(Hit)/sizeof(uint16_t) };
+      enum { BaselineSamples = 16 };
+      class Config {
+      public:
+        Config();
+        bool parse(const char* options);
+      public:
+        unsigned streams;
+        unsigned keep;
+        unsigned threshold;
+        unsigned fraction;
+        int      baseline;
+        bool     negative;
+        unsigned pre;
+        unsigned post;
+        int      toffsScale;
+      };
+    public:
+      HitFinder(const Config&, unsigned maxHits=1024);
+    public:
+      const Config& config() const { return _config; }
+      //  Hits of n samples with the phase toffs.  Returns the number of
+      //  hits, at most maxHits (the rest are counted in truncated).
+      unsigned find  (const uint16_t* x, unsigned n, unsigned toffs,
+                      Hit* hits, unsigned maxHits);
+      //  The hit lists of an event (EventHeader followed by its streams)
+      //  into out.  Returns the bytes, or 0 if the event does not parse.
+      unsigned encode(const uint32_t* event, unsigned bytes,
+                      std::vector<uint16_t>& out);
+    public:
+      //  First index i >= begin where (x[i] beyond level) == v, or end.
+      //  Beyond is above, or below if negative.
+      static unsigned  first (const uint16_t* x, unsigned begin, unsigned end,
+                              uint16_t level, bool negative, bool v);
+      static Simd::Isa isa   ();
+      static bool      select(Simd::Isa);   // false if unsupported
+    private:
+      Config           _config;
+      std::vector<Hit> _hits;
+    public:
+      uint64_t         pulses;
+      uint64_t         truncated;
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "LatencyMonitor.hh"
+
+#include <stdio.h>
+
+using namespace Pds::HSD;
+
+//  Latencies in ns up to 4.3 s, 1/16 relative resolution
+static const unsigned RANGE_BITS = 32;
+static const unsigned SUB_BITS   = 4;
+
+LatencyMonitor::LatencyMonitor(int64_t   epochOffset,
+                               unsigned  driftUs,
+                               clockid_t clock) :
+  _epochOffset(epochOffset),
+  _driftUs    (driftUs),
+  _clock      (clock),
+  _npoints    (0)
+{
+}
+
+LatencyMonitor::~LatencyMonitor()
+{
+  for(unsigned i=0; i<_npoints; i++)
+    for(unsigned j=0; j<MaxLanes; j++)
+      delete _points[i].lane[j];
+}
+
+unsigned LatencyMonitor::point(const char* name)
+{
+  if (_npoints == MaxPoints) {
+    printf("LatencyMonitor: no room for point %s\n", name);
+    return MaxPoints-1;
+  }
+  Point& p = _points[_npoints];
+  p.name = name;
+  for(unsigned j=0; j<MaxLanes; j++) {
+    p.lane [j] = new ::HSD::Histogram(RANGE_BITS, 1.e-3, SUB_BITS);
+    p.early[j].store(0, std::memory_order_relaxed);
+    p.floor[j] = -1;
+  }
+  return _npoints++;
+}
+
+void LatencyMonitor::record(unsigned point, unsigned lane, const uint32_t* event)
+{
+  timespec tv;
+  clock_gettime(_clock, &tv);
+
+  //  data[2] nanoseconds, data[3] seconds
+  int64_t ts  = (int64_t(event[3]) + _epochOffset)*1000000000LL + event[2];
+  int64_t now = int64_t(tv.tv_sec)*1000000000LL + tv.tv_nsec;
+  int64_t dt  = now - ts;
+
+  Point& p = _points[point];
+  lane &= MaxLanes-1;
+  if (dt < 0)
+    p.early[lane].fetch_add(1, std::memory_order_relaxed);
+  else
+    p.lane[lane]->bump(dt > 0xffffffffLL ? 0xffffffffU : unsigned(dt));
+}
+
+void LatencyMonitor::dump()
+{
+  printf("Latency (us)     lane %10s %10s %10s %10s %10s %8s\n",
+         "min", "p50", "p99", "p999", "mean", "events");
+  for(unsigned i=0; i<_npoints; i++) {
+    Point& p = _points[i];
+    for(unsigned j=0; j<MaxLanes; j++) {
+      ::HSD::Histogram& h = *p.lane[j];
+      h.sum();
+      uint64_t over  = h.overflows();
+      uint64_t early = p.early[j].exchange(0, std::memory_order_relaxed);
+      if (h.counts()==0 && !over && !early)
+        continue;
+
+      double floor = h.quantile(0);
+      printf("  %-14.14s %4u %10.1f %10.1f %10.1f %10.1f %10.1f %8.0f",
+             p.name, j, floor,
+             h.quantile(0.5), h.quantile(0.99), h.quantile(0.999),
+             h.mean(), h.counts());
+      if (over)
+        printf("  %llu over 4s", (unsigned long long)over);
+      if (early)
+        printf("  %llu early: host clock behind", (unsigned long long)early);
+
+      //  The least latency should not move; if it does the clocks
+      //  have drifted apart
+      if (h.counts() > 0) {
+        if (p.floor[j] < 0)
+          p.floor[j] = floor;
+        else if (floor > p.floor[j] + _driftUs || floor < p.floor[j] - _driftUs)
+          printf("  DRIFT %+.1f", floor - p.floor[j]);
+      }
+      printf("\n");
+
+      h.reset();
+    }
+  }
+}
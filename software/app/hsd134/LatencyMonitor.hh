@@ -0,0 +1,60 @@
+#ifndef HSD_LatencyMonitor_hh
+#define HSD_LatencyMonitor_hh
+
+#include "Histogram.hh"
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Time from trigger to host: the event timestamp (timing system
+    //  time) against the host clock at each point the event reaches
+    //  (receive, pipeline stages).  The host clock must be disciplined
+    //  to the timing system (PTP/NTP) for the absolute values to mean
+    //  anything; a moving floor of the distribution shows drift.
+    //
+    class LatencyMonitor {
+    public:
+      enum { MaxLanes=8, MaxPoints=4 };
+      //  Timing system seconds count from 1990 (EPICS epoch)
+      static const int64_t EpicsEpoch = 631152000;
+      LatencyMonitor(int64_t   epochOffset = EpicsEpoch,
+                     unsigned  driftUs     = 100,
+                     clockid_t clock       = CLOCK_REALTIME);
+      ~LatencyMonitor();
+    public:
+      //  Registers a measurement point; returns its id
+      unsigned point (const char* name);
+      //  Called as the event reaches the point; each point from one
+      //  thread
+      void     record(unsigned point, unsigned lane, const uint32_t* event);
+    public:
+      //  Latencies since the last dump
+      void     dump  ();
+    public:
+      unsigned          points   () const { return _npoints; }
+      const char*       name     (unsigned point) const { return _points[point].name; }
+      //  ns, cleared by dump()
+      ::HSD::Histogram* histogram(unsigned point, unsigned lane) const
+      { return _points[point].lane[lane&(MaxLanes-1)]; }
+    private:
+      class Point {
+      public:
+        const char*    name;
+        ::HSD::Histogram* lane[MaxLanes];
+        std::atomic<uint64_t> early[MaxLanes];   // timestamp ahead of host clock
+        double         floor[MaxLanes];   // first interval's minimum, us
+      };
+      int64_t   _epochOffset;
+      double    _driftUs;
+      clockid_t _clock;
+      unsigned  _npoints;
+      Point     _points[MaxPoints];
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HSD_Metrics_hh
+#define HSD_Metrics_hh
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace HSD { class Histogram; }
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Counters and gauges for the readout tools.  Each metric is an
+    //  atomic on its own cache line, updated with a single relaxed
+    //  operation.  The metrics live in a shared memory segment (when
+    //  named) so that a monitor in another process reads them directly;
+    //  histograms are copied there by publish(), off the data path.
+    //
+    //  Metrics are registered before the threads that update them start.
+    //
+    class Metrics {
+    public:
+      enum Type { CounterType=1, GaugeType=2, HistogramType=3 };
+      class Entry;
+      class Counter {
+      public:
+        Counter() : _v(0) {}
+        void    add  (int64_t n=1) { _v->fetch_add(n, std::memory_order_relaxed); }
+        int64_t value() const      { return _v->load(std::memory_order_relaxed); }
+      private:
+        friend class Metrics;
+        std::atomic<int64_t>* _v;
+      };
+      class Gauge {
+      public:
+        Gauge() : _v(0) {}
+        void    set  (int64_t v)   { _v->store(v, std::memory_order_relaxed); }
+        void    add  (int64_t n)   { _v->fetch_add(n, std::memory_order_relaxed); }
+        void    mask (int64_t m)   { _v->fetch_or (m, std::memory_order_relaxed); }
+        int64_t take ()            { return _v->exchange(0, std::memory_order_relaxed); }
+        int64_t value() const      { return _v->load(std::memory_order_relaxed); }
+      private:
+        friend class Metrics;
+        std::atomic<int64_t>* _v;
+      };
+    public:
+      //  Segment /dev/shm/<shmName>, or private memory if shmName is 0
+      Metrics(const char* shmName,
+              unsigned    capacity  = 256,
+              size_t      histBytes = 1<<20);
+      ~Metrics();
+      //  Read-only view of another process's segment; 0 if none
+      static Metrics* attach(const char* shmName);
+    public:
+      //  lane<0 for no label
+      Counter counter  (const char* name, int lane=-1);
+      Gauge   gauge    (const char* name, int lane=-1);
+      void    histogram(const char* name, ::HSD::Histogram*, int lane=-1);
+      //  Copies the histograms into the segment
+      void    publish  ();
+    public:
+      //  Values, and rates of the counters since the last dump
+      void    dump     ();
+    private:
+      Metrics();
+      Entry*  _add     (const char* name, int lane, Type);
+    private:
+      class Header;
+      Header*  _header;
+      Entry*   _entries;
+      char*    _arena;
+      size_t   _size;
+      int      _fd;
+      bool     _owner;
+      std::string _name;
+      std::vector< ::HSD::Histogram*> _histos;   // by entry
+      std::vector<int64_t>            _last;
+      double                          _lastTime;
+    };
+  };
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "TriggerEventManager2.hh"
 #include "Xvc.hh"
 #include "Reg.hh"
+#include "Bringup.hh"
 #include "DmaDriver.h"
 
 using Pds::Mmhw::Reg;
@@ -65,6 +66,52 @@ namespace Pds {
 
 using namespace Pds::HSD;
 
+//
+//  Ready conditions polled during bring-up
+//
+namespace {
+  class TxRefClk {
+  public:
+    const TprCore* tpr;
+    double         lo;   // MHz
+    double         hi;
+  };
+  class JesdLanes {
+  public:
+    Reg* jesd0;
+    Reg* jesd1;
+  };
+};
+
+static bool _txref_ok(void* arg)
+{
+  const TxRefClk& c = *reinterpret_cast<const TxRefClk*>(arg);
+  double txclkr = c.tpr->txRefClockRate();
+  return txclkr >= c.lo && txclkr <= c.hi;
+}
+
+static bool _link_up(void* arg)
+{
+  unsigned v = reinterpret_cast<TprCore*>(arg)->CSR;
+  return v&(1<<1);
+}
+
+//  recvDataValid of the 8 lanes of each link
+static unsigned _dvalid(const JesdLanes& l)
+{
+  unsigned dvalid=0;
+  for(unsigned i=0; i<8; i++) {
+    dvalid |= (l.jesd0[0x10+i]&2) ? (0x001<<i) : 0;
+    dvalid |= (l.jesd1[0x10+i]&2) ? (0x100<<i) : 0;
+  }
+  return dvalid;
+}
+
+static bool _lanes_valid(void* arg)
+{
+  return _dvalid(*reinterpret_cast<const JesdLanes*>(arg)) == 0xffff;
+}
+
 Module134::Module134() 
 {
   sem_init(&_sem_i2c,0,1);
@@ -92,13 +139,33 @@ Module134* Module134::create(int fd)
   dmaSetMaskBytes(fd,dmaMask);
 
   Pds::Mmhw::Reg::set(fd);
+  //  Direct register access when the driver allows it
+  if (!Pds::Mmhw::Reg::map(fd, (sizeof(Module134::PrivateData)+0xfff)&~0xfff))
+    printf("Using ioctl register access\n");
   Pds::Mmhw::RegProxy::initialize(m->p, m->p->base.regProxy);
 
+  //  Configuration registers that may be served from the shadow cache
+  for(unsigned i=0; i<2; i++) {
+    ChipAdcReg& reg = m->chip(i).reg;
+    Reg::cacheable   (&reg, sizeof(reg));
+    Reg::markVolatile(&reg.irqStatus   , sizeof(Reg));
+    Reg::markVolatile(&reg.countEnable , 5*sizeof(Reg));
+    Reg::markVolatile(&reg.cacheState  , 3*sizeof(Reg));
+    Reg::selfClearing(&reg.csr, 1<<3);  // adc sync reset
+
+    FexCfg& fex = m->chip(i).fex;
+    Reg::cacheable   (&fex, sizeof(fex));
+    Reg::markVolatile(&fex._oflow, 3*sizeof(Reg));
+    for(unsigned j=0; j<4; j++)
+      Reg::markVolatile(&fex._base[j]._reg[3], sizeof(Reg));  // free counts
+  }
+
   return m;
 }
 
 void Module134::setup_timing()
 {
+  Bringup::begin("timing");
   //
   //  Determine timing mode from firmware image name
   //
@@ -134,7 +201,11 @@ void Module134::setup_timing()
       i2c().clksynth.setup(mode);
       i2c_unlock();
 
-      usleep(100000);
+      TxRefClk c;
+      c.tpr = &tpr;
+      c.lo  = TXCLKR_MIN[mode];
+      c.hi  = TXCLKR_MAX[mode];
+      Bringup::wait("TxRefClk", _txref_ok, &c, 100, 0);
       switch(mode) {
       case LCLS:
         tpr.setLCLS();
@@ -146,7 +217,7 @@ void Module134::setup_timing()
         break;
       }
       tpr.resetRxPll();
-      usleep(1000000);
+      Bringup::wait("Timing link", _link_up, &tpr, 1000);
       tpr.resetBB();
 
       ChipAdcReg& r0 = chip(0).reg;
@@ -154,35 +225,32 @@ void Module134::setup_timing()
       r0.resetFb ();
       r0.resetDma();
       r1.resetDma();
-      usleep(1000000);
+      Bringup::settle(1000);
 
       tpr.resetCounts();
 
-      usleep(100000);
+      Bringup::settle(100);
 
       tpr.resetRxPll();
       r0.resetFbPLL();
     }
   }
+  Bringup::end();
 }
 
 void Module134::_jesd_init(unsigned mode) 
 {
   Fmc134Ctrl& ctrl = jesdctl();
   Fmc134Cpld& cpld = i2c().fmc_cpld;
-  Reg* jesd0  = &p->surf_jesd0[0];
-  Reg* jesd1  = &p->surf_jesd1[0];
+  JesdLanes lanes;
+  lanes.jesd0 = &p->surf_jesd0[0];
+  lanes.jesd1 = &p->surf_jesd1[0];
   while(1) {
       if (!ctrl.default_init(cpld, mode)) {
-          usleep(2000000);
-          unsigned dvalid=0;
-          for(unsigned i=0; i<8; i++) {
-              dvalid |= (jesd0[0x10+i]&2) ? (0x001<<i) : 0;
-              dvalid |= (jesd1[0x10+i]&2) ? (0x100<<i) : 0;
-          }
-          if (dvalid == 0xffff)
+          //  Up to 2 s for all lanes to receive valid data
+          if (Bringup::wait("JESD recvDataValid", _lanes_valid, &lanes, 2000))
               break;
-          printf("dvalid: 0x%x\n",dvalid);
+          printf("dvalid: 0x%x\n",_dvalid(lanes));
       }
       usleep(1000);
   }            
@@ -202,6 +270,7 @@ void Module134::setup_jesd(bool lAbortOnErr,
   Fmc134Ctrl* ctrl = &p->fmc_ctrl;
   Reg* jesd0  = &p->surf_jesd0[0];
   Reg* jesd1  = &p->surf_jesd1[0];
+  Bringup::begin("clocktree");
   while (cpld->default_clocktree_init(lInternalTiming ?
                                       Fmc134Cpld::CLOCKTREE_CLKSRC_INTERNAL :
                                       Fmc134Cpld::CLOCKTREE_REFSRC_EXTERNAL)) {
@@ -210,6 +279,7 @@ void Module134::setup_jesd(bool lAbortOnErr,
     usleep(1000);
   }
 
+  Bringup::begin("adc");
   while (cpld->default_adc_init(Fmc134Cpld::FG_CAL,adc0,adc1,lDualCh,inputCh)) {
     if (lAbortOnErr)
       abort();
@@ -225,10 +295,12 @@ void Module134::setup_jesd(bool lAbortOnErr,
   jesd0[4] = 0x23;
   jesd1[4] = 0x23;
 
+  Bringup::begin("jesd");
   _jesd_init(0);
 
   ctrl->dump();
   i2c_unlock();
+  Bringup::end();
 }
 
 Module134::~Module134()
@@ -286,6 +358,7 @@ unsigned Module134::remote_id() const { return p->tem.xma().rxId; }
 
 void Module134::board_status()
 {
+  Bringup::begin("board_status");
     {
       struct AxiVersion axiv;
       axiVersionGet(_fd, &axiv);
@@ -339,6 +412,22 @@ void Module134::board_status()
   i2c().fmc_cpld.enable_mon(false);
 
   i2c_unlock();
+  Bringup::end();
+}
+
+std::string Module134::fmc_id() const
+{
+  static const char _hex[] = "0123456789abcdef";
+  std::string s;
+  I2c134& i2c = const_cast<Module134*>(this)->i2c();
+  i2c_lock(I2cSwitch::PrimaryFmc);
+  for(unsigned i=0; i<0x100; i++) {
+    unsigned v = i2c.eeprom[i];
+    s += _hex[(v>>4)&0xf];
+    s += _hex[(v>>0)&0xf];
+  }
+  i2c_unlock();
+  return s;
 }
 
 ChipAdcCore& Module134::chip   (unsigned ch) { return p->chip[ch]; }
@@ -441,6 +530,8 @@ void Module134::sample_init (unsigned length,
 {
   printf("length 0x%x  delay 0x%x  prescale 0x%x  streams 0x%x\n",
          length, delay, prescale, streams);
+
+  Reg::resetStats();
   
   for(unsigned _fmc=0; _fmc<2; _fmc++) {
 
@@ -475,6 +566,9 @@ void Module134::sample_init (unsigned length,
       printf("streams: %2u\n", fex._streams &0xf);
     }  
 
+    if (Reg::shadow())
+      Reg::dumpStats();
+
     //  flush out all the old
     { printf("flushing\n");
         unsigned nflush=0;
@@ -67,6 +67,8 @@ namespace Pds {
                             bool         lInternalTiming=false);
       void     write_calib (const char*);
       void     board_status();
+      //  FMC EEPROM contents (hex), identifying the ADC card
+      std::string fmc_id   () const;
 
       void     set_local_id(unsigned bus);
       unsigned remote_id   () const;
@@ -0,0 +1,145 @@
+#include "Numa.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+
+using namespace Pds::HSD;
+
+//  Allocations are rounded to the (x86) huge page size
+static const size_t HUGE_PAGE = 2<<20;
+
+//  From linux/mempolicy.h
+static const int MPOL_PREFERRED_ = 1;
+//  The kernel's largest node count (CONFIG_NODES_SHIFT of 10)
+static const int MAX_NODES = 1024;
+
+static size_t _round(size_t bytes)
+{
+  return (bytes + HUGE_PAGE-1) & ~(HUGE_PAGE-1);
+}
+
+int Numa::node(const char* dev)
+{
+  struct stat st;
+  if (stat(dev, &st) || !S_ISCHR(st.st_mode))
+    return -1;
+
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/numa_node",
+           major(st.st_rdev), minor(st.st_rdev));
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return -1;
+  int n = -1;
+  if (fscanf(f, "%d", &n) != 1)
+    n = -1;
+  fclose(f);
+  return n;
+}
+
+std::vector<int> Numa::cpus(int node)
+{
+  std::vector<int> v;
+  char path[64];
+  if (node < 0)
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/online");
+  else
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return v;
+  char buff[1024];
+  if (fgets(buff, sizeof(buff), f)) {
+    //  e.g. "0-7,16-23"
+    char* p = buff;
+    while(*p && *p != '\n') {
+      char* e;
+      int lo = strtol(p, &e, 10);
+      if (e == p)
+        break;
+      int hi = lo;
+      if (*e == '-')
+        hi = strtol(e+1, &e, 10);
+      for(int i=lo; i<=hi; i++)
+        v.push_back(i);
+      p = (*e == ',') ? e+1 : e;
+    }
+  }
+  fclose(f);
+  return v;
+}
+
+void* Numa::allocate(size_t bytes, int node)
+{
+  size_t sz = _round(bytes);
+  void* p = mmap(0, sz, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+  if (p == MAP_FAILED) {
+    //  No hugepages reserved; ask for transparent ones
+    p = mmap(0, sz, PROT_READ|PROT_WRITE,
+             MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      perror("Numa::allocate");
+      return 0;
+    }
+    madvise(p, sz, MADV_HUGEPAGE);
+  }
+
+  //  Bind before the pages are faulted in by mlock.  The kernel reads
+  //  maxnode-1 bits of the mask.
+  if (node >= MAX_NODES)
+    printf("Numa::allocate: node %d out of range, not bound\n", node);
+  else if (node >= 0) {
+    const unsigned bits = 8*sizeof(unsigned long);
+    std::vector<unsigned long> mask(node/bits+1, 0);
+    mask[node/bits] = 1UL<<(node%bits);
+    if (syscall(SYS_mbind, p, sz, MPOL_PREFERRED_, mask.data(), mask.size()*bits+1, 0))
+      perror("Numa::allocate mbind");
+  }
+  if (mlock(p, sz))
+    perror("Numa::allocate mlock");
+
+  return p;
+}
+
+void Numa::release(void* p, size_t bytes)
+{
+  if (p)
+    munmap(p, _round(bytes));
+}
+
+bool Numa::pin(const std::vector<int>& cpus,
+               int fifoPriority)
+{
+  if (!cpus.empty()) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for(unsigned i=0; i<cpus.size(); i++)
+      CPU_SET(cpus[i], &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) {
+      perror("pthread_setaffinity_np");
+      return false;
+    }
+  }
+  return fifoPriority > 0 ? realtime(fifoPriority) : true;
+}
+
+bool Numa::realtime(int fifoPriority)
+{
+  sched_param param;
+  param.sched_priority = fifoPriority;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+    perror("pthread_setschedparam");
+    return false;
+  }
+  return true;
+}
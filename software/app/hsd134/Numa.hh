@@ -0,0 +1,36 @@
+#ifndef HSD_Numa_hh
+#define HSD_Numa_hh
+
+#include <stddef.h>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Placement of reader buffers and threads near the card.  The
+    //  card's NUMA node comes from sysfs; buffers are locked, backed by
+    //  hugepages where the system has them, and bound to the node.
+    //
+    class Numa {
+    public:
+      //  Node of the PCIe device behind a character device file,
+      //  -1 if not known
+      static int  node    (const char* dev);
+      //  CPUs of a node; all online CPUs for node<0
+      static std::vector<int> cpus(int node);
+    public:
+      //  0 if the memory could not be mapped; node<0 for no binding
+      static void* allocate(size_t bytes, int node);
+      static void  release (void* p, size_t bytes);
+    public:
+      //  Restricts the calling thread to the cpus, and makes it
+      //  SCHED_FIFO at the given priority if >0.  Threads it creates
+      //  afterwards inherit the cpus.
+      static bool  pin     (const std::vector<int>& cpus,
+                            int fifoPriority=0);
+      static bool  realtime(int fifoPriority);
+    };
+  };
+};
+
+#endif
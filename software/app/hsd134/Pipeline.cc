@@ -0,0 +1,211 @@
+#include "Pipeline.hh"
+
+#include <stdio.h>
+#include <sched.h>
+#include <time.h>
+
+using namespace Pds::HSD;
+
+static uint64_t _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return uint64_t(tv.tv_sec)*1000000000ULL + tv.tv_nsec;
+}
+
+Pipeline::Stage::Stage(const char* name, bool lossy) :
+  _name    (name),
+  _lossy   (lossy),
+  _core    (-1),
+  _pipeline(0),
+  _input   (0),
+  _output  (0),
+  _events  (0),
+  _drops   (0),
+  _stalls  (0),
+  _maxdepth(0),
+  _bytes   (0),
+  _busy    (0)
+{
+}
+
+Pipeline::Stage::~Stage()
+{
+  delete _input;
+  delete _output;
+}
+
+Pipeline::Pipeline(unsigned nbuffers,
+                   unsigned depth,
+                   Release  release,
+                   void*    arg) :
+  _depth   (depth),
+  _release (release),
+  _arg     (arg),
+  _refs    (new unsigned[nbuffers]),
+  _free    (new uint32_t[nbuffers]),
+  _nfree   (0),
+  _nbuffers(nbuffers),
+  _running (false)
+{
+  for(unsigned i=0; i<nbuffers; i++)
+    _refs[i] = 0;
+}
+
+Pipeline::~Pipeline()
+{
+  stop();
+  delete[] _refs;
+  delete[] _free;
+}
+
+void Pipeline::add(Stage* s, int core)
+{
+  s->_core     = core;
+  s->_pipeline = this;
+  //  Every buffer may be outstanding in a stage at once
+  s->_input    = new SpscQueue<Event>   (_depth);
+  s->_output   = new SpscQueue<unsigned>(_nbuffers);
+  _stages.push_back(s);
+}
+
+void Pipeline::start()
+{
+  _running = true;
+  for(unsigned i=0; i<_stages.size(); i++) {
+    pthread_attr_t tattr;
+    pthread_attr_init(&tattr);
+    if (pthread_create(&_stages[i]->_thread, &tattr, &_routine, _stages[i]))
+      perror("Error creating pipeline stage thread");
+  }
+}
+
+void Pipeline::stop()
+{
+  if (!_running)
+    return;
+  _running = false;
+  for(unsigned i=0; i<_stages.size(); i++)
+    pthread_join(_stages[i]->_thread, NULL);
+  reclaim();
+}
+
+void Pipeline::dispatch(const Event& ev)
+{
+  //  Hold a reference of our own while dispatching: a stall reclaims,
+  //  which may return this buffer from a stage that already finished
+  unsigned& refs = _refs[ev.index];
+  refs = 1;
+  for(unsigned i=0; i<_stages.size(); i++) {
+    Stage& s = *_stages[i];
+    if (!s.accept(ev))
+      continue;
+    if (!s._input->push(ev)) {
+      if (s._lossy) {
+        s._drops.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      s._stalls.fetch_add(1, std::memory_order_relaxed);
+      //  Keep returning buffers while we wait, else the stage
+      //  may block on its full output queue.
+      do {
+        reclaim();
+      } while(!s._input->push(ev));
+    }
+    refs++;
+    unsigned occ = s._input->occupancy();
+    if (occ > s._maxdepth.load(std::memory_order_relaxed))
+      s._maxdepth.store(occ, std::memory_order_relaxed);
+  }
+
+  if (--refs == 0)
+    _free[_nfree++] = ev.index;
+
+  reclaim();
+}
+
+void Pipeline::reclaim()
+{
+  for(unsigned i=0; i<_stages.size(); i++) {
+    unsigned index;
+    while(_stages[i]->_output->pop(index))
+      if (--_refs[index] == 0)
+        _free[_nfree++] = index;
+  }
+  _flush();
+}
+
+void Pipeline::_flush()
+{
+  if (_nfree) {
+    _release(_arg, _free, _nfree);
+    _nfree = 0;
+  }
+}
+
+//
+//  The rates are over the time each stage spent processing, so they
+//  are what the stage could sustain rather than what it was offered.
+//
+void Pipeline::dump() const
+{
+  printf("%10.10s %12.12s %10.10s %10.10s %8.8s %8.8s %9.9s %10.10s %9.9s\n",
+         "stage", "events", "drops", "stalls", "occ", "maxocc",
+         "busy[s]", "evts/s", "MB/s");
+  for(unsigned i=0; i<_stages.size(); i++) {
+    const Stage& s = *_stages[i];
+    uint64_t events = s._events.load(std::memory_order_relaxed);
+    uint64_t bytes  = s._bytes .load(std::memory_order_relaxed);
+    double   busy   = double(s._busy.load(std::memory_order_relaxed))*1.e-9;
+    printf("%10.10s %12llu %10llu %10llu %4u/%-4u %8u %9.3f %10.0f %9.1f\n",
+           s._name,
+           (unsigned long long)events,
+           (unsigned long long)s._drops .load(std::memory_order_relaxed),
+           (unsigned long long)s._stalls.load(std::memory_order_relaxed),
+           s._input->occupancy(), s._input->depth(),
+           s._maxdepth.load(std::memory_order_relaxed),
+           busy,
+           busy > 0 ? double(events)/busy : 0.,
+           busy > 0 ? double(bytes )/busy*1.e-6 : 0.);
+  }
+}
+
+void Pipeline::affinity(int core)
+{
+  if (core < 0)
+    return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(core, &cpuset);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+    perror("pthread_setaffinity_np");
+}
+
+void* Pipeline::_routine(void* arg)
+{
+  Stage& s = *reinterpret_cast<Stage*>(arg);
+  affinity(s._core);
+
+  unsigned idle = 0;
+  Event ev;
+  while(1) {
+    if (s._input->pop(ev)) {
+      uint64_t t0 = _now();
+      s.process(ev);
+      s._busy  .fetch_add(_now() - t0, std::memory_order_relaxed);
+      s._bytes .fetch_add(ev.size    , std::memory_order_relaxed);
+      s._events.fetch_add(1          , std::memory_order_relaxed);
+      while(!s._output->push(ev.index))
+        sched_yield();
+      idle = 0;
+    }
+    else if (!s._pipeline->_running)
+      break;
+    else if (++idle > 1000) {
+      //  Back off when there is nothing to do
+      timespec tv = { .tv_sec=0, .tv_nsec=10000 };
+      nanosleep(&tv, 0);
+    }
+  }
+  return 0;
+}
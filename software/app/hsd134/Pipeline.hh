@@ -0,0 +1,98 @@
+#ifndef HSD_Pipeline_hh
+#define HSD_Pipeline_hh
+
+#include "SpscQueue.hh"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Readout pipeline.  The receive thread (the caller) dispatches DMA
+    //  buffer indices to a set of stages, each running on its own thread.
+    //  A buffer is released back to the driver once every stage that
+    //  accepted it has finished with it.
+    //
+    class Pipeline {
+    public:
+      class Event {
+      public:
+        uint32_t* data;
+        unsigned  size;
+        unsigned  dest;
+        unsigned  error;
+        unsigned  index;   // DMA buffer index
+      };
+
+      class Stage {
+      public:
+        //  A lossy stage drops events when its queue is full
+        //  instead of stalling the receive thread.
+        Stage(const char* name, bool lossy=false);
+        virtual ~Stage();
+      public:
+        //  Called from the receive thread
+        virtual bool accept (const Event&) { return true; }
+        //  Called from the stage thread
+        virtual void process(const Event&) = 0;
+      public:
+        const char* name() const { return _name; }
+      private:
+        friend class Pipeline;
+        const char*          _name;
+        bool                 _lossy;
+        int                  _core;
+        pthread_t            _thread;
+        Pipeline*            _pipeline;
+        SpscQueue<Event>*    _input;
+        SpscQueue<unsigned>* _output;
+        //  Occupancy counters, read by dump() from another thread
+        std::atomic<uint64_t> _events;    // events processed
+        std::atomic<uint64_t> _drops;     // events dropped (lossy)
+        std::atomic<uint64_t> _stalls;    // receive thread found queue full
+        std::atomic<unsigned> _maxdepth;  // queue high-water mark
+        //  Throughput counters
+        std::atomic<uint64_t> _bytes;     // bytes processed
+        std::atomic<uint64_t> _busy;      // ns in process()
+      };
+
+      typedef void (*Release)(void* arg, uint32_t* indices, unsigned n);
+    public:
+      Pipeline(unsigned nbuffers,
+               unsigned depth,
+               Release  release,
+               void*    arg);
+      ~Pipeline();
+    public:
+      void add  (Stage*, int core=-1);
+      void start();
+      void stop ();
+    public:
+      //  Receive thread interface
+      void dispatch(const Event&);
+      void reclaim ();
+    public:
+      void dump() const;
+    public:
+      static void affinity(int core);
+    private:
+      static void* _routine(void*);
+      void _flush();
+    private:
+      unsigned            _depth;
+      Release             _release;
+      void*               _arg;
+      std::vector<Stage*> _stages;
+      unsigned*           _refs;      // stages holding each buffer
+      uint32_t*           _free;      // buffers ready for release
+      unsigned            _nfree;
+      unsigned            _nbuffers;
+      volatile bool       _running;
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "RecordFile.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+using namespace Pds::HSD;
+
+namespace Pds {
+  namespace HSD {
+    class RecordTask {
+    public:
+      const RecordFile* file;
+      RecordFile::Fn    fn;
+      void*             arg;
+      unsigned          first;
+      unsigned          last;
+      unsigned          thread;
+    };
+  };
+};
+
+RecordFile::RecordFile() : _base(0), _size(0), _n(0) {}
+
+RecordFile::~RecordFile()
+{
+  close();
+}
+
+bool RecordFile::open(const char* path)
+{
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat s;
+  if (fstat(fd, &s)) {
+    perror("fstat");
+    ::close(fd);
+    return false;
+  }
+  _size = s.st_size;
+  if (_size) {
+    void* p = mmap(0, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      perror("mmap record file");
+      ::close(fd);
+      return false;
+    }
+    _base = reinterpret_cast<const char*>(p);
+  }
+  ::close(fd);
+
+  if (access((std::string(path)+".idx").c_str(), R_OK)==0 &&
+      _index.open((std::string(path)+".idx").c_str())) {
+    //  Ignore entries beyond the data (file still being written)
+    _n = _index.entries();
+    while(_n && _index[_n-1].offset + _index[_n-1].size > _size)
+      _n--;
+  }
+  else {
+    printf("%s: no index, scanning\n", path);
+    uint64_t off = 0;
+    while(off < _size) {
+      unsigned len = _scan(off);
+      if (!len)
+        break;
+      _offsets.push_back(off);
+      off += len;
+    }
+    _offsets.push_back(off);
+    _n = _offsets.size()-1;
+    if (off != _size)
+      printf("%s: %llu trailing bytes not parsed\n",
+             path, (unsigned long long)(_size-off));
+  }
+
+  madvise(const_cast<char*>(_base), _size, MADV_SEQUENTIAL);
+  return true;
+}
+
+void RecordFile::close()
+{
+  if (_base)
+    munmap(const_cast<char*>(_base), _size);
+  _base = 0;
+  _size = 0;
+  _index.close();
+  _offsets.clear();
+  _n    = 0;
+}
+
+unsigned RecordFile::size(unsigned i) const
+{
+  return indexed() ? _index[i].size : unsigned(_offsets[i+1]-_offsets[i]);
+}
+
+//
+//  Length of the event at offset, 0 if it is truncated.  hsdRead
+//  records the lane in the stream mask field, so a mask bit only counts
+//  when the next stream header carries that stream id.  Those that do
+//  go into streams; a lane bit left at the end of the file ends the event.
+//
+unsigned RecordFile::_scan(uint64_t off, unsigned* streams) const
+{
+  if (off + sizeof(EventHeader) > _size)
+    return 0;
+  const EventHeader& event = *reinterpret_cast<const EventHeader*>(_base+off);
+  const char* end = _base + _size;
+  const char* q   = reinterpret_cast<const char*>(&event+1);
+  unsigned mask = event.streamMask();
+  unsigned found = 0;
+  for(unsigned i=0; i<8; i++) {
+    if (!(mask & (1<<i)))
+      continue;
+    if (q == end)
+      break;
+    if (q + sizeof(StreamHeader) > end)
+      return 0;
+    const StreamHeader& s = *reinterpret_cast<const StreamHeader*>(q);
+    if (s.stream_id() != i)
+      continue;
+    q = reinterpret_cast<const char*>(s.data() + s.samples());
+    found |= 1<<i;
+  }
+  if (q > end)
+    return 0;
+  if (streams)
+    *streams = found;
+  return q - (_base+off);
+}
+
+unsigned RecordFile::streams(unsigned i) const
+{
+  if (indexed())
+    return _index[i].streamMask;
+  unsigned mask = 0;
+  _scan(offset(i), &mask);
+  return mask;
+}
+
+uint64_t RecordFile::_timeStamp(unsigned i) const
+{
+  return indexed() ? _index[i].timestamp : event(i).timeStamp();
+}
+
+void RecordFile::range(uint64_t t0, uint64_t t1,
+                       unsigned& first, unsigned& last) const
+{
+  if (indexed()) {
+    first = _index.findTime(t0);
+    last  = _index.findTime(t1);
+    if (first > _n) first = _n;
+    if (last  > _n) last  = _n;
+    return;
+  }
+
+  //  Same search as IndexReader::findTime over the event headers
+  unsigned b[2];
+  uint64_t t[2] = { t0, t1 };
+  for(unsigned k=0; k<2; k++) {
+    unsigned lo = 0, hi = _n;
+    while(lo < hi) {
+      unsigned mid = lo + (hi-lo)/2;
+      if (_timeStamp(mid) < t[k])
+        lo = mid+1;
+      else
+        hi = mid;
+    }
+    b[k] = lo;
+    for(unsigned i=(lo > 64 ? lo-64 : 0); i<lo; i++)
+      if (_timeStamp(i) >= t[k]) {
+        b[k] = i;
+        break;
+      }
+  }
+  first = b[0];
+  last  = b[1];
+}
+
+unsigned RecordFile::find(uint32_t event) const
+{
+  if (indexed()) {
+    unsigned i = _index.findEvent(event);
+    return i < _n ? i : _n;
+  }
+  //  Without an index the event number is the position in the file
+  return event < _n ? event : _n;
+}
+
+void* RecordFile::_routine(void* arg)
+{
+  const RecordTask& task = *reinterpret_cast<const RecordTask*>(arg);
+  const RecordFile& f    = *task.file;
+  for(unsigned i=task.first; i<task.last; i++)
+    task.fn(f.event(i), f.size(i), i, task.thread, task.arg);
+  return 0;
+}
+
+void RecordFile::parallel_for(Fn fn, void* arg, unsigned nthreads,
+                              unsigned first, unsigned last) const
+{
+  if (last > _n)
+    last = _n;
+  if (first >= last)
+    return;
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads > last-first)
+    nthreads = last-first;
+
+  //  Each thread walks its own contiguous block of the file
+  std::vector<RecordTask> tasks(nthreads);
+  std::vector<pthread_t>  threads(nthreads);
+  unsigned n = last-first;
+  for(unsigned t=0; t<nthreads; t++) {
+    RecordTask& task = tasks[t];
+    task.file   = this;
+    task.fn     = fn;
+    task.arg    = arg;
+    task.first  = first + uint64_t(n)*t/nthreads;
+    task.last   = first + uint64_t(n)*(t+1)/nthreads;
+    task.thread = t;
+  }
+
+  for(unsigned t=1; t<nthreads; t++)
+    if (pthread_create(&threads[t], 0, &_routine, &tasks[t])) {
+      perror("Error creating record file thread");
+      _routine(&tasks[t]);
+      tasks[t].thread = unsigned(-1);
+    }
+  _routine(&tasks[0]);
+  for(unsigned t=1; t<nthreads; t++)
+    if (tasks[t].thread != unsigned(-1))
+      pthread_join(threads[t], NULL);
+}
@@ -0,0 +1,72 @@
+#ifndef HSD_RecordFile_hh
+#define HSD_RecordFile_hh
+
+#include "Event.hh"
+#include "EventIndex.hh"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Random access to a file recorded by hsdRead.  The file is mapped
+    //  read-only and events are returned in place; streams are walked
+    //  with EventHeader::streams().  The "<file>.idx" sidecar is used to
+    //  locate events when present, otherwise the file is scanned once
+    //  at open.
+    //
+    class RecordFile {
+    public:
+      //  Called for each event of a parallel loop
+      typedef void (*Fn)(const EventHeader& event,
+                         unsigned           size,
+                         unsigned           index,
+                         unsigned           thread,
+                         void*              arg);
+    public:
+      RecordFile();
+      ~RecordFile();
+    public:
+      bool open (const char* path);
+      void close();
+    public:
+      unsigned           events() const { return _n; }
+      bool               indexed() const { return _index.entries()!=0; }
+      const EventHeader& event (unsigned i) const
+      { return *reinterpret_cast<const EventHeader*>(_base + offset(i)); }
+      unsigned           size  (unsigned i) const;
+      uint64_t           offset(unsigned i) const
+      { return indexed() ? _index[i].offset : _offsets[i]; }
+      //  Index entry (only when indexed)
+      const IndexEntry&  entry (unsigned i) const { return _index[i]; }
+      //  The streams of the event, without the lane that hsdRead
+      //  records in the same header field
+      unsigned           streams(unsigned i) const;
+    public:
+      //  Event range [first,last) covering timestamps [t0,t1)
+      void     range(uint64_t t0, uint64_t t1,
+                     unsigned& first, unsigned& last) const;
+      //  Position of the recorded event number
+      unsigned find (uint32_t event) const;
+    public:
+      //  Call fn for each event in [first,last), partitioned into
+      //  contiguous blocks across nthreads threads
+      void parallel_for(Fn fn, void* arg, unsigned nthreads,
+                        unsigned first=0, unsigned last=unsigned(-1)) const;
+    private:
+      unsigned _scan(uint64_t offset, unsigned* streams=0) const;
+      uint64_t _timeStamp(unsigned i) const;
+      static void* _routine(void*);
+    private:
+      const char*           _base;
+      size_t                _size;
+      IndexReader           _index;
+      std::vector<uint64_t> _offsets;   // without index
+      unsigned              _n;
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,345 @@
+#include "Recorder.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+using namespace Pds::HSD;
+
+static const unsigned ALIGN = 4096;
+
+Recorder::Recorder(const char* path,
+                   unsigned    blockSize,
+                   unsigned    nblocks,
+                   Policy      policy,
+                   uint64_t    maxBytes,
+                   unsigned    maxSeconds) :
+  _path      (path),
+  _blockSize ((blockSize+ALIGN-1)&~(ALIGN-1)),
+  _nblocks   (nblocks < 2 ? 2 : nblocks),
+  _policy    (policy),
+  _maxBytes  (maxBytes),
+  _maxSeconds(maxSeconds),
+  _buffers   (0),
+  _full      (_nblocks),
+  _empty     (_nblocks),
+  _current   (0),
+  _fileBytes (0),
+  _fileStart (0),
+  _decimate  (1),
+  _ndecimate (0),
+  _indexed   (false),
+  _indexNo   (0),
+  _running   (false),
+  _fd        (-1),
+  _direct    (true),
+  _fileNo    (0),
+  _written   (0),
+  _allocated (0),
+  events     (0),
+  bytes      (0),
+  dropped    (0),
+  decimated  (0),
+  stalls     (0),
+  files      (0)
+{
+}
+
+Recorder::~Recorder()
+{
+  close();
+  if (_buffers) {
+    for(unsigned i=0; i<_nblocks; i++)
+      free(_buffers[i].data);
+    delete[] _buffers;
+  }
+}
+
+bool Recorder::policy(const char* s, Policy& p)
+{
+  if      (strcmp(s,"block"   )==0) p = Block;
+  else if (strcmp(s,"drop"    )==0) p = Drop;
+  else if (strcmp(s,"decimate")==0) p = Decimate;
+  else return false;
+  return true;
+}
+
+std::string Recorder::filename(unsigned n) const
+{
+  if (!_maxBytes && !_maxSeconds)
+    return _path;
+
+  //  Insert the file number before the extension
+  size_t slash = _path.rfind('/');
+  size_t dot   = _path.rfind('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    dot = _path.size();
+  char buff[16];
+  snprintf(buff, sizeof(buff), "-%03u", n);
+  return _path.substr(0,dot) + buff + _path.substr(dot);
+}
+
+bool Recorder::open()
+{
+  _buffers = new Buffer[_nblocks];
+  for(unsigned i=0; i<_nblocks; i++) {
+    if (posix_memalign(reinterpret_cast<void**>(&_buffers[i].data), ALIGN, _blockSize)) {
+      perror("Recorder buffer allocation");
+      return false;
+    }
+    _buffers[i].len  = 0;
+    _buffers[i].last = false;
+    _empty.push(&_buffers[i]);
+  }
+
+  if (!_openFile() || !_openIndex())
+    return false;
+
+  _fileStart = time(0);
+  _running   = true;
+
+  pthread_attr_t tattr;
+  pthread_attr_init(&tattr);
+  if (pthread_create(&_thread, &tattr, &_routine, this)) {
+    perror("Error creating recorder thread");
+    _running = false;
+    return false;
+  }
+  return true;
+}
+
+void Recorder::close()
+{
+  if (!_running)
+    return;
+  _commit(true);
+  _running = false;
+  pthread_join(_thread, NULL);
+  _index.close();
+}
+
+bool Recorder::write(const void* hdr, unsigned hlen,
+                     const void* payload, unsigned plen,
+                     IndexEntry* entry)
+{
+  unsigned len = hlen+plen;
+
+  //  Roll over at event boundaries
+  if (_fileBytes) {
+    if ((_maxBytes   && _fileBytes+len > _maxBytes) ||
+        (_maxSeconds && time(0) - _fileStart >= _maxSeconds)) {
+      _commit(true);
+      _fileBytes = 0;
+      _fileStart = time(0);
+      _indexNo++;
+      _openIndex();
+    }
+  }
+
+  while(1) {
+    unsigned room = (_current ? _blockSize - _current->len : 0) +
+      _empty.occupancy()*_blockSize;
+    if (room >= len)
+      break;
+    if (len > _blockSize*(_nblocks-1)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (_policy == Block) {
+      stalls.fetch_add(1, std::memory_order_relaxed);
+      timespec tv = { .tv_sec=0, .tv_nsec=10000 };
+      nanosleep(&tv, 0);
+      continue;
+    }
+    unsigned d = _decimate.load(std::memory_order_relaxed);
+    if (_policy == Decimate && d < 1024)
+      _decimate.store(d<<1, std::memory_order_relaxed);
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  unsigned d = _decimate.load(std::memory_order_relaxed);
+  if (d > 1) {
+    if (_full.occupancy()==0)
+      _decimate.store(d >>= 1, std::memory_order_relaxed);
+    if ((++_ndecimate % d) != 0) {
+      decimated.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+
+  if (_indexed && entry) {
+    entry->offset = _fileBytes;
+    entry->event  = events.load(std::memory_order_relaxed);
+    entry->size   = len;
+    _index.write(*entry);
+  }
+
+  _copy(hdr    , hlen);
+  _copy(payload, plen);
+
+  _fileBytes += len;
+  events.fetch_add(1, std::memory_order_relaxed);
+  bytes .fetch_add(len, std::memory_order_relaxed);
+  return true;
+}
+
+bool Recorder::_acquire()
+{
+  if (!_empty.pop(_current))
+    return false;
+  _current->len  = 0;
+  _current->last = false;
+  return true;
+}
+
+void Recorder::_copy(const void* p, unsigned len)
+{
+  const char* src = reinterpret_cast<const char*>(p);
+  while(len) {
+    if (!_current)
+      while(!_acquire())  // space was reserved by the caller
+        ;
+    unsigned n = _blockSize - _current->len;
+    if (n > len) n = len;
+    memcpy(_current->data + _current->len, src, n);
+    _current->len += n;
+    src += n;
+    len -= n;
+    if (_current->len == _blockSize)
+      _commit(false);
+  }
+}
+
+void Recorder::_commit(bool last)
+{
+  if (!_current) {
+    if (!last)
+      return;
+    //  Need an (empty) buffer to mark the end of the file
+    while(!_acquire()) {
+      timespec tv = { .tv_sec=0, .tv_nsec=10000 };
+      nanosleep(&tv, 0);
+    }
+  }
+  _current->last = last;
+  _full.push(_current);
+  _current = 0;
+}
+
+bool Recorder::_openFile()
+{
+  std::string fname = filename(_fileNo);
+  _fd = ::open(fname.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT, 0644);
+  if (_fd < 0 && errno == EINVAL) {
+    //  Filesystem doesn't support direct I/O
+    _direct = false;
+    _fd = ::open(fname.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  }
+  if (_fd < 0) {
+    perror(("Recorder opening "+fname).c_str());
+    return false;
+  }
+  _written   = 0;
+  _allocated = 0;
+  if (_maxBytes && fallocate(_fd, 0, 0, _maxBytes)==0)
+    _allocated = _maxBytes;
+  files.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool Recorder::_openIndex()
+{
+  if (!_indexed)
+    return true;
+  return _index.open((filename(_indexNo)+".idx").c_str());
+}
+
+void Recorder::_closeFile()
+{
+  if (_fd < 0)
+    return;
+  //  Trim the alignment padding and unused preallocation
+  if (ftruncate(_fd, _written))
+    perror("Recorder truncate");
+  ::close(_fd);
+  _fd = -1;
+  _fileNo++;
+}
+
+void Recorder::_writeBuffer(Buffer* b)
+{
+  if (_fd < 0 && !_openFile())
+    return;
+
+  if (b->len) {
+    unsigned wlen = b->len;
+    if (_direct)
+      wlen = (wlen+ALIGN-1)&~(ALIGN-1);
+
+    //  Preallocate extents ahead of the writes
+    if (_written + wlen > _allocated) {
+      uint64_t chunk = 64*uint64_t(_blockSize);
+      if (fallocate(_fd, 0, _allocated, chunk)==0)
+        _allocated += chunk;
+    }
+
+    const char* p   = b->data;
+    off_t       off = _written;
+    while(wlen) {
+      ssize_t n = pwrite(_fd, p, wlen, off);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        perror("Recorder write");
+        break;
+      }
+      p    += n;
+      off  += n;
+      wlen -= n;
+    }
+    _written += b->len;
+  }
+
+  if (b->last)
+    _closeFile();
+}
+
+void* Recorder::_routine(void* arg)
+{
+  Recorder& r = *reinterpret_cast<Recorder*>(arg);
+  Buffer* b;
+  while(1) {
+    if (r._full.pop(b)) {
+      r._writeBuffer(b);
+      r._empty.push(b);
+    }
+    else if (!r._running)
+      break;
+    else {
+      timespec tv = { .tv_sec=0, .tv_nsec=100000 };
+      nanosleep(&tv, 0);
+    }
+  }
+  while(r._full.pop(b)) {
+    r._writeBuffer(b);
+    r._empty.push(b);
+  }
+  r._closeFile();
+  return 0;
+}
+
+void Recorder::dump() const
+{
+  printf("Recorder: events %llu  bytes %llu  dropped %llu  decimated %llu [1/%u]  stalls %llu  files %u%s\n",
+         (unsigned long long)events   .load(std::memory_order_relaxed),
+         (unsigned long long)bytes    .load(std::memory_order_relaxed),
+         (unsigned long long)dropped  .load(std::memory_order_relaxed),
+         (unsigned long long)decimated.load(std::memory_order_relaxed), _decimate.load(std::memory_order_relaxed),
+         (unsigned long long)stalls   .load(std::memory_order_relaxed),
+         files.load(std::memory_order_relaxed),
+         _direct ? "  direct" : "");
+}
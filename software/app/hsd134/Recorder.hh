@@ -0,0 +1,99 @@
+#ifndef HSD_Recorder_hh
+#define HSD_Recorder_hh
+
+#include "SpscQueue.hh"
+#include "EventIndex.hh"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Asynchronous event recorder.  Events are aggregated into large
+    //  aligned blocks which a dedicated thread writes with O_DIRECT.
+    //  When the disk falls behind, the overload policy decides whether
+    //  the producer blocks, drops events, or decimates them.
+    //
+    class Recorder {
+    public:
+      enum Policy { Block, Drop, Decimate };
+      Recorder(const char* path,
+               unsigned    blockSize  = 8<<20,
+               unsigned    nblocks    = 3,
+               Policy      policy     = Block,
+               uint64_t    maxBytes   = 0,     // rollover size  (0 = none)
+               unsigned    maxSeconds = 0);    // rollover period (0 = none)
+      ~Recorder();
+    public:
+      void index(bool v) { _indexed = v; }   // call before open()
+      bool open ();
+      void close();
+      //  Called from a single producer thread.  Returns false if the
+      //  event was dropped.  The offset and event number of the index
+      //  entry are filled in here.
+      bool write(const void* hdr, unsigned hlen,
+                 const void* payload, unsigned plen,
+                 IndexEntry* entry=0);
+    public:
+      std::string filename(unsigned n) const;
+      void        dump    () const;
+      static bool policy  (const char*, Policy&);
+    private:
+      class Buffer {
+      public:
+        char*    data;
+        unsigned len;
+        bool     last;    // closes the current file
+      };
+      static void* _routine(void*);
+      bool _acquire();
+      void _commit (bool last);
+      void _copy   (const void*, unsigned);
+      bool _openFile ();
+      void _closeFile();
+      void _writeBuffer(Buffer*);
+      bool _openIndex  ();
+    private:
+      std::string  _path;
+      unsigned     _blockSize;
+      unsigned     _nblocks;
+      Policy       _policy;
+      uint64_t     _maxBytes;
+      unsigned     _maxSeconds;
+      Buffer*      _buffers;
+      SpscQueue<Buffer*> _full;    // producer -> writer
+      SpscQueue<Buffer*> _empty;   // writer -> producer
+      Buffer*      _current;
+      //  Producer state
+      uint64_t     _fileBytes;     // bytes committed to the current file
+      unsigned     _fileStart;
+      std::atomic<unsigned> _decimate;   // read by dump()
+      unsigned     _ndecimate;
+      bool         _indexed;
+      IndexWriter  _index;
+      unsigned     _indexNo;
+      //  Writer state
+      pthread_t    _thread;
+      volatile bool _running;
+      int          _fd;
+      bool         _direct;
+      unsigned     _fileNo;
+      uint64_t     _written;       // bytes written to the current file
+      uint64_t     _allocated;     // bytes preallocated in the current file
+    public:
+      //  Statistics, updated by the producer (files by the writer) and
+      //  read from any thread
+      std::atomic<uint64_t> events;
+      std::atomic<uint64_t> bytes;
+      std::atomic<uint64_t> dropped;
+      std::atomic<uint64_t> decimated;
+      std::atomic<uint64_t> stalls;
+      std::atomic<unsigned> files;
+    };
+  };
+};
+
+#endif
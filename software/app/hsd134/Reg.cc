@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include <vector>
 
 #include "DataDriver.h"
 
@@ -10,9 +14,59 @@
 
 static int _fd = -1;
 static bool _verbose = false;
+static volatile uint32_t* _base = 0;
+static uint32_t _size = 0;
+static Pds::Mmhw::Reg::Backend _backend = Pds::Mmhw::Reg::Ioctl;
 
 using namespace Pds::Mmhw;
 
+namespace {
+  enum { Valid=1, Volatile=2 };
+  class Region {
+  public:
+    uint32_t              begin;
+    uint32_t              end;
+    std::vector<uint32_t> value;
+    std::vector<uint32_t> clear;   // self-clearing bits
+    std::vector<uint8_t>  flags;
+  };
+};
+
+static bool                _shadow = false;
+static std::vector<Region> _regions;
+static pthread_mutex_t     _cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t            _busReads  = 0;
+static uint64_t            _busWrites = 0;
+static uint64_t            _hits      = 0;
+
+static Region* _region(uint32_t addr)
+{
+  for(unsigned i=0; i<_regions.size(); i++)
+    if (addr >= _regions[i].begin && addr < _regions[i].end)
+      return &_regions[i];
+  return 0;
+}
+
+static void _busWrite(uint32_t addr, uint32_t r)
+{
+  if (_backend == Reg::Mapped && addr < _size)
+    _base[addr>>2] = r;
+  else if (dmaWriteRegister(_fd, addr, r)<0)
+    perror("Pds::Mmhw::Reg write");
+}
+
+static uint32_t _busRead(uint32_t addr)
+{
+  uint32_t r=-1UL;
+  if (_backend == Reg::Mapped && addr < _size)
+    r = _base[addr>>2];
+  else if (dmaReadRegister(_fd, addr, &r)<0) {
+      printf("read 0x%x\n",addr);
+      perror("Pds::Mmhw::Reg read");
+  }
+  return r;
+}
+
 void Reg::setBit  (unsigned b)
 {
   unsigned r = *this;
@@ -30,6 +84,42 @@ void Reg::set(unsigned fd)
   _fd = fd;
 }
 
+bool Reg::map(unsigned fd, unsigned size)
+{
+  unmap();
+  void* p = dmaMapRegister(fd, 0, size);
+  if (p == MAP_FAILED) {
+    perror("Pds::Mmhw::Reg map");
+    return false;
+  }
+  _base    = reinterpret_cast<volatile uint32_t*>(p);
+  _size    = size;
+  _backend = Mapped;
+  return true;
+}
+
+void Reg::unmap()
+{
+  if (_base)
+    munmap(const_cast<uint32_t*>(_base), _size);
+  _base    = 0;
+  _size    = 0;
+  _backend = Ioctl;
+}
+
+bool Reg::backend(Backend b)
+{
+  if (b == Mapped && !_base)
+    return false;
+  _backend = b;
+  return true;
+}
+
+Reg::Backend Reg::backend()
+{
+  return _backend;
+}
+
 void Reg::verbose(bool v)
 {
   _verbose = v;
@@ -41,8 +131,21 @@ Reg& Reg::operator=(const unsigned r)
   if (_verbose)
       printf("Write [0x%x] : 0x%x\n",addr,r);
 
-  if (dmaWriteRegister(_fd, addr, r)<0)
-    perror("Pds::Mmhw::Reg write");
+  _busWrite(addr, r);
+
+  if (_shadow) {
+    pthread_mutex_lock(&_cacheLock);
+    _busWrites++;
+    Region* g = _region(addr);
+    if (g) {
+      unsigned i = (addr - g->begin)>>2;
+      if (!(g->flags[i] & Volatile)) {
+        g->value[i] = r & ~g->clear[i];
+        g->flags[i] |= Valid;
+      }
+    }
+    pthread_mutex_unlock(&_cacheLock);
+  }
 
   return *this;
 }
@@ -50,14 +153,129 @@ Reg& Reg::operator=(const unsigned r)
 Reg::operator unsigned() const
 {
   uint32_t addr = reinterpret_cast<uintptr_t>(this);
-  uint32_t r=-1UL;
-  if (dmaReadRegister(_fd, addr, &r)<0) {
-      printf("read 0x%x\n",addr);
-      perror("Pds::Mmhw::Reg read");
+  uint32_t r;
+  if (_shadow) {
+    pthread_mutex_lock(&_cacheLock);
+    Region* g = _region(addr);
+    unsigned i = g ? (addr - g->begin)>>2 : 0;
+    if (g && (g->flags[i] & (Valid|Volatile)) == Valid) {
+      _hits++;
+      r = g->value[i];
+    }
+    else {
+      _busReads++;
+      r = _busRead(addr);
+      if (g && !(g->flags[i] & Volatile)) {
+        g->value[i] = r & ~g->clear[i];
+        g->flags[i] |= Valid;
+      }
+    }
+    pthread_mutex_unlock(&_cacheLock);
   }
+  else
+    r = _busRead(addr);
 
   if (_verbose)
       printf("Read [0x%x] : 0x%x\n", addr, r);
   return r;
 }
 
+
+void Reg::shadow(bool v)
+{
+  //  Values may change while the cache is disabled
+  invalidate();
+  _shadow = v;
+}
+
+bool Reg::shadow()
+{
+  return _shadow;
+}
+
+void Reg::cacheable(const void* begin, unsigned bytes)
+{
+  uint32_t addr = reinterpret_cast<uintptr_t>(begin);
+  pthread_mutex_lock(&_cacheLock);
+  Region g;
+  g.begin = addr;
+  g.end   = addr + (bytes&~3);
+  g.value.resize(bytes>>2, 0);
+  g.clear.resize(bytes>>2, 0);
+  g.flags.resize(bytes>>2, 0);
+  _regions.push_back(g);
+  pthread_mutex_unlock(&_cacheLock);
+}
+
+void Reg::markVolatile(const void* begin, unsigned bytes)
+{
+  uint32_t addr = reinterpret_cast<uintptr_t>(begin);
+  pthread_mutex_lock(&_cacheLock);
+  for(uint32_t a=addr; a<addr+bytes; a+=4) {
+    Region* g = _region(a);
+    if (g)
+      g->flags[(a - g->begin)>>2] = Volatile;
+  }
+  pthread_mutex_unlock(&_cacheLock);
+}
+
+void Reg::selfClearing(const void* reg, unsigned mask)
+{
+  uint32_t addr = reinterpret_cast<uintptr_t>(reg);
+  pthread_mutex_lock(&_cacheLock);
+  Region* g = _region(addr);
+  if (g)
+    g->clear[(addr - g->begin)>>2] |= mask;
+  pthread_mutex_unlock(&_cacheLock);
+}
+
+void Reg::invalidate()
+{
+  pthread_mutex_lock(&_cacheLock);
+  for(unsigned i=0; i<_regions.size(); i++)
+    for(unsigned j=0; j<_regions[i].flags.size(); j++)
+      _regions[i].flags[j] &= Volatile;
+  pthread_mutex_unlock(&_cacheLock);
+}
+
+unsigned Reg::resync()
+{
+  unsigned stale = 0;
+  pthread_mutex_lock(&_cacheLock);
+  for(unsigned i=0; i<_regions.size(); i++) {
+    Region& g = _regions[i];
+    for(unsigned j=0; j<g.flags.size(); j++) {
+      if ((g.flags[j] & (Valid|Volatile)) != Valid)
+        continue;
+      uint32_t addr = g.begin + 4*j;
+      uint32_t r    = _busRead(addr) & ~g.clear[j];
+      _busReads++;
+      if (r != g.value[j]) {
+        printf("Pds::Mmhw::Reg resync [0x%x] : cached 0x%x  read 0x%x\n",
+               addr, g.value[j], r);
+        g.value[j] = r;
+        stale++;
+      }
+    }
+  }
+  pthread_mutex_unlock(&_cacheLock);
+  return stale;
+}
+
+void Reg::resetStats()
+{
+  pthread_mutex_lock(&_cacheLock);
+  _busReads = _busWrites = _hits = 0;
+  pthread_mutex_unlock(&_cacheLock);
+}
+
+void Reg::dumpStats()
+{
+  pthread_mutex_lock(&_cacheLock);
+  printf("Reg shadow %s: bus reads %llu  bus writes %llu  cached reads %llu\n",
+         _shadow ? "enabled" : "disabled",
+         (unsigned long long)_busReads,
+         (unsigned long long)_busWrites,
+         (unsigned long long)_hits);
+  pthread_mutex_unlock(&_cacheLock);
+}
@@ -13,8 +13,30 @@ namespace Pds {
             void setBit  (unsigned);
             void clearBit(unsigned);
         public:
-            static void set(unsigned fd);
+            //  Accesses use the driver's register ioctls unless the
+            //  register space has been mapped for direct access.
+            enum Backend { Ioctl, Mapped };
+            static void    set    (unsigned fd);
+            static bool    map    (unsigned fd, unsigned size);
+            static void    unmap  ();
+            static bool    backend(Backend);   // false if not available
+            static Backend backend();
             static void verbose(bool);
+        public:
+            //  Write-through shadow cache of configuration registers.
+            //  While enabled, reads of a register in a cacheable range
+            //  are served from its last written (or read) value, unless
+            //  the register is marked volatile.  Self-clearing bits are
+            //  dropped from the cached value.
+            static void     shadow      (bool);
+            static bool     shadow      ();
+            static void     cacheable   (const void* begin, unsigned bytes);
+            static void     markVolatile(const void* begin, unsigned bytes);
+            static void     selfClearing(const void* reg, unsigned mask);
+            static void     invalidate  ();
+            static unsigned resync      ();   // returns the number of stale values
+            static void     resetStats  ();
+            static void     dumpStats   ();
         private:
             uint32_t _reserved;
         };
@@ -3,25 +3,164 @@
 #include "RegProxy.hh"
 #include "Reg.hh"
 
-#include <semaphore.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <time.h>
 #include <inttypes.h>
 
+#include <deque>
+
 static uint64_t _base = 0;
 static Pds::Mmhw::Reg* _csr = 0;
-static sem_t _sem;
+
+//  One transaction at a time in the proxy
+static pthread_mutex_t _bus = PTHREAD_MUTEX_INITIALIZER;
+
+//  Posted writes
+namespace {
+  class Posted {
+  public:
+    uint32_t offset;
+    uint32_t value;
+  };
+};
+static std::deque<Posted> _queue;
+static bool               _busy    = false;
+static unsigned           _maxQueue= 0;
+static pthread_mutex_t    _qlock   = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     _work    = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t     _drained = PTHREAD_COND_INITIALIZER;
+static pthread_once_t     _once    = PTHREAD_ONCE_INIT;
+
+//  Completion wait: spin for about twice the typical latency, then
+//  sleep with exponential backoff
+static const unsigned MAX_SPIN_NS  = 200000;
+static const unsigned MIN_SLEEP_NS = 20000;
+static const unsigned MAX_SLEEP_NS = 1000000;
+static unsigned _spinNs  = MAX_SPIN_NS;
+static uint64_t _typical = 0;
+
+namespace {
+  class Stats {
+  public:
+    enum { Bins=16 };
+    uint64_t n;
+    uint64_t sum;      // ns
+    uint64_t min;
+    uint64_t max;
+    uint64_t spun;     // completed while spinning
+    unsigned hist[Bins];  // log2(us)
+  };
+};
+static Stats _stats[2];   // write, read
 
 using namespace Pds::Mmhw;
 
+static uint64_t _now()
+{
+  timespec tv;
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  return uint64_t(tv.tv_sec)*1000000000ULL + tv.tv_nsec;
+}
+
+//
+//  Wait for the launched transaction to complete.  Called with _bus held.
+//
+static void _wait(unsigned read, uint32_t offset, unsigned r)
+{
+  uint64_t t0    = _now();
+  uint64_t t     = t0;
+  uint64_t spin  = t0 + _spinNs;
+  uint64_t warn  = t0 + 4000000;
+  unsigned sleep = MIN_SLEEP_NS;
+  bool     spun  = true;
+
+  while((_csr[1]&1)==0) {
+    t = _now();
+    if (t < spin)
+      continue;
+    spun = false;
+    if (t > warn) {
+      printf("RegProxy tmo (%" PRIu64 " us) %s 0x%x %s %x\n",
+             (t-t0)/1000, read ? "read" : "writing", read ? 0 : r,
+             read ? "from" : "to", offset);
+      warn = t + 2*(t-t0);
+    }
+    timespec tv;
+    tv.tv_sec  = 0;
+    tv.tv_nsec = sleep;
+    nanosleep(&tv, 0);
+    if (sleep < MAX_SLEEP_NS)
+      sleep <<= 1;
+  }
+  t = _now();
+
+  //  Track the typical latency to size the spin
+  uint64_t dt = t - t0;
+  _typical = _typical ? (7*_typical + dt)/8 : dt;
+  _spinNs  = 2*_typical < MAX_SPIN_NS ? 2*_typical : MAX_SPIN_NS;
+
+  Stats& s = _stats[read];
+  if (s.n==0 || dt < s.min) s.min = dt;
+  if (dt > s.max) s.max = dt;
+  s.n++;
+  s.sum += dt;
+  if (spun) s.spun++;
+  unsigned us = dt/1000, bin = 0;
+  while(us && bin < Stats::Bins-1) { us >>= 1; bin++; }
+  s.hist[bin]++;
+}
+
+static void _write(uint32_t offset, unsigned r)
+{
+  pthread_mutex_lock(&_bus);
+  //  launch transaction
+  _csr[3] = r;
+  _csr[2] = offset;
+  _csr[0] = 0;
+  _wait(0, offset, r);
+  pthread_mutex_unlock(&_bus);
+}
+
+static void* _routine(void*)
+{
+  pthread_mutex_lock(&_qlock);
+  while(1) {
+    while(_queue.empty())
+      pthread_cond_wait(&_work, &_qlock);
+    Posted p = _queue.front();
+    _queue.pop_front();
+    _busy = true;
+    pthread_mutex_unlock(&_qlock);
+
+    _write(p.offset, p.value);
+
+    pthread_mutex_lock(&_qlock);
+    _busy = false;
+    if (_queue.empty())
+      pthread_cond_broadcast(&_drained);
+  }
+  return 0;
+}
+
+static void _start()
+{
+  pthread_t      tid;
+  pthread_attr_t tattr;
+  pthread_attr_init(&tattr);
+  pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&tid, &tattr, &_routine, 0))
+    perror("Error creating RegProxy thread");
+}
+
 void RegProxy::initialize(void* base, void* csr)
 {
     printf("RegProxy::initialize base %p  csr %p\n",base,csr);
-  sem_init(&_sem, 0, 1);
   _base = reinterpret_cast<uint64_t>(base);
   _csr  = reinterpret_cast<Pds::Mmhw::Reg*>(csr);
   //  Test if proxy exists
-  { 
+  {
     const unsigned t = 0xdeadbeef;
     _csr[2] = t;
     volatile unsigned v = _csr[2];
@@ -39,57 +178,97 @@ RegProxy& RegProxy::operator=(const unsigned r)
     return *this;
   }
 
-  sem_wait(&_sem);
-
-  //  launch transaction
-  _csr[3] = r;
-  _csr[2] = reinterpret_cast<uint64_t>(this)-_base;
-  _csr[0] = 0;
-
-  //  wait until transaction is complete
-  unsigned tmo=0;
-  unsigned tmo_mask = 0x3;
-  do { 
-    usleep(1000);
-    if ((++tmo&tmo_mask) ==  tmo_mask) {
-      tmo_mask = (tmo_mask<<1) | 1;
-      printf("RegProxy tmo (%x) writing 0x%x to %" PRIx64 "\n", 
-             tmo, r, reinterpret_cast<uint64_t>(this)-_base);
-    }
-  } while ( (_csr[1]&1)==0 );
-
-  sem_post(&_sem);
+  flush();
+  _write(reinterpret_cast<uint64_t>(this)-_base, r);
 
   return *this;
 }
 
-RegProxy::operator unsigned() const 
+RegProxy::operator unsigned() const
 {
   if (!_csr) {
     return _reserved;
   }
 
-  sem_wait(&_sem);
+  flush();
+
+  pthread_mutex_lock(&_bus);
 
   //  launch transaction
-  _csr[2] = reinterpret_cast<uint64_t>(this)-_base;
+  uint32_t offset = reinterpret_cast<uint64_t>(this)-_base;
+  _csr[2] = offset;
   _csr[0] = 1;
 
-  //  wait until transaction is complete
-  unsigned tmo=0;
-  unsigned tmo_mask = 0x3;
-  do { 
-    usleep(1000);
-    if ((++tmo&tmo_mask) == tmo_mask) {
-      tmo_mask = (tmo_mask<<1) | 1;
-      printf("RegProxy tmo (%x) read from %" PRIx64 "\n", 
-             tmo, reinterpret_cast<uint64_t>(this)-_base);
-    }
-  } while ( (_csr[1]&1)==0 );
-  
+  _wait(1, offset, 0);
+
   unsigned r = _csr[3];
 
-  sem_post(&_sem);
+  pthread_mutex_unlock(&_bus);
 
   return r;
 }
+
+void RegProxy::post(const unsigned r)
+{
+  if (!_csr) {
+    _reserved = r;
+    return;
+  }
+
+  pthread_once(&_once, _start);
+
+  Posted p;
+  p.offset = reinterpret_cast<uint64_t>(this)-_base;
+  p.value  = r;
+  pthread_mutex_lock(&_qlock);
+  _queue.push_back(p);
+  if (_queue.size() > _maxQueue)
+    _maxQueue = _queue.size();
+  pthread_cond_signal(&_work);
+  pthread_mutex_unlock(&_qlock);
+}
+
+void RegProxy::flush()
+{
+  pthread_mutex_lock(&_qlock);
+  while(!_queue.empty() || _busy)
+    pthread_cond_wait(&_drained, &_qlock);
+  pthread_mutex_unlock(&_qlock);
+}
+
+void RegProxy::dumpStats()
+{
+  pthread_mutex_lock(&_bus);
+  printf("RegProxy: spin %u ns  max queued %u\n", _spinNs, _maxQueue);
+  static const char* _names[] = { "write", "read" };
+  for(unsigned i=0; i<2; i++) {
+    const Stats& s = _stats[i];
+    if (!s.n)
+      continue;
+    printf("  %5.5s: %8" PRIu64 " transactions  min %7.1f  mean %7.1f  max %7.1f us  spun %5.1f%%\n",
+           _names[i], s.n,
+           double(s.min)*1.e-3,
+           double(s.sum)*1.e-3/double(s.n),
+           double(s.max)*1.e-3,
+           100.*double(s.spun)/double(s.n));
+    printf("         us <");
+    for(unsigned b=0; b<Stats::Bins; b++)
+      if (s.hist[b])
+        printf(" %u:%u", 1<<b, s.hist[b]);
+    printf("\n");
+  }
+  pthread_mutex_unlock(&_bus);
+}
+
+void RegProxy::resetStats()
+{
+  pthread_mutex_lock(&_bus);
+  for(unsigned i=0; i<2; i++) {
+    Stats& s = _stats[i];
+    s.n = s.sum = s.min = s.max = s.spun = 0;
+    for(unsigned b=0; b<Stats::Bins; b++)
+      s.hist[b] = 0;
+  }
+  _maxQueue = 0;
+  pthread_mutex_unlock(&_bus);
+}
@@ -12,6 +12,15 @@ namespace Pds {
     public:
       RegProxy& operator=(const unsigned);
       operator unsigned() const;
+    public:
+      //  Queue a write and return without waiting for it.  Queued
+      //  writes complete in order, and before any later read or
+      //  synchronous write.
+      void        post (const unsigned);
+      static void flush();
+    public:
+      static void dumpStats ();
+      static void resetStats();
     private:
       uint32_t _reserved;
     };
@@ -0,0 +1,157 @@
+#include "ReplaySource.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+using namespace Pds::HSD;
+
+//  Longest wait between replayed events, for gaps in the recording
+static const uint64_t MAX_GAP_NS = 1000000000ULL;
+
+ReplaySource::Config::Config() :
+  speed  (1),
+  loops  (1),
+  buffers(256),
+  preload(false)
+{
+}
+
+bool ReplaySource::Config::parse(const char* options)
+{
+  std::string s(options);
+  char* save = 0;
+  for(char* tok = strtok_r(&s[0], ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+    char* v = strchr(tok, '=');
+    if (!v) {
+      printf("ReplaySource: option %s has no value\n", tok);
+      return false;
+    }
+    *v++ = 0;
+    if      (!strcmp(tok, "speed"  )) speed   = strtod (v, 0);
+    else if (!strcmp(tok, "loops"  )) loops   = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "buffers")) buffers = strtoul(v, 0, 0);
+    else if (!strcmp(tok, "preload")) preload = strtoul(v, 0, 0)!=0;
+    else {
+      printf("ReplaySource: unknown option %s\n", tok);
+      return false;
+    }
+  }
+  if (speed < 0) {
+    printf("ReplaySource: speed %f < 0\n", speed);
+    return false;
+  }
+  return true;
+}
+
+ReplaySource::ReplaySource(const char* path, const Config& c) :
+  DmaGenerator("Replay"),
+  _config(c),
+  _valid (false),
+  _next  (0),
+  _loop  (0)
+{
+  if (!_file.open(path))
+    return;
+  if (!_file.events()) {
+    printf("ReplaySource: %s has no events\n", path);
+    return;
+  }
+
+  unsigned bytes = 0;
+  uint64_t total = 0;
+  for(unsigned i=0; i<_file.events(); i++) {
+    unsigned n = _file.size(i);
+    if (n > bytes)
+      bytes = n;
+    total += n;
+  }
+  if (!(_valid = _allocate(_config.buffers, bytes)))
+    return;
+
+  //  Fault the mapping in now rather than while pacing
+  if (_config.preload) {
+    volatile uint32_t sum = 0;
+    for(unsigned i=0; i<_file.events(); i++) {
+      const char* p = reinterpret_cast<const char*>(&_file.event(i));
+      for(unsigned o=0; o<_file.size(i); o+=4096)
+        sum += p[o];
+    }
+  }
+
+  printf("ReplaySource: %s  %u events  %.1f MB  %s  %u buffers of 0x%x B  speed %g  loops %u%s\n",
+         path, _file.events(), double(total)*1.e-6,
+         _file.indexed() ? "indexed" : "scanned",
+         _config.buffers, bytes, _config.speed, _config.loops,
+         _config.preload ? "  preloaded" : "");
+}
+
+ReplaySource::~ReplaySource()
+{
+  _stop();
+}
+
+ReplaySource* ReplaySource::create(const char* name)
+{
+  std::string path(name+7);   // after "replay:"
+  Config c;
+  size_t comma = path.find(',');
+  if (comma != std::string::npos) {
+    if (!c.parse(path.c_str()+comma+1))
+      return 0;
+    path.resize(comma);
+  }
+  ReplaySource* r = new ReplaySource(path.c_str(), c);
+  if (!r->_valid) {
+    delete r;
+    return 0;
+  }
+  return r;
+}
+
+uint64_t ReplaySource::_time(unsigned i) const
+{
+  uint64_t ts = _file.event(i).timeStamp();
+  return (ts>>32)*1000000000ULL + (ts&0xffffffff);
+}
+
+//
+//  The recorded spacing of the next event from the one before, scaled
+//  by the speed.  The first event of each pass goes out at once.
+//
+bool ReplaySource::_interval(uint64_t& ns)
+{
+  if (_config.loops && _loop >= _config.loops)
+    return false;
+
+  ns = 0;
+  if (_config.speed > 0 && _next > 0) {
+    uint64_t t0 = _time(_next-1);
+    uint64_t t1 = _time(_next);
+    if (t1 > t0) {
+      ns = uint64_t(double(t1-t0)/_config.speed);
+      if (ns > MAX_GAP_NS)
+        ns = MAX_GAP_NS;
+    }
+  }
+  return true;
+}
+
+unsigned ReplaySource::_fill(void* buffer, uint32_t& dest)
+{
+  unsigned i    = _next;
+  unsigned size = _file.size(i);
+  memcpy(buffer, &_file.event(i), size);
+  dest = (_file.indexed() ? _file.entry(i).lane : 0)<<5;
+  //  The stream mask as the card sent it, without the recorded lane
+  uint32_t* info = reinterpret_cast<uint32_t*>(buffer) + 6;
+  *info = (*info & ~(0xffu<<20)) | (_file.streams(i)<<20);
+
+  if (++_next == _file.events()) {
+    _next = 0;
+    _loop++;
+  }
+  return size;
+}
@@ -0,0 +1,63 @@
+#ifndef HSD_ReplaySource_hh
+#define HSD_ReplaySource_hh
+
+#include "DmaGenerator.hh"
+#include "RecordFile.hh"
+
+#include <stdint.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Events of a file recorded by hsdRead -f, served as the card
+    //  would (see DmaGenerator).  The lane of each event is taken from
+    //  the index when there is one, else lane 0.  Events are replayed
+    //  as recorded, so the pulse ids and analysis counts repeat when
+    //  the file is looped.
+    //
+    //  Options after the file name, comma separated key=value:
+    //    speed=<x>      multiple of the recorded rate, from the event
+    //                   timestamps; 0 for as fast as the reader returns
+    //                   buffers [Default: 1]
+    //    loops=<n>      passes over the file, 0 for no end [Default: 1]
+    //    buffers=<n>    DMA buffers [Default: 256]
+    //    preload=1      read the file into memory before starting
+    //
+    class ReplaySource : public DmaGenerator {
+    public:
+      class Config {
+      public:
+        Config();
+        bool parse(const char* options);
+      public:
+        double   speed;
+        unsigned loops;
+        unsigned buffers;
+        bool     preload;
+      };
+    public:
+      ReplaySource(const char* path, const Config&);
+      ~ReplaySource();
+      //  "replay:<file>[,options]"; 0 if the file doesn't open or the
+      //  options don't parse
+      static ReplaySource* create(const char* name);
+    public:
+      const Config&     config() const { return _config; }
+      const RecordFile& file  () const { return _file; }
+      unsigned          loop  () const { return _loop; }
+    protected:
+      bool     _interval (uint64_t& ns);
+      unsigned _fill     (void* buffer, uint32_t& dest);
+    private:
+      uint64_t _time     (unsigned i) const;
+    private:
+      Config     _config;
+      RecordFile _file;
+      bool       _valid;
+      unsigned   _next;       // event to be served
+      unsigned   _loop;       // passes completed
+    };
+  };
+};
+
+#endif
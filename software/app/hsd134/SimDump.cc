@@ -0,0 +1,201 @@
+#include "SimDump.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <charconv>
+#include <vector>
+
+using namespace Pds::HSD;
+
+namespace Pds {
+  namespace HSD {
+    class SimTask {
+    public:
+      const char*           begin;
+      const char*           end;
+      std::vector<uint32_t> words;
+      std::vector<unsigned> ends;      // word offset past each event
+      unsigned              lines;
+      unsigned              malformed;
+      unsigned              first;     // first malformed line
+      bool                  thread;
+    };
+  };
+};
+
+static inline bool _blank(char c)
+{
+  return c==' ' || c=='\t' || c=='\r';
+}
+
+//
+//  The start of the line holding p-1, so a chunk boundary never
+//  splits a line
+//
+static const char* _lineStart(const char* p, const char* end)
+{
+  if (p >= end)
+    return end;
+  const char* nl = reinterpret_cast<const char*>(memchr(p-1, '\n', end-(p-1)));
+  return nl ? nl+1 : end;
+}
+
+static void* _routine(void* arg)
+{
+  SimTask& task = *reinterpret_cast<SimTask*>(arg);
+  task.ends.clear();
+  task.lines     = 0;
+  task.malformed = 0;
+  task.first     = 0;
+
+  size_t room = (task.end-task.begin+1)/2+1;
+  if (task.words.size() < room)
+    task.words.resize(room);
+  uint32_t* base = task.words.data();
+  uint32_t* u    = base;
+
+  const char* p = task.begin;
+  while(p < task.end) {
+    const char* nl = reinterpret_cast<const char*>(memchr(p, '\n', task.end-p));
+    const char* e  = nl ? nl : task.end;
+    task.lines++;
+    int n = SimDump::parse(p, e, u);
+    if (n < 0) {
+      if (!task.malformed++)
+        task.first = task.lines;
+    }
+    else if (n) {
+      u += n;
+      task.ends.push_back(u-base);
+    }
+    p = nl ? nl+1 : task.end;
+  }
+  return 0;
+}
+
+SimDump::SimDump() : _base(0), _size(0), _malformed(0), _firstMalformed(0) {}
+
+SimDump::~SimDump()
+{
+  close();
+}
+
+bool SimDump::open(const char* path)
+{
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat s;
+  if (fstat(fd, &s)) {
+    perror("fstat");
+    ::close(fd);
+    return false;
+  }
+  _size = s.st_size;
+  if (_size) {
+    void* p = mmap(0, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      perror("mmap simulation dump");
+      ::close(fd);
+      _size = 0;
+      return false;
+    }
+    _base = reinterpret_cast<const char*>(p);
+    madvise(const_cast<char*>(_base), _size, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+  return true;
+}
+
+void SimDump::close()
+{
+  if (_base)
+    munmap(const_cast<char*>(_base), _size);
+  _base = 0;
+  _size = 0;
+}
+
+int SimDump::parse(const char* p, const char* end, uint32_t* out)
+{
+  uint32_t* u = out;
+  while(1) {
+    while(p < end && _blank(*p))
+      p++;
+    if (p == end)
+      break;
+    std::from_chars_result r = std::from_chars(p, end, *u, 16);
+    if (r.ec != std::errc() || (r.ptr < end && !_blank(*r.ptr)))
+      return -1;
+    u++;
+    p = r.ptr;
+  }
+  return u-out;
+}
+
+unsigned SimDump::read(Fn fn, void* arg, unsigned nthreads, size_t chunk)
+{
+  _malformed      = 0;
+  _firstMalformed = 0;
+  if (nthreads < 1)
+    nthreads = 1;
+  if (chunk < 1)
+    chunk = 1;
+
+  std::vector<SimTask>   tasks(nthreads);
+  std::vector<pthread_t> threads(nthreads);
+
+  const char* end   = _base+_size;
+  const char* p     = _base;
+  uint64_t    line  = 0;
+  unsigned    index = 0;
+  while(p < end) {
+    //  Parse a batch of consecutive chunks in parallel
+    for(unsigned t=0; t<nthreads; t++) {
+      SimTask& task = tasks[t];
+      task.begin = p;
+      p = _lineStart(size_t(end-p) > chunk ? p+chunk : end, end);
+      task.end   = p;
+    }
+
+    for(unsigned t=1; t<nthreads; t++) {
+      tasks[t].thread = tasks[t].begin < tasks[t].end;
+      if (tasks[t].thread &&
+          pthread_create(&threads[t], 0, &_routine, &tasks[t])) {
+        perror("Error creating simulation dump thread");
+        _routine(&tasks[t]);
+        tasks[t].thread = false;
+      }
+    }
+    _routine(&tasks[0]);
+    for(unsigned t=1; t<nthreads; t++)
+      if (tasks[t].thread)
+        pthread_join(threads[t], NULL);
+
+    //  Hand out the events in order
+    for(unsigned t=0; t<nthreads; t++) {
+      const SimTask& task = tasks[t];
+      if (task.begin == task.end)
+        continue;
+      unsigned off = 0;
+      for(unsigned i=0; i<task.ends.size(); i++) {
+        (*fn)(task.words.data()+off, task.ends[i]-off, index++, arg);
+        off = task.ends[i];
+      }
+      if (task.malformed && !_malformed)
+        _firstMalformed = line + task.first;
+      _malformed += task.malformed;
+      line       += task.lines;
+    }
+  }
+  return index;
+}
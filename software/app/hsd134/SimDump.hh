@@ -0,0 +1,53 @@
+#ifndef HSD_SimDump_hh
+#define HSD_SimDump_hh
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Text dump of the event stream from the firmware simulation
+    //  (HsdXtc): one event per line, each 32-bit word in hex and right
+    //  justified in 9 characters.  The file is mapped read-only and
+    //  parsed in batches; each thread of a batch parses its own run of
+    //  whole lines, and the events are then handed out in file order
+    //  from the calling thread.
+    //
+    class SimDump {
+    public:
+      //  Called for each event in file order
+      typedef void (*Fn)(const uint32_t* event,
+                         unsigned        words,
+                         unsigned        index,
+                         void*           arg);
+    public:
+      SimDump();
+      ~SimDump();
+    public:
+      bool   open (const char* path);
+      void   close();
+      size_t bytes() const { return _size; }
+    public:
+      //  Parse the file with nthreads threads of chunk bytes each per
+      //  batch.  Returns the number of events.
+      unsigned read(Fn fn, void* arg, unsigned nthreads, size_t chunk=16<<20);
+      //  Lines that were not all hex words, and the first of them
+      //  (counting from 1)
+      unsigned malformed     () const { return _malformed; }
+      uint64_t firstMalformed() const { return _firstMalformed; }
+    public:
+      //  Words of the line [p,end) into out, which has room for
+      //  (end-p+1)/2 words.  Returns -1 if the line is not all hex
+      //  words separated by blanks.
+      static int parse(const char* p, const char* end, uint32_t* out);
+    private:
+      const char*           _base;
+      size_t                _size;
+      unsigned              _malformed;
+      uint64_t              _firstMalformed;
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "Simd.hh"
+
+using namespace Pds::HSD;
+
+bool Simd::supported(Isa v)
+{
+#ifdef HSD_X86
+  __builtin_cpu_init();   // may run before the cpu model is initialized
+#endif
+  switch(v) {
+  case Scalar: return true;
+#ifdef HSD_X86
+  case SSE42 : return __builtin_cpu_supports("sse4.2");
+  case AVX2  : return __builtin_cpu_supports("avx2");
+#endif
+  default    : break;
+  }
+  return false;
+}
+
+Simd::Isa Simd::best()
+{
+  for(int i=NumberOf-1; i>Scalar; i--)
+    if (supported(Isa(i)))
+      return Isa(i);
+  return Scalar;
+}
+
+const char* Simd::name(Isa v)
+{
+  static const char* _names[] = { "scalar", "sse4.2", "avx2" };
+  return v < NumberOf ? _names[v] : "unknown";
+}
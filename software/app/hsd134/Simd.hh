@@ -0,0 +1,25 @@
+#ifndef HSD_Simd_hh
+#define HSD_Simd_hh
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HSD_X86
+#endif
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Instruction sets of the vectorized data kernels.  Each kernel
+    //  starts with the best one the CPU supports.
+    //
+    class Simd {
+    public:
+      enum Isa { Scalar, SSE42, AVX2, NumberOf };
+    public:
+      static bool        supported(Isa);
+      static Isa         best     ();
+      static const char* name     (Isa);
+    };
+  };
+};
+
+#endif
@@ -0,0 +1,464 @@
+#include "Sparsifier.hh"
+
+#ifdef HSD_X86
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+using namespace Pds::HSD;
+
+//  Counters are 13 bits, the row buffer address 4 bits
+static const unsigned COUNT_MASK = 0x1fff;
+static const unsigned ADDR_MASK  = 0xf;
+static const unsigned NOPEN_MASK = 0x1f;
+//  Largest tpre/tpost the row buffer depth allows
+static const unsigned MAX_T      = 30;
+
+//
+//  Scalar kernel, also used for the tails of the vector kernels.
+//  Super-samples are the 4 interleaved samples of a clock.
+//
+static void _cross_scalar(const uint16_t* x, unsigned s, unsigned nss,
+                          uint16_t lo, uint16_t hi, uint64_t* bits)
+{
+  for(; s<nss; s++) {
+    const uint16_t* q = x + s*Sparsifier::Ilv;
+    bool c = false;
+    for(unsigned j=0; j<Sparsifier::Ilv; j++)
+      c |= q[j] < lo || q[j] > hi;
+    if (c)
+      bits[s>>6] |= uint64_t(1)<<(s&63);
+  }
+}
+
+static void _cross_s(const uint16_t* x, unsigned nss, uint16_t lo, uint16_t hi, uint64_t* bits)
+{ _cross_scalar(x, 0, nss, lo, hi, bits); }
+
+//
+//  The vector kernels test 8 (16) samples at once and fold each 64-bit
+//  lane, one super-sample, into its top word for movemask_pd.
+//
+#ifdef HSD_X86
+__attribute__((target("sse4.2")))
+static void _cross_sse42(const uint16_t* x, unsigned nss, uint16_t lo, uint16_t hi, uint64_t* bits)
+{
+  const __m128i vlo  = _mm_set1_epi16(lo);
+  const __m128i vhi  = _mm_set1_epi16(hi);
+  const __m128i ones = _mm_set1_epi32(-1);
+  unsigned s=0;
+  for(; s+2<=nss; s+=2) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x+s*4));
+    __m128i q = _mm_and_si128(_mm_cmpeq_epi16(_mm_max_epu16(v, vlo), v),
+                              _mm_cmpeq_epi16(_mm_min_epu16(v, vhi), v));
+    q = _mm_xor_si128(q, ones);
+    q = _mm_or_si128(q, _mm_srli_epi64(q, 32));
+    q = _mm_or_si128(q, _mm_srli_epi64(q, 16));
+    unsigned m = _mm_movemask_pd(_mm_castsi128_pd(_mm_slli_epi64(q, 48)));
+    bits[s>>6] |= uint64_t(m)<<(s&63);
+  }
+  _cross_scalar(x, s, nss, lo, hi, bits);
+}
+
+__attribute__((target("avx2")))
+static void _cross_avx2(const uint16_t* x, unsigned nss, uint16_t lo, uint16_t hi, uint64_t* bits)
+{
+  const __m256i vlo  = _mm256_set1_epi16(lo);
+  const __m256i vhi  = _mm256_set1_epi16(hi);
+  const __m256i ones = _mm256_set1_epi32(-1);
+  unsigned s=0;
+  for(; s+4<=nss; s+=4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x+s*4));
+    __m256i q = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(v, vlo), v),
+                                 _mm256_cmpeq_epi16(_mm256_min_epu16(v, vhi), v));
+    q = _mm256_xor_si256(q, ones);
+    q = _mm256_or_si256(q, _mm256_srli_epi64(q, 32));
+    q = _mm256_or_si256(q, _mm256_srli_epi64(q, 16));
+    unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_slli_epi64(q, 48)));
+    bits[s>>6] |= uint64_t(m)<<(s&63);
+  }
+  _cross_scalar(x, s, nss, lo, hi, bits);
+}
+#endif
+
+namespace {
+  typedef void (*Cross)(const uint16_t*, unsigned, uint16_t, uint16_t, uint64_t*);
+};
+
+static const Cross _kernels[] = {
+  _cross_s,
+#ifdef HSD_X86
+  _cross_sse42,
+  _cross_avx2,
+#endif
+};
+
+static Simd::Isa _isa = Simd::best();
+
+void Sparsifier::cross(const uint16_t* x, unsigned nss,
+                       uint16_t lo, uint16_t hi, uint64_t* bits)
+{
+  memset(bits, 0, ((nss+63)/64)*sizeof(uint64_t));
+  _kernels[_isa](x, nss, lo, hi, bits);
+}
+
+Simd::Isa Sparsifier::isa() { return _isa; }
+
+bool Sparsifier::select(Simd::Isa v)
+{
+  if (!Simd::supported(v))
+    return false;
+  _isa = v;
+  return true;
+}
+
+//
+//  The firmware reset values; the thresholds reset to the baseline,
+//  so that every sample crosses
+//
+Sparsifier::Config::Config() :
+  xlo  (0x4000),
+  xhi  (0x4000),
+  tpre (1),
+  tpost(1)
+{
+}
+
+Sparsifier::Config::Config(unsigned lo, unsigned hi, unsigned pre, unsigned post) :
+  xlo  (lo),
+  xhi  (hi),
+  tpre (pre),
+  tpost(post)
+{
+}
+
+Sparsifier::Sparsifier(const Config& c) :
+  _config(c)
+{
+  _config.xlo  &= 0x7fff;
+  _config.xhi  &= 0x7fff;
+  _config.tpre  = std::min(_config.tpre , MAX_T);
+  _config.tpost = std::min(_config.tpost, MAX_T);
+  reset();
+}
+
+void Sparsifier::reset()
+{
+  _tpreRows  = (_config.tpre +RowSize-1)/RowSize;
+  _tpostRows = (_config.tpost+RowSize-1)/RowSize;
+  _tpreCol   = _config.tpre%RowSize;
+  _tpostCol  = RowSize - _config.tpost%RowSize;
+  _sync      = true;
+  _count     = 0;
+  _countLast = 0;
+  _nopen     = 0;
+  _lskip     = false;
+  _tskip     = 0;
+  _waddr     = 0;
+  _raddr     = 0;
+  _ikeepf    = RowSize;
+  _ikeepl    = RowSize;
+  _kupdate   = false;
+  _irowf = _irowl = _icolf = _icoll = 0;
+  for(unsigned i=0; i<Keeps; i++) {
+    _akeep[i].state = KeepNone;
+    _akeep[i].first = 0;
+    _akeep[i].last  = 0;
+  }
+  memset(_ramx , 0, sizeof(_ramx ));
+  memset(_ramt , 0, sizeof(_ramt ));
+  memset(_xsave, 0, sizeof(_xsave));
+  memset(_tsave, 0, sizeof(_tsave));
+}
+
+void Sparsifier::clock(const uint16_t* x, const uint8_t* t, Row& out)
+{
+  uint64_t bits;
+  cross(x, RowSize, _config.xlo, _config.xhi, &bits);
+  unsigned mask = unsigned(bits);
+  for(unsigned i=0; i<RowSize; i++)
+    if (t[i])
+      mask |= 1<<i;
+  _clock(mask, x, t, out);
+}
+
+//
+//  A skip slot, counting super-samples (the low 2 bits of the first
+//  word are the sample within)
+//
+static void _skip(uint16_t* y, unsigned n)
+{
+  y[0] = 0x8000 | ((n&COUNT_MASK)<<2);
+  y[1] = y[2] = y[3] = 0x8000;
+}
+
+//
+//  The comb process of hsd_thr_ilv_native_fine.  Everything on the
+//  right hand side is the registered state; the new state is
+//  assigned at the end.  The irow/icol values are signed, since
+//  tpre=tpost=0 puts the last row at -1.
+//
+void Sparsifier::_clock(unsigned mask, const uint16_t* x, const uint8_t* t, Row& out)
+{
+  //  First and last crossing in the incoming row
+  unsigned ikeepl = mask ? 31-__builtin_clz(mask) : unsigned(RowSize);
+  unsigned ikeepf = mask ?    __builtin_ctz(mask) : unsigned(RowSize);
+
+  //  Rows and columns the previous row's crossings keep
+  bool kupdate = false;
+  int irowf = _irowf, irowl = _irowl, icolf = _icolf, icoll = _icoll;
+  if (_ikeepf < RowSize) {
+    kupdate = true;
+    if (_ikeepf < _tpreCol) {
+      irowf = 0;
+      icolf = RowSize-_tpreCol+_ikeepf;
+    }
+    else {
+      irowf = 1;
+      icolf = _ikeepf-_tpreCol;
+    }
+    if (_ikeepl < _tpostCol) {
+      irowl = int(_tpreRows+_tpostRows)-1;
+      icoll = RowSize-_tpostCol+_ikeepl;
+    }
+    else {
+      irowl = _tpreRows+_tpostRows;
+      icoll = _ikeepl-_tpostCol;
+    }
+  }
+
+  Keep akeep[Keeps];
+  for(unsigned i=0; i<Keeps-1; i++)
+    akeep[i] = _akeep[i+1];
+  akeep[Keeps-1].state = KeepNone;
+  akeep[Keeps-1].first = 0;
+  akeep[Keeps-1].last  = 0;
+
+  if (_kupdate) {
+    const int rowf = _irowf, rowl = int(_irowl);
+    const unsigned colf = _icolf, coll = _icoll;
+    for(int irow=0; irow<int(Keeps); irow++) {
+      Keep& k = akeep[irow];
+      bool toEnd = coll==RowSize-1 || rowl > irow;
+      if (irow == rowf) {
+        if (k.state == KeepNone) {
+          if (toEnd) {
+            k.state = colf==0 ? KeepAll : KeepTail;
+            k.first = colf;
+            k.last  = RowSize-1;
+          }
+          else {
+            k.state = colf==0 ? KeepHead : KeepMid;
+            k.first = colf;
+            k.last  = coll;
+          }
+        }
+        else if (k.state == KeepHead) {
+          if (toEnd) {
+            k.state = KeepAll;
+            k.first = 0;
+            k.last  = RowSize-1;
+          }
+          else
+            k.last  = coll;
+        }
+        else if (k.state == KeepMid) {
+          if (toEnd) {
+            k.state = KeepTail;
+            k.last  = RowSize-1;
+          }
+          else
+            k.last  = coll;
+        }
+      }
+      else if (irow == rowl) {
+        if (k.state == KeepNone || k.state == KeepHead) {
+          k.state = coll==RowSize-1 ? KeepAll : KeepHead;
+          k.first = 0;
+          k.last  = coll;
+        }
+      }
+      else if (irow > rowf && irow < rowl) {
+        k.state = KeepAll;
+        k.first = 0;
+        k.last  = RowSize-1;
+      }
+    }
+  }
+
+  //  Default response
+  memcpy(out.y, _xsave, sizeof(_xsave));
+  for(unsigned i=RowSamples; i<Slots*Ilv; i++)
+    out.y[i] = 0x8000;
+  memcpy(out.t, _tsave, sizeof(_tsave));
+  out.t[RowSize] = 0;
+
+  //  Window opening/closing in the row read out
+  unsigned tsum  = 0;
+  unsigned iopen = RowSize-1;
+  for(int i=RowSize-1; i>=0; i--) {
+    tsum |= _tsave[i];
+    if (_tsave[i])
+      iopen = i;
+  }
+
+  unsigned dcount    = (_count - _countLast) & COUNT_MASK;
+  unsigned tskip     = _tskip;
+  unsigned countLast = _countLast;
+  bool     lskip;
+  const Keep& k0 = _akeep[0];
+
+  if ((_nopen || tsum) && k0.state != KeepNone) {
+    if (_lskip || k0.state == KeepMid || k0.state == KeepTail) {
+      dcount = (dcount + k0.first) & COUNT_MASK;
+      _skip(out.y, dcount-1);
+      out.t[0] = _tskip;
+      tskip    = 0;
+      for(unsigned i=k0.first; i<RowSize; i++) {
+        unsigned k = i-k0.first;
+        memcpy(&out.y[(k+1)*Ilv], &_xsave[i*Ilv], Ilv*sizeof(uint16_t));
+        out.t[k+1] = _tsave[i];
+      }
+      out.yv = k0.last-k0.first+2;
+    }
+    else {
+      for(unsigned i=k0.first; i<RowSize; i++) {
+        unsigned k = i-k0.first;
+        memcpy(&out.y[k*Ilv], &_xsave[i*Ilv], Ilv*sizeof(uint16_t));
+        out.t[k] = _tsave[i];
+      }
+      out.yv = k0.last-k0.first+1;
+    }
+    countLast = (_count + k0.last) & COUNT_MASK;
+    lskip     = k0.last != RowSize-1;
+  }
+  else if (tsum || (dcount & 0x1000)) {
+    _skip(out.y, dcount+iopen-1);
+    out.t[0]  = _tskip;
+    tskip     = tsum;
+    out.yv    = 1;
+    countLast = (_count + iopen-1) & COUNT_MASK;
+    lskip     = true;
+  }
+  else {
+    out.yv    = 0;
+    lskip     = true;
+  }
+
+  unsigned waddr = _sync ? (_tpreRows+2)&ADDR_MASK : (_waddr+1)&ADDR_MASK;
+  unsigned raddr = _sync ? 0 : (_raddr+1)&ADDR_MASK;
+
+  unsigned nopen = _nopen;
+  if (tsum == Open)
+    nopen = (nopen+1)&NOPEN_MASK;
+  else if (tsum == Close)
+    nopen = (nopen-1)&NOPEN_MASK;
+
+  //  Row buffer: registered read, write of the incoming row
+  memcpy(_xsave, _ramx[_raddr], sizeof(_xsave));
+  memcpy(_tsave, _ramt[_raddr], sizeof(_tsave));
+  memcpy(_ramx[_waddr], x, sizeof(_xsave));
+  memcpy(_ramt[_waddr], t, sizeof(_tsave));
+
+  //  Registers
+  _ikeepf    = ikeepf;
+  _ikeepl    = ikeepl;
+  _kupdate   = kupdate;
+  _irowf     = irowf;
+  _irowl     = irowl;
+  _icolf     = icolf;
+  _icoll     = icoll;
+  memcpy(_akeep, akeep, sizeof(akeep));
+  _countLast = countLast;
+  _count     = (_count + RowSize) & COUNT_MASK;
+  _nopen     = nopen;
+  _lskip     = lskip;
+  _tskip     = tskip;
+  _waddr     = waddr;
+  _raddr     = raddr;
+  _sync      = false;
+}
+
+//
+//  The gate is placed after RamRows quiet rows, so the pipeline is
+//  primed as it would be in a long run of quiet samples.  The quiet
+//  value lies inside the thresholds.  The clocks run until the slot
+//  with the close is put out: the close row plus the row buffer delay,
+//  and one more in case the close was held in a skip.
+//
+int Sparsifier::stream(const uint16_t* raw, unsigned n, unsigned phase,
+                       std::vector<uint16_t>& out)
+{
+  if (n % Ilv || phase >= RowSize)
+    return -1;
+
+  unsigned nss   = n/Ilv;
+  unsigned s0    = RamRows*RowSize + phase;   // opens
+  unsigned s1    = s0 + nss;                  // closes
+  unsigned delay = _tpreRows + 3;
+  unsigned rows  = s1/RowSize + delay + 2;
+
+  uint16_t quiet = _config.xlo <= _config.xhi ? (_config.xlo+_config.xhi)/2 : 0;
+  _pad .assign(rows*RowSamples, quiet);
+  memcpy(&_pad[s0*Ilv], raw, n*sizeof(uint16_t));
+  _trig.assign(rows*RowSize, 0);
+  _trig[s0] |= Open;
+  _trig[s1] |= Close;
+  _bits.resize((rows*RowSize+63)/64 + 1);
+  cross(_pad.data(), rows*RowSize, _config.xlo, _config.xhi, _bits.data());
+  _bits.back() = 0;
+
+  reset();
+
+  size_t base   = out.size();
+  bool   open   = false;
+  bool   closed = false;
+  Row    row;
+  for(unsigned r=0; r<rows && !closed; r++) {
+    unsigned s    = r*RowSize;
+    uint64_t b    = _bits[s>>6] >> (s&63);
+    if ((s&63) > 64-RowSize)
+      b |= _bits[(s>>6)+1] << (64-(s&63));
+    unsigned mask = unsigned(b) & ((1<<RowSize)-1);
+    for(unsigned i=0; i<RowSize; i++)
+      if (_trig[s+i])
+        mask |= 1<<i;
+
+    _clock(mask, &_pad[r*RowSamples], &_trig[s], row);
+
+    for(unsigned j=0; j<row.yv; j++) {
+      if (!open && (row.t[j] & Open))
+        open = true;
+      if (open && (row.t[j] & Close)) {
+        closed = true;
+        break;
+      }
+      if (open)
+        out.insert(out.end(), &row.y[j*Ilv], &row.y[(j+1)*Ilv]);
+    }
+  }
+
+  //  A close in a skip is put out with the next readout or skip
+  if (open && !closed && (_tskip & Close))
+    closed = true;
+
+  if (!closed) {
+    out.resize(base);
+    return -1;
+  }
+  return out.size() - base;
+}
+
+int Sparsifier::match(const uint16_t* raw, unsigned n,
+                      const uint16_t* fex, unsigned nfex, unsigned phase)
+{
+  for(unsigned i=0; i<RowSize; i++) {
+    unsigned p = (phase+i)%RowSize;
+    _out.clear();
+    if (stream(raw, n, p, _out) == int(nfex) &&
+        !memcmp(_out.data(), fex, nfex*sizeof(uint16_t)))
+      return p;
+  }
+  return -1;
+}
@@ -0,0 +1,116 @@
+#ifndef HSD_Sparsifier_hh
+#define HSD_Sparsifier_hh
+
+#include "Simd.hh"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Model of the threshold sparsifier that makes stream 3
+    //  (hsd_thr_ilv_native_fine), clock by clock.  Each clock takes a
+    //  row of 10 super-samples of 4 interleaved samples and puts out up
+    //  to 11 four-word slots: kept super-samples, and skip slots whose
+    //  first word is 0x8000 | 4*(super-samples skipped).  A super-sample
+    //  is kept when it or one within tpre after / tpost before it is
+    //  outside [xlo,xhi] or carries a gate edge, at the granularity the
+    //  firmware allows (one run per row).  A tpre or tpost that is a
+    //  multiple of 10 puts the window a row off in the firmware; the
+    //  model does the same.
+    //
+    //  stream() frames the slots as the readout does, from the slot
+    //  carrying the gate opening up to the one carrying its close.
+    //  The raw stream only covers the gate, so it is exact when nothing
+    //  outside the gate crosses the thresholds close enough to reach
+    //  into it.  The samples are those the sparsifier compares, i.e.
+    //  without the baseline correction.
+    //
+    class Sparsifier {
+    public:
+      enum { RowSize = 10, Ilv = 4, RowSamples = RowSize*Ilv, Slots = RowSize+1 };
+      enum { Open = 1, Close = 2 };   // trigger bits of a super-sample
+      //  The stream 3 parameter registers (FexCfg::_stream[3].parms)
+      class Config {
+      public:
+        Config();
+        Config(unsigned xlo, unsigned xhi, unsigned tpre, unsigned tpost);
+      public:
+        unsigned xlo;     // parms[0]
+        unsigned xhi;     // parms[1]
+        unsigned tpre;    // parms[2], super-samples, up to 30
+        unsigned tpost;   // parms[3], super-samples, up to 30
+      };
+      //  Output of one clock
+      class Row {
+      public:
+        uint16_t y[Slots*Ilv];
+        uint8_t  t[Slots];
+        unsigned yv;      // valid slots
+      };
+    public:
+      Sparsifier(const Config&);
+    public:
+      const Config& config() const { return _config; }
+      //  Reset with the configuration written (which resyncs the row
+      //  buffer)
+      void reset();
+      //  One clock: RowSamples samples and RowSize trigger bit pairs
+      void clock(const uint16_t* x, const uint8_t* t, Row& out);
+      //  Stream 3 for the n samples of stream 2, the gate opening at
+      //  super-sample phase of its row.  Returns the words appended to
+      //  out, -1 if n is not a whole number of super-samples or the
+      //  gate never closes.
+      int  stream(const uint16_t* raw, unsigned n, unsigned phase,
+                  std::vector<uint16_t>& out);
+      //  The phase, trying phase first, at which stream() reproduces
+      //  the nfex words of fex; -1 if none does
+      int  match (const uint16_t* raw, unsigned n,
+                  const uint16_t* fex, unsigned nfex, unsigned phase=0);
+    public:
+      //  Bit s of bits is set if a sample of super-sample s is outside
+      //  [lo,hi]; bits holds (nss+63)/64 words
+      static void cross(const uint16_t* x, unsigned nss,
+                        uint16_t lo, uint16_t hi, uint64_t* bits);
+      static Simd::Isa isa   ();
+      static bool      select(Simd::Isa);   // false if unsupported
+    private:
+      void _clock(unsigned mask, const uint16_t* x, const uint8_t* t, Row& out);
+    private:
+      enum State { KeepNone, KeepMid, KeepHead, KeepTail, KeepAll };
+      enum { KeepRows = 3, Keeps = 2*KeepRows+1, RamRows = 16 };
+      class Keep {
+      public:
+        State    state;
+        unsigned first;
+        unsigned last;
+      };
+      Config   _config;
+      //  Registers
+      unsigned _tpreRows, _tpostRows, _tpreCol, _tpostCol;
+      bool     _sync;
+      unsigned _count, _countLast;   // super-samples, 13 bits
+      unsigned _nopen;
+      bool     _lskip;
+      unsigned _tskip;
+      unsigned _waddr, _raddr;
+      unsigned _ikeepf, _ikeepl;
+      bool     _kupdate;
+      unsigned _irowf, _irowl, _icolf, _icoll;
+      Keep     _akeep[Keeps];
+      //  Row buffer and its read register
+      uint16_t _ramx[RamRows][RowSamples];
+      uint8_t  _ramt[RamRows][RowSize];
+      uint16_t _xsave[RowSamples];
+      uint8_t  _tsave[RowSize];
+      //  stream() workspace
+      std::vector<uint16_t> _out;
+      std::vector<uint16_t> _pad;
+      std::vector<uint8_t>  _trig;
+      std::vector<uint64_t> _bits;
+    };
+  };
+};
+
+#endif
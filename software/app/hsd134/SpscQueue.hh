@@ -0,0 +1,57 @@
+#ifndef HSD_SpscQueue_hh
+#define HSD_SpscQueue_hh
+
+#include <stdint.h>
+#include <atomic>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Bounded lock-free queue for one producer thread and one consumer
+    //  thread.  The depth is rounded up to a power of two.
+    //
+    template <class T> class SpscQueue {
+    public:
+      SpscQueue(unsigned depth) : _head(0), _tail(0)
+      {
+        unsigned n = 1;
+        while(n < depth) n <<= 1;
+        _buffer = new T[n];
+        _mask   = n-1;
+      }
+      ~SpscQueue() { delete[] _buffer; }
+    public:
+      //  Producer side
+      bool push(const T& v)
+      {
+        unsigned h = _head.load(std::memory_order_relaxed);
+        if (h - _tail.load(std::memory_order_acquire) > _mask)
+          return false;
+        _buffer[h&_mask] = v;
+        _head.store(h+1, std::memory_order_release);
+        return true;
+      }
+      //  Consumer side
+      bool pop(T& v)
+      {
+        unsigned t = _tail.load(std::memory_order_relaxed);
+        if (t == _head.load(std::memory_order_acquire))
+          return false;
+        v = _buffer[t&_mask];
+        _tail.store(t+1, std::memory_order_release);
+        return true;
+      }
+    public:
+      unsigned depth    () const { return _mask+1; }
+      unsigned occupancy() const
+      { return _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_relaxed); }
+    private:
+      T*       _buffer;
+      unsigned _mask;
+      alignas(64) std::atomic<unsigned> _head;
+      alignas(64) std::atomic<unsigned> _tail;
+    };
+  };
+};
+
+#endif
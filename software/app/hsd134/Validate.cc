@@ -0,0 +1,219 @@
+#include "Validate.hh"
+
+#ifdef HSD_X86
+#include <immintrin.h>
+#endif
+
+using namespace Pds::HSD;
+
+typedef Validate::Result Result;
+
+//
+//  Accumulate the failures of one block.  bits holds a flag per sample
+//  (scalar) or per byte (vector, two per sample).
+//
+static inline void _add(Result& r, unsigned bits, unsigned base, unsigned shift)
+{
+  if (!bits)
+    return;
+  r.errors += __builtin_popcount(bits)>>shift;
+  if (r.first < 0)
+    r.first = base + (__builtin_ctz(bits)>>shift);
+}
+
+//
+//  Scalar kernels, also used for the tails of the vector kernels.
+//  Flags for 32 samples are gathered before they are examined.
+//
+static void _skip_scalar(Result& r, const uint16_t* s, unsigned i, unsigned n)
+{
+  while(i < n) {
+    unsigned bits = 0;
+    unsigned m = n-i < 32 ? n-i : 32;
+    for(unsigned k=0; k<m; k++)
+      bits |= unsigned(s[i+k]>>15)<<k;
+    _add(r, bits, i, 0);
+    i += m;
+  }
+}
+
+static void _ramp_scalar(Result& r, const uint16_t* s, unsigned i, unsigned n,
+                         uint16_t s0, uint16_t mask)
+{
+  while(i < n) {
+    unsigned bits = 0;
+    unsigned m = n-i < 32 ? n-i : 32;
+    for(unsigned k=0; k<m; k++)
+      bits |= unsigned(s[i+k] != ((s0+i+k)&mask))<<k;
+    _add(r, bits, i, 0);
+    i += m;
+  }
+}
+
+static void _range_scalar(Result& r, const uint16_t* s, unsigned i, unsigned n,
+                          uint16_t lo, uint16_t hi)
+{
+  while(i < n) {
+    unsigned bits = 0;
+    unsigned m = n-i < 32 ? n-i : 32;
+    for(unsigned k=0; k<m; k++)
+      bits |= unsigned(s[i+k] < lo || s[i+k] > hi)<<k;
+    _add(r, bits, i, 0);
+    i += m;
+  }
+}
+
+static Result _skip_s(const uint16_t* s, unsigned n)
+{ Result r; _skip_scalar(r, s, 0, n); return r; }
+
+static Result _ramp_s(const uint16_t* s, unsigned n, uint16_t s0, uint16_t mask, unsigned begin)
+{ Result r; _ramp_scalar(r, s, begin, n, s0, mask); return r; }
+
+static Result _range_s(const uint16_t* s, unsigned n, uint16_t lo, uint16_t hi)
+{ Result r; _range_scalar(r, s, 0, n, lo, hi); return r; }
+
+#ifdef HSD_X86
+__attribute__((target("sse4.2")))
+static Result _skip_sse42(const uint16_t* s, unsigned n)
+{
+  Result r;
+  unsigned i=0;
+  for(; i+8<=n; i+=8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s+i));
+    _add(r, _mm_movemask_epi8(_mm_srai_epi16(v, 15)), i, 1);
+  }
+  _skip_scalar(r, s, i, n);
+  return r;
+}
+
+__attribute__((target("sse4.2")))
+static Result _ramp_sse42(const uint16_t* s, unsigned n, uint16_t s0, uint16_t mask, unsigned begin)
+{
+  Result r;
+  unsigned i=begin;
+  const __m128i vmask = _mm_set1_epi16(mask);
+  const __m128i vstep = _mm_set1_epi16(8);
+  __m128i e = _mm_add_epi16(_mm_set1_epi16(s0+begin),
+                            _mm_setr_epi16(0,1,2,3,4,5,6,7));
+  for(; i+8<=n; i+=8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s+i));
+    __m128i q = _mm_cmpeq_epi16(v, _mm_and_si128(e, vmask));
+    _add(r, ~_mm_movemask_epi8(q)&0xffff, i, 1);
+    e = _mm_add_epi16(e, vstep);
+  }
+  _ramp_scalar(r, s, i, n, s0, mask);
+  return r;
+}
+
+__attribute__((target("sse4.2")))
+static Result _range_sse42(const uint16_t* s, unsigned n, uint16_t lo, uint16_t hi)
+{
+  Result r;
+  unsigned i=0;
+  const __m128i vlo = _mm_set1_epi16(lo);
+  const __m128i vhi = _mm_set1_epi16(hi);
+  for(; i+8<=n; i+=8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s+i));
+    __m128i q = _mm_and_si128(_mm_cmpeq_epi16(_mm_max_epu16(v, vlo), v),
+                              _mm_cmpeq_epi16(_mm_min_epu16(v, vhi), v));
+    _add(r, ~_mm_movemask_epi8(q)&0xffff, i, 1);
+  }
+  _range_scalar(r, s, i, n, lo, hi);
+  return r;
+}
+
+__attribute__((target("avx2")))
+static Result _skip_avx2(const uint16_t* s, unsigned n)
+{
+  Result r;
+  unsigned i=0;
+  for(; i+16<=n; i+=16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s+i));
+    _add(r, unsigned(_mm256_movemask_epi8(_mm256_srai_epi16(v, 15))), i, 1);
+  }
+  _skip_scalar(r, s, i, n);
+  return r;
+}
+
+__attribute__((target("avx2")))
+static Result _ramp_avx2(const uint16_t* s, unsigned n, uint16_t s0, uint16_t mask, unsigned begin)
+{
+  Result r;
+  unsigned i=begin;
+  const __m256i vmask = _mm256_set1_epi16(mask);
+  const __m256i vstep = _mm256_set1_epi16(16);
+  __m256i e = _mm256_add_epi16(_mm256_set1_epi16(s0+begin),
+                               _mm256_setr_epi16(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15));
+  for(; i+16<=n; i+=16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s+i));
+    __m256i q = _mm256_cmpeq_epi16(v, _mm256_and_si256(e, vmask));
+    _add(r, ~unsigned(_mm256_movemask_epi8(q)), i, 1);
+    e = _mm256_add_epi16(e, vstep);
+  }
+  _ramp_scalar(r, s, i, n, s0, mask);
+  return r;
+}
+
+__attribute__((target("avx2")))
+static Result _range_avx2(const uint16_t* s, unsigned n, uint16_t lo, uint16_t hi)
+{
+  Result r;
+  unsigned i=0;
+  const __m256i vlo = _mm256_set1_epi16(lo);
+  const __m256i vhi = _mm256_set1_epi16(hi);
+  for(; i+16<=n; i+=16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s+i));
+    __m256i q = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(v, vlo), v),
+                                 _mm256_cmpeq_epi16(_mm256_min_epu16(v, vhi), v));
+    _add(r, ~unsigned(_mm256_movemask_epi8(q)), i, 1);
+  }
+  _range_scalar(r, s, i, n, lo, hi);
+  return r;
+}
+#endif
+
+namespace {
+  class Kernels {
+  public:
+    Result (*skip )(const uint16_t*, unsigned);
+    Result (*ramp )(const uint16_t*, unsigned, uint16_t, uint16_t, unsigned);
+    Result (*range)(const uint16_t*, unsigned, uint16_t, uint16_t);
+  };
+};
+
+static const Kernels _kernels[] = {
+  { _skip_s, _ramp_s, _range_s },
+#ifdef HSD_X86
+  { _skip_sse42, _ramp_sse42, _range_sse42 },
+  { _skip_avx2 , _ramp_avx2 , _range_avx2  },
+#endif
+};
+
+static Simd::Isa _isa = Simd::best();
+
+Result Validate::skip(const uint16_t* s, unsigned n)
+{
+  return _kernels[_isa].skip(s, n);
+}
+
+Result Validate::ramp(const uint16_t* s, unsigned n,
+                      uint16_t s0, uint16_t mask, unsigned begin)
+{
+  return _kernels[_isa].ramp(s, n, s0, mask, begin);
+}
+
+Result Validate::range(const uint16_t* s, unsigned n,
+                       uint16_t lo, uint16_t hi)
+{
+  return _kernels[_isa].range(s, n, lo, hi);
+}
+
+Simd::Isa Validate::isa() { return _isa; }
+
+bool Validate::select(Simd::Isa v)
+{
+  if (!Simd::supported(v))
+    return false;
+  _isa = v;
+  return true;
+}
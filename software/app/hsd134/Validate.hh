@@ -0,0 +1,42 @@
+#ifndef HSD_Validate_hh
+#define HSD_Validate_hh
+
+#include "Simd.hh"
+
+#include <stdint.h>
+
+namespace Pds {
+  namespace HSD {
+    //
+    //  Checks of raw (unsparsified) stream samples.  Each check returns
+    //  the index of the first failing sample and the number of failures
+    //  without branching per sample.
+    //
+    class Validate {
+    public:
+      class Result {
+      public:
+        Result() : first(-1), errors(0) {}
+        bool ok() const { return errors==0; }
+      public:
+        int      first;    // -1 if none
+        unsigned errors;
+      };
+    public:
+      //  Samples with the skip flag (bit 15) set
+      static Result skip (const uint16_t* s, unsigned n);
+      //  Samples that differ from the ramp (s0+i)&mask, checked from
+      //  sample begin onward
+      static Result ramp (const uint16_t* s, unsigned n,
+                          uint16_t s0, uint16_t mask=0x7ff, unsigned begin=0);
+      //  Samples outside [lo,hi]
+      static Result range(const uint16_t* s, unsigned n,
+                          uint16_t lo, uint16_t hi);
+    public:
+      static Simd::Isa isa   ();
+      static bool      select(Simd::Isa);   // false if unsupported
+    };
+  };
+};
+
+#endif
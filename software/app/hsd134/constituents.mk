@@ -1,6 +1,6 @@
 libnames := hsd134
-libsrcs_hsd134 := $(filter-out hsd_init.cc hsd_pgp.cc hsd_sim.cc hsd_valid.cc hsd_xvc.cc hsd_datadev.cc hsd_validate.cc hsd_validate_sim.cc hsd_eyescan.cc hsd_reg.cc hsdRead.cc promload.cc, $(wildcard *.cc))
-libincs_hsd134 := Module134.hh ModuleBase.hh TprCore.hh AxiVersion.h Event.hh Globals.hh DmaDriver.h EnvMon.hh I2cSwitch.hh RegProxy.hh Reg.hh
+libsrcs_hsd134 := $(filter-out hsd_init.cc hsd_pgp.cc hsd_sim.cc hsd_valid.cc hsd_xvc.cc hsd_datadev.cc hsd_validate.cc hsd_validate_sim.cc hsd_eyescan.cc hsd_reg.cc hsdRead.cc hsd_index.cc hsd_decompress_bench.cc hsd_replay_bench.cc hsd_sparsify.cc hsd_corr.cc hsd_regbench.cc hsd_metrics.cc promload.cc, $(wildcard *.cc))
+libincs_hsd134 := Module134.hh ModuleBase.hh TprCore.hh AxiVersion.h BaselineCorr.hh Bringup.hh CalibCache.hh Decompress.hh DmaWait.hh DmaSource.hh DmaGenerator.hh DmaEmulator.hh ReplaySource.hh Event.hh EventIndex.hh Globals.hh Histogram.hh HitFinder.hh DmaDriver.h EnvMon.hh I2cSwitch.hh LatencyMonitor.hh Metrics.hh RegProxy.hh Reg.hh Numa.hh Pipeline.hh RecordFile.hh Recorder.hh SimDump.hh Simd.hh Sparsifier.hh SpscQueue.hh Validate.hh
 
 tgtnames := hsd_init
 tgtsrcs_hsd_init := hsd_init.cc
@@ -12,6 +12,41 @@ tgtsrcs_hsd_reg := hsd_reg.cc Histogram.cc
 tgtlibs_hsd_reg := hsd134
 tgtslib_hsd_reg := rt pthread
 
+tgtnames += hsd_index
+tgtsrcs_hsd_index := hsd_index.cc
+tgtlibs_hsd_index := hsd134
+tgtslib_hsd_index := rt
+
+tgtnames += hsd_decompress_bench
+tgtsrcs_hsd_decompress_bench := hsd_decompress_bench.cc
+tgtlibs_hsd_decompress_bench := hsd134
+tgtslib_hsd_decompress_bench := rt
+
+tgtnames += hsd_replay_bench
+tgtsrcs_hsd_replay_bench := hsd_replay_bench.cc
+tgtlibs_hsd_replay_bench := hsd134
+tgtslib_hsd_replay_bench := rt pthread
+
+tgtnames += hsd_sparsify
+tgtsrcs_hsd_sparsify := hsd_sparsify.cc
+tgtlibs_hsd_sparsify := hsd134
+tgtslib_hsd_sparsify := rt pthread
+
+tgtnames += hsd_corr
+tgtsrcs_hsd_corr := hsd_corr.cc
+tgtlibs_hsd_corr := hsd134
+tgtslib_hsd_corr := rt pthread
+
+tgtnames += hsd_regbench
+tgtsrcs_hsd_regbench := hsd_regbench.cc
+tgtlibs_hsd_regbench := hsd134
+tgtslib_hsd_regbench := rt
+
+tgtnames += hsd_metrics
+tgtsrcs_hsd_metrics := hsd_metrics.cc
+tgtlibs_hsd_metrics := hsd134
+tgtslib_hsd_metrics := rt
+
 #tgtnames += hsd_xvc
 tgtsrcs_hsd_xvc := hsd_xvc.cc
 tgtlibs_hsd_xvc := hsd134
@@ -22,8 +57,9 @@ tgtslib_hsd_xvc := rt pthread
 #tgtlibs_hsd_pgp := hsd
 #tgtslib_hsd_pgp := rt pthread
 
-#tgtnames += hsd_sim
+tgtnames += hsd_sim
 tgtsrcs_hsd_sim := hsd_sim.cc
+tgtlibs_hsd_sim := hsd134
 tgtslib_hsd_sim := rt pthread
 
 tgtnames += hsd_datadev
@@ -2,6 +2,15 @@
 using Pds_Epics::EpicsPVA;
 
 #include "psalg/digitizer/Stream.hh"
+#include "Pipeline.hh"
+#include "Recorder.hh"
+#include "HitFinder.hh"
+#include "Decompress.hh"
+#include "DmaWait.hh"
+#include "DmaSource.hh"
+#include "Numa.hh"
+#include "LatencyMonitor.hh"
+#include "Metrics.hh"
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -18,15 +27,20 @@ using Pds_Epics::EpicsPVA;
 #include <stdint.h>
 #include <new>
 
-FILE*               writeFile           = 0;
+Pds::HSD::Recorder* writeFile           = 0;
+Pds::HSD::Recorder* hitFile             = 0;
 FILE*               summaryFile         = 0;
+Pds::HSD::Metrics*  metrics             = 0;
 
+static volatile bool lstop = false;
+
+//
+//  Only stops the readout: main drains the pipeline and closes the
+//  recorders on its way out.  A second signal ends the process.
+//
 void sigHandler( int signal ) {
-  psignal( signal, "Signal received by pgpWidget");
-  if (writeFile  ) fclose(writeFile);
-  if (summaryFile) fclose(summaryFile);
-  printf("Signal handler pulling the plug\n");
-  ::exit(signal);
+  lstop = true;
+  ::signal( signal, SIG_DFL );
 }
 
 
@@ -75,11 +89,15 @@ private:
 void printUsage(char* name) {
   printf( "Usage: %s [-h]  -P <deviceName> [options]\n"
       "    -h         Show usage\n"
-      "    -P         Set pgpcard device name\n"
+      "    -P         Set pgpcard device name, emu[:options] for the software emulator,\n"
+      "               or replay:<file>[,speed=x,loops=n,preload=1] to replay a recording\n"
       "    -L <lanes> Mask of lanes\n"
       "    -c         number of times to read\n"
       "    -o         Print out up to maxPrint words when reading data\n"
-      "    -f <file>  Record to file\n"
+      "    -f <file>  Record to file (with index <file>.idx)\n"
+      "    -O <policy> Recording overload policy {block,drop,decimate} [Default: block]\n"
+      "    -R <MB[,sec]> Roll over recording files by size and/or time\n"
+      "    -H <file>[,options]  Record the hit lists of the raw streams to file (see HitFinder.hh)\n"
       "    -d <nsec>  Delay given number of nanoseconds per event\n"
       "    -D         Set debug value           [Default: 0]\n"
       "                 bit 00          print out progress\n"
@@ -87,42 +105,163 @@ void printUsage(char* name) {
       "    -r         Report rate\n"
       "    -v <mask>  Validate each event\n"
       "    -E <str>   Push 1Hz waveforms to record <str>\n"
-      "    -I <len>   Interleaved\n",
+      "    -I <len>   Interleaved\n"
+      "    -B <n>     Map DMA buffers and read up to <n> events per syscall\n"
+      "    -T <rx,val,rec,mon,hit>  Pipelined readout (requires -B) with stage cpu cores (-1 = any)\n"
+      "    -m <name>  Export the counters to shared memory segment <name>\n"
+      "    -M         Report trigger to host latency per lane (host clock synchronized to timing)\n"
+      "    -A <prio>  Buffers and threads on the card's NUMA node; reader SCHED_FIFO at prio if >0\n"
+      "    -W <policy[,us]> Wait for events {spin,spinpoll,poll,adaptive} with spin window [Default: adaptive,50]\n",
       name
   );
 }
 
 void* countThread(void*);
 
-static int      count = 0;
-static int64_t  bytes = 0;
-static unsigned lanes = 0;
-static unsigned buffs = 0;
-static unsigned errs  = 0;
-static unsigned polls = 0;
+//
+//  Shared between the reader, the stages and the rate thread
+//
+using Pds::HSD::Metrics;
+static Metrics::Counter  count;
+static Metrics::Counter  bytes;
+static Metrics::Counter  errs;
+static Metrics::Counter  polls;
+static Metrics::Counter  laneEvents[8];
+static Metrics::Gauge    lanes;     // seen since the last report
+static Metrics::Gauge    buffs;
+static ::HSD::Histogram* readSize = 0;   // bytes per event
+static Pds::HSD::DmaWait* waiter = 0;
+static Pds::HSD::DmaSource* source = 0;
+
+//
+//  Latency measurement points
+//
+static Pds::HSD::LatencyMonitor* latency = 0;
+static unsigned lat_rx, lat_validate, lat_record, lat_processed;
+
+static void latency_record(unsigned point, const uint32_t* data, unsigned dest)
+{
+  if (latency)
+    latency->record(point, (dest>>5)&7, data);
+}
+
+//
+//  Event processing configuration
+//
+static bool                print      = false;
+static int                 numb       = 0;
+static unsigned            maxPrint   = 1024;
+static unsigned            lvalidate  = 0;
+static const char*         pv         = 0;
+static IlvBuilder*         ilv        = 0;
+static EpicsPVA*           pvraw      = 0;
+static EpicsPVA*           pvfex      = 0;
+static Pds::HSD::HitFinder* hitFinder = 0;
+
+static void process_event (uint32_t* data, unsigned size, unsigned dest, unsigned error);
+static void validate_event(uint32_t* data, unsigned size, unsigned dest, unsigned error);
+static void record_event  (const uint32_t* data, unsigned size, unsigned dest);
+static void record_hits   (const uint32_t* data, unsigned size, unsigned dest);
+static bool publish_accept(const uint32_t* data, unsigned dest);
+static void publish_event (uint32_t* data);
+
+using Pds::HSD::Pipeline;
+
+class ValidateStage : public Pipeline::Stage {
+public:
+  ValidateStage() : Pipeline::Stage("validate") {}
+public:
+  void process(const Pipeline::Event& ev)
+  { validate_event(ev.data, ev.size, ev.dest, ev.error);
+    latency_record(lat_validate, ev.data, ev.dest); }
+};
+
+class RecordStage : public Pipeline::Stage {
+public:
+  RecordStage() : Pipeline::Stage("record") {}
+public:
+  void process(const Pipeline::Event& ev)
+  { record_event(ev.data, ev.size, ev.dest);
+    latency_record(lat_record, ev.data, ev.dest); }
+};
+
+class HitStage : public Pipeline::Stage {
+public:
+  HitStage() : Pipeline::Stage("hits") {}
+public:
+  void process(const Pipeline::Event& ev)
+  { record_hits(ev.data, ev.size, ev.dest); }
+};
+
+class MonitorStage : public Pipeline::Stage {
+public:
+  MonitorStage() : Pipeline::Stage("monitor",true) {}
+public:
+  bool accept (const Pipeline::Event& ev) { return publish_accept(ev.data, ev.dest); }
+  void process(const Pipeline::Event& ev) { publish_event(ev.data); }
+};
+
+static Pipeline* pipeline = 0;
+
+static void release_buffers(void* arg, uint32_t* indices, unsigned n)
+{
+  reinterpret_cast<Pds::HSD::DmaSource*>(arg)->release(n, indices);
+}
 
 int main (int argc, char **argv) {
-  int           fd;
-  int           numb;
-  bool          print = false;
   const char*         dev = "/dev/pgpdaq0";
   unsigned            client              = 0;
-  unsigned            maxPrint            = 1024;
   unsigned            debug               = 0;
   unsigned            nevents             = unsigned(-1);
   unsigned            delay               = 0;
-  unsigned            lvalidate           = 0;
+  unsigned            nbulk               = 0;
+  const char*         writeName           = 0;
+  const char*         hitName             = 0;
+  Pds::HSD::Recorder::Policy writePolicy  = Pds::HSD::Recorder::Block;
+  unsigned            rollMB              = 0;
+  unsigned            rollSec             = 0;
+  int                 cores[5]            = { -1, -1, -1, -1, -1 };
+  bool                lpipeline           = false;
+  Pds::HSD::DmaWait::Policy waitPolicy    = Pds::HSD::DmaWait::Adaptive;
+  unsigned            waitSpinUs          = 50;
+  bool                lnuma               = false;
+  const char*         metricsName         = 0;
+  int                 fifoPriority        = 0;
   bool                reportRate          = false;
   unsigned            lanem               = 0;
-  const char*         pv                  = 0;
-  IlvBuilder*         ilv                 = 0;
   ::signal( SIGINT, sigHandler );
 
   //  char*               endptr;
   extern char*        optarg;
   int c;
-  while( ( c = getopt( argc, argv, "hI:P:L:d:D:c:f:F:N:o:rv:E:" ) ) != EOF ) {
+  while( ( c = getopt( argc, argv, "hA:B:m:MI:P:L:d:D:c:f:F:H:N:o:O:rR:T:v:E:W:" ) ) != EOF ) {
     switch(c) {
+    case 'A':
+      lnuma = true;
+      fifoPriority = strtol(optarg,NULL,0);
+      break;
+    case 'm':
+      metricsName = optarg;
+      break;
+    case 'M':
+      latency = new Pds::HSD::LatencyMonitor;
+      lat_rx        = latency->point("receive");
+      lat_validate  = latency->point("validate");
+      lat_record    = latency->point("record");
+      lat_processed = latency->point("processed");
+      break;
+    case 'B':
+      nbulk = strtoul(optarg,NULL,0);
+      break;
+    case 'T':
+      { char* endptr = optarg;
+        for(unsigned i=0; i<5; i++) {
+          cores[i] = strtol(endptr,&endptr,0);
+          if (*endptr!=',') break;
+          endptr++;
+        }
+        lpipeline = true; }
+      break;
     case 'I':
       ilv = new IlvBuilder(strtoul(optarg,NULL,0));
       break;
@@ -146,11 +285,36 @@ int main (int argc, char **argv) {
       numb = strtoul(optarg  ,NULL,0);
       break;
     case 'f':
-      if (!(writeFile = fopen(optarg,"w"))) {
-        perror("Opening save file");
+      writeName = optarg;
+      break;
+    case 'H':
+      hitName = optarg;
+      break;
+    case 'O':
+      if (!Pds::HSD::Recorder::policy(optarg, writePolicy)) {
+        printf("Unknown overload policy %s\n", optarg);
+        printUsage(argv[0]);
         return -1;
       }
       break;
+    case 'R':
+      { char* endptr;
+        rollMB = strtoul(optarg,&endptr,0);
+        if (*endptr==',')
+          rollSec = strtoul(endptr+1,NULL,0); }
+      break;
+    case 'W':
+      { char* endptr = strchr(optarg,',');
+        if (endptr) {
+          *endptr++ = 0;
+          waitSpinUs = strtoul(endptr,NULL,0);
+        }
+        if (!Pds::HSD::DmaWait::policy(optarg, waitPolicy)) {
+          printf("Unknown wait policy %s\n", optarg);
+          printUsage(argv[0]);
+          return -1;
+        } }
+      break;
     case 'F':
       if (!(summaryFile = fopen(optarg,"w"))) {
         perror("Opening summary file");
@@ -182,9 +346,57 @@ int main (int argc, char **argv) {
     }
   }
 
-  char cdev[64];
-  sprintf(cdev,"%s_%u",dev,client);
-  if ( (fd = open(cdev, O_RDWR)) <= 0 ) {
+  //  The software sources are named as is, the device by client
+  char cdev[256];
+  if (strncmp(dev,"emu",3)==0 || strncmp(dev,"replay:",7)==0)
+    snprintf(cdev,sizeof(cdev),"%s",dev);
+  else
+    snprintf(cdev,sizeof(cdev),"%s_%u",dev,client);
+  //
+  //  Keep the reader and its helper threads (created below, inheriting
+  //  the affinity) on the card's node
+  //
+  int node = -1;
+  if (lnuma) {
+    node = Pds::HSD::Numa::node(cdev);
+    std::vector<int> cpus = Pds::HSD::Numa::cpus(node);
+    printf("%s on NUMA node %d [%zu cpus]\n", cdev, node, cpus.size());
+    Pds::HSD::Numa::pin(cpus);
+  }
+
+  if (writeName) {
+    writeFile = new Pds::HSD::Recorder(writeName, 8<<20, 3, writePolicy,
+                                       uint64_t(rollMB)<<20, rollSec);
+    writeFile->index(true);
+    if (!writeFile->open()) {
+      perror("Opening save file");
+      return -1;
+    }
+  }
+
+  if (hitName) {
+    //  <file>[,options]
+    std::string name(hitName);
+    Pds::HSD::HitFinder::Config cfg;
+    size_t o = name.find(',');
+    if (o != std::string::npos) {
+      if (!cfg.parse(name.c_str()+o+1)) {
+        printUsage(argv[0]);
+        return -1;
+      }
+      name.resize(o);
+    }
+    hitFinder = new Pds::HSD::HitFinder(cfg);
+    hitFile   = new Pds::HSD::Recorder(name.c_str(), 8<<20, 3, writePolicy,
+                                       uint64_t(rollMB)<<20, rollSec);
+    hitFile->index(true);
+    if (!hitFile->open()) {
+      perror("Opening hit file");
+      return -1;
+    }
+  }
+
+  if ( !(source = Pds::HSD::DmaSource::open(cdev)) ) {
     std::cout << "Error opening " << cdev << std::endl;
     return(1);
   }
@@ -192,8 +404,8 @@ int main (int argc, char **argv) {
   //
   //  Map the lanes to this reader
   //
-  {
-    PgpDaq::PgpCard* p = (PgpDaq::PgpCard*)mmap(NULL, sizeof(PgpDaq::PgpCard), (PROT_READ|PROT_WRITE), (MAP_SHARED|MAP_LOCKED), fd, 0);
+  if (source->device()) {
+    PgpDaq::PgpCard* p = (PgpDaq::PgpCard*)mmap(NULL, sizeof(PgpDaq::PgpCard), (PROT_READ|PROT_WRITE), (MAP_SHARED|MAP_LOCKED), source->fd(), 0);
     uint32_t MAX_LANES = p->nlanes();
     for(unsigned i=0; i<MAX_LANES; i++)
       if (lanem & (1<<i)) {
@@ -204,18 +416,39 @@ int main (int argc, char **argv) {
   }
 
 
-  EpicsPVA* pvraw=0;
-  EpicsPVA* pvfex=0;
   if (pv) {
     std::string pvbase(pv);
     pvraw = new EpicsPVA((pvbase+":RAWDATA").c_str());
     pvfex = new EpicsPVA((pvbase+":FEXDATA").c_str());
   }
 
-  // Allocate a buffer
-  uint32_t* data  = new uint32_t[0x80000];
-  struct DmaReadData rd;
-  rd.data  = reinterpret_cast<uintptr_t>(data);
+  if (lpipeline && !nbulk) {
+    printf("Pipelined readout requires -B\n");
+    return -1;
+  }
+
+  //  Created once the options and the device are good, so that an
+  //  early return leaves no segment behind
+  metrics = new Metrics(metricsName);
+  count = metrics->counter("events");
+  bytes = metrics->counter("bytes");
+  errs  = metrics->counter("errors");
+  polls = metrics->counter("reads");
+  for(unsigned i=0; i<8; i++)
+    laneEvents[i] = metrics->counter("events", i);
+  lanes = metrics->gauge("lanes");
+  buffs = metrics->gauge("buffers");
+  readSize = new ::HSD::Histogram(24, 1., 4);
+  metrics->histogram("read_bytes", readSize);
+
+  waiter = new Pds::HSD::DmaWait(source->fd(), waitPolicy, waitSpinUs);
+  metrics->histogram("wakeup_ns", waiter->wakeHist);
+  //  Per interval: published before the report clears them
+  if (latency)
+    for(unsigned i=0; i<latency->points(); i++)
+      for(unsigned j=0; j<Pds::HSD::LatencyMonitor::MaxLanes; j++)
+        metrics->histogram((std::string("latency_")+latency->name(i)).c_str(),
+                           latency->histogram(i,j), j);
 
   pthread_attr_t tattr;
   pthread_attr_init(&tattr);
@@ -226,210 +459,425 @@ int main (int argc, char **argv) {
   }
 
   RawStream::verbose( (lvalidate>>28)&7 );
-  const Pds::HSD::EventHeader* event = reinterpret_cast<const Pds::HSD::EventHeader*>(data);
-  RawStream* raw = 0;
-
-  unsigned nextCount[8];
-  uint64_t ppulseId =0, dpulseId =0;
-  memset(nextCount,0,sizeof(nextCount));
 
-  unsigned tsec=0;
-
-  // DMA Read
-  while(1) {
-    bool lerr = false;
-
-    rd.index = 0;
-    ssize_t ret = read(fd, &rd, sizeof(rd));
-    if (ret < 0) {
-      perror("Reading buffer");
-      break;
+  uint32_t* data = 0;
+  bool      lnumaData = false;   // data from Numa::allocate
+
+  timespec tstart;
+  clock_gettime(CLOCK_MONOTONIC, &tstart);
+
+  if (nbulk) {
+    //
+    //  Process the events in place in the mapped DMA buffers
+    //
+    uint32_t dmaCount, dmaSize;
+    void**   dmaBuffers = source->map(&dmaCount,&dmaSize);
+    if (!dmaBuffers) {
+      perror("Failed to map dma buffers");
+      return -1;
     }
-
-    polls++;
-
-    if (!rd.size) {
-      continue;
+    printf("Mapped %u dma buffers of size 0x%x\n", dmaCount, dmaSize);
+
+    if (lpipeline) {
+      pipeline = new Pipeline(dmaCount, dmaCount, release_buffers, source);
+      pipeline->add(new ValidateStage, cores[1]);
+      if (writeFile || summaryFile)
+        pipeline->add(new RecordStage, cores[2]);
+      if (pv)
+        pipeline->add(new MonitorStage, cores[3]);
+      if (hitFile)
+        pipeline->add(new HitStage, cores[4]);
+      Pipeline::affinity(cores[0]);
+      pipeline->start();
     }
 
-    if (nevents-- == 0)
-      break;
-
-    unsigned lane   = (rd.dest>>5)&7;
+    if (lnuma && fifoPriority > 0)
+      Pds::HSD::Numa::realtime(fifoPriority);
 
-    if (print || event->eventType()) {
+    int32_t*  dmaRet   = new int32_t [nbulk];
+    uint32_t* dmaIndex = new uint32_t[nbulk];
+    uint32_t* rxFlags  = new uint32_t[nbulk];
+    uint32_t* rxErrors = new uint32_t[nbulk];
+    uint32_t* rxDest   = new uint32_t[nbulk];
 
-      event->dump();
+    bool ldone = false;
+    while(!ldone && !lstop) {
+      if (!waiter->wait())
+        break;
 
-      for (unsigned x=0; x<maxPrint; x++) {
-        printf("%08x%c", data[x], (x%8)==7 ? '\n':' ');
+      ssize_t bret = source->readBulk(nbulk, dmaRet, dmaIndex, rxFlags, rxErrors, rxDest);
+      if (bret < 0) {
+        perror("Reading buffers");
+        break;
       }
-      if (maxPrint%8)
-        printf("\n");
 
-      if (count >= numb)
-        print = false;
-    }
-    bytes += rd.size;
-
-    if (lvalidate) {
-      if (lvalidate&1) {
-        //  Check that pulseId increments by a constant
-        uint64_t pulseId = (uint64_t(data[1])<<32) | data[0];
-        if (ppulseId) {
-          if (dpulseId > 100 && pulseId != (ppulseId+dpulseId))
-            printf("\tPulseId = %016llx [%016llx, %016llx]\n",
-                   (unsigned long long)pulseId,
-                   (unsigned long long)(pulseId+dpulseId),
-                   (unsigned long long)(pulseId-ppulseId));
-          dpulseId = pulseId - ppulseId;
+      polls.add();
+      waiter->read(bret);
+
+      if (!bret && source->finished())
+        break;
+
+      ssize_t i;
+      for(i=0; i<bret && !ldone; i++) {
+        if (nevents-- == 0) {
+          ldone = true;
+          break;
         }
-        ppulseId = pulseId;
-      }
-      if (lvalidate&2) {
-        //  Check that analysis count increments by one
-        //        unsigned count = data[5];
-        unsigned count = data[4];
-        if (nextCount[lane] && (count != nextCount[lane])) {
-          lerr = true;
-          if (errs < 100)
-            printf("\tanalysisCount = %08x [%08x] lane %u  delta %d\n",
-                   count, nextCount[lane], lane, count-nextCount[lane]);
+        latency_record(lat_rx, reinterpret_cast<uint32_t*>(dmaBuffers[dmaIndex[i]]), rxDest[i]);
+        if (pipeline) {
+          Pipeline::Event ev;
+          ev.data  = reinterpret_cast<uint32_t*>(dmaBuffers[dmaIndex[i]]);
+          ev.size  = dmaRet  [i];
+          ev.dest  = rxDest  [i];
+          ev.error = rxErrors[i];
+          ev.index = dmaIndex[i];
+          pipeline->dispatch(ev);
         }
-        nextCount[lane] = (count+1)&0x00ffffff;
-      }
-
-      if (event->eventType()==0) {
-        const StreamHeader& rhdr = *reinterpret_cast<const StreamHeader*>(event+1);
-        if (rhdr.strmtype()==0 && (lvalidate&4)) {
-          //  Check that the raw payload for the test pattern is in lock step
-          if (!raw)
-            raw = new RawStream(*event, rhdr);
-          else
-            lerr |= !raw->validate(*event, rhdr);
+        else {
+          process_event(reinterpret_cast<uint32_t*>(dmaBuffers[dmaIndex[i]]),
+                        dmaRet[i], rxDest[i], rxErrors[i]);
+          latency_record(lat_processed, reinterpret_cast<uint32_t*>(dmaBuffers[dmaIndex[i]]), rxDest[i]);
         }
-        if (rhdr.strmtype()==0 && (lvalidate&8)) {
-          //  Check that the fex payload matches the raw payload
-          const StreamHeader* thdr = reinterpret_cast<const StreamHeader*>(event+1);
-          for(unsigned i=1; i<event->streams(); i++) {
-            if (thdr->strmtype()==1) {
-              ThrStream tstr(*thdr);
-              lerr |= !tstr.validate(rhdr);
-              break;
-            }
-          }
+        if (delay) {
+          timespec tv = { .tv_sec=0, .tv_nsec=delay };
+          while( nanosleep(&tv, &tv) )
+            ;
         }
       }
+
+      if (pipeline) {
+        //  Buffers past the last event wanted were never dispatched
+        if (i < bret)
+          source->release(bret-i, dmaIndex+i);
+        pipeline->reclaim();
+      }
+      else if (bret > 0)
+        source->release(bret, dmaIndex);
     }
 
-    lanes |= 1<<lane;
+    if (pipeline) {
+      //  Stop dispatching; the stages drain what they already hold
+      pipeline->stop();
+      pipeline->dump();
+    }
 
-    { unsigned buff = data[9]>>16;
-      buffs |= (1<<buff); }
+    delete[] dmaRet;
+    delete[] dmaIndex;
+    delete[] rxFlags;
+    delete[] rxErrors;
+    delete[] rxDest;
+    source->unmap(dmaBuffers);
+  }
+  else {
+    // Allocate a buffer
+    if (lnuma) {
+      data = reinterpret_cast<uint32_t*>(Pds::HSD::Numa::allocate(0x80000*sizeof(uint32_t), node));
+      if (!data)
+        printf("Buffer not allocated on the node; using the heap\n");
+    }
+    lnumaData = data != 0;
+    if (!data)
+      data = new uint32_t[0x80000];
+    if (lnuma && fifoPriority > 0)
+      Pds::HSD::Numa::realtime(fifoPriority);
+    uint32_t rxDest, rxError;
+
+    // DMA Read
+    while(!lstop) {
+      if (!waiter->wait())
+        break;
+
+      ssize_t size = source->read(data, 0x80000*sizeof(uint32_t), 0, &rxError, &rxDest);
+      if (size < 0) {
+        perror("Reading buffer");
+        break;
+      }
 
-    //  Check for pgp errors
-    lerr |= rd.error;
+      polls.add();
+      waiter->read(size ? 1 : 0);
 
-    ++count;
-    if (lerr) {
-      if (++errs > 20) {
-        RawStream::verbose(0);
+      if (!size) {
+        if (source->finished())
+          break;
+        continue;
       }
-      if (lvalidate&(1<<31))
-        event->dump();
-    }
 
-    if (ilv)
-      ilv->next(reinterpret_cast<const char*>(data),rd.size,lane);
+      if (nevents-- == 0)
+        break;
 
-    if (writeFile) {
-      data[6] |= (lane<<20);  // write the lane into the event header
-      fwrite(data,rd.size,1,writeFile);
-    }
+      latency_record(lat_rx, data, rxDest);
+      process_event(data, size, rxDest, rxError);
+      latency_record(lat_processed, data, rxDest);
 
-    if (summaryFile) {
-      fwrite(event,sizeof(*event),1,summaryFile);
+      if (delay) {
+        timespec tv = { .tv_sec=0, .tv_nsec=delay };
+        while( nanosleep(&tv, &tv) )
+          ;
+      }
     }
+  }
+  lstop = true;
+  if (reportRate)
+    pthread_join(thr,NULL);
+
+  { timespec tend;
+    clock_gettime(CLOCK_MONOTONIC, &tend);
+    double dt = double(tend.tv_sec - tstart.tv_sec) + 1.e-9*(double(tend.tv_nsec)-double(tstart.tv_nsec));
+    printf("Read %llu events  %lld bytes  in %.3f s :  %.1f events/s  %.2f MB/s\n",
+           (unsigned long long)count.value(), (long long)bytes.value(), dt,
+           dt > 0 ? double(count.value())/dt : 0.,
+           dt > 0 ? double(bytes.value())/dt*1.e-6 : 0.); }
+
+  if (writeFile) {
+    writeFile->close();
+    writeFile->dump();
+  }
+
+  if (hitFile) {
+    hitFile->close();
+    hitFile->dump();
+    printf("Hits: %llu pulses  %llu over the per stream limit\n",
+           (unsigned long long)hitFinder->pulses,
+           (unsigned long long)hitFinder->truncated);
+  }
+
+  if (summaryFile)
+    fclose(summaryFile);
 
-    if (pv && tsec != data[3] && lane==0) {
-      tsec = data[3];
+  if (lnumaData)
+    Pds::HSD::Numa::release(data, 0x80000*sizeof(uint32_t));
+  else
+    delete[] data;
+  delete metrics;
+  //  sleep(5);
+  //  close(fd);
+  return 0;
+}
 
-      Pds::HSD::EventHeader& evhdr = *reinterpret_cast<Pds::HSD::EventHeader*>(data);
+void process_event(uint32_t* data, unsigned size, unsigned dest, unsigned error)
+{
+  validate_event(data, size, dest, error);
+  record_event  (data, size, dest);
+  record_hits   (data, size, dest);
+  if (publish_accept(data, dest))
+    publish_event(data);
+}
 
-      Pds::HSD::StreamHeader& rawhdr = *new(&evhdr+1) Pds::HSD::StreamHeader;
+void validate_event(uint32_t* data, unsigned size, unsigned dest, unsigned error)
+{
+  static RawStream* raw = 0;
+  static unsigned nextCount[8];
+  static uint64_t ppulseId =0, dpulseId =0;
 
-      const uint16_t* raw = reinterpret_cast<const uint16_t*>(&rawhdr+1) + rawhdr.boffs();
-      pvd::shared_vector<const unsigned> pvrawvecin;
-      pvraw->getVectorAs(pvrawvecin);
-      pvd::shared_vector<unsigned> pvrawvecout(thaw(pvrawvecin));
-      for(unsigned i=0; i<rawhdr.samples() && i<pvraw->nelem(); i++)
-        pvrawvecout[i] = raw[i];
-      pvraw->putFromVector(freeze(pvrawvecout));
+  bool lerr = false;
 
-      void* next = const_cast<uint16_t*>(&raw[rawhdr.samples()]);
+  const Pds::HSD::EventHeader* event = reinterpret_cast<const Pds::HSD::EventHeader*>(data);
 
-      Pds::HSD::StreamHeader& fexhdr = *new(next) Pds::HSD::StreamHeader;
+  unsigned lane   = (dest>>5)&7;
 
-      const uint16_t* fex = reinterpret_cast<const uint16_t*>(&fexhdr+1) + fexhdr.boffs();
-      int nskip=0;
-      pvd::shared_vector<const unsigned> pvfexvecin;
-      pvfex->getVectorAs(pvfexvecin);
-      pvd::shared_vector<unsigned> pvfexvecout(thaw(pvfexvecin));
-      for(unsigned i=0; i<fexhdr.samples() && i<pvfex->nelem(); i++) {
-        if (nskip) {
-          pvfexvecout[i] = 0x200;
-          nskip--;
-        }
-        else {
-          if (fex[i]&0x8000) {
-            nskip = fex[i]&0x7fff;
-            pvfexvecout[i] = 0x200;
+  if (print || event->eventType()) {
+
+    event->dump();
+
+    for (unsigned x=0; x<maxPrint; x++) {
+      printf("%08x%c", data[x], (x%8)==7 ? '\n':' ');
+    }
+    if (maxPrint%8)
+      printf("\n");
+
+    if (count.value() >= numb)
+      print = false;
+  }
+  bytes.add(size);
+  readSize->bump(size);
+
+  if (lvalidate) {
+    if (lvalidate&1) {
+      //  Check that pulseId increments by a constant
+      uint64_t pulseId = (uint64_t(data[1])<<32) | data[0];
+      if (ppulseId) {
+        if (dpulseId > 100 && pulseId != (ppulseId+dpulseId))
+          printf("\tPulseId = %016llx [%016llx, %016llx]\n",
+                 (unsigned long long)pulseId,
+                 (unsigned long long)(pulseId+dpulseId),
+                 (unsigned long long)(pulseId-ppulseId));
+        dpulseId = pulseId - ppulseId;
+      }
+      ppulseId = pulseId;
+    }
+    if (lvalidate&2) {
+      //  Check that analysis count increments by one
+      //        unsigned count = data[5];
+      unsigned count = data[4];
+      if (nextCount[lane] && (count != nextCount[lane])) {
+        lerr = true;
+        if (errs.value() < 100)
+          printf("\tanalysisCount = %08x [%08x] lane %u  delta %d\n",
+                 count, nextCount[lane], lane, count-nextCount[lane]);
+      }
+      nextCount[lane] = (count+1)&0x00ffffff;
+    }
+
+    if (event->eventType()==0) {
+      const StreamHeader& rhdr = *reinterpret_cast<const StreamHeader*>(event+1);
+      if (rhdr.strmtype()==0 && (lvalidate&4)) {
+        //  Check that the raw payload for the test pattern is in lock step
+        if (!raw)
+          raw = new RawStream(*event, rhdr);
+        else
+          lerr |= !raw->validate(*event, rhdr);
+      }
+      if (rhdr.strmtype()==0 && (lvalidate&8)) {
+        //  Check that the fex payload matches the raw payload
+        const StreamHeader* thdr = reinterpret_cast<const StreamHeader*>(event+1);
+        for(unsigned i=1; i<event->streams(); i++) {
+          if (thdr->strmtype()==1) {
+            ThrStream tstr(*thdr);
+            lerr |= !tstr.validate(rhdr);
+            break;
           }
-          else
-            pvfexvecout[i] = fex[i];
         }
       }
-      pvfex->putFromVector(freeze(pvfexvecout));
     }
+  }
 
-    if (delay) {
-      timespec tv = { .tv_sec=0, .tv_nsec=delay };
-      while( nanosleep(&tv, &tv) )
-        ;
+  lanes.mask(1<<lane);
+  laneEvents[lane].add();
+
+  { unsigned buff = data[9]>>16;
+    buffs.mask(1<<buff); }
+
+  //  Check for pgp errors
+  lerr |= error;
+
+  count.add();
+  if (lerr) {
+    errs.add();
+    if (errs.value() > 20) {
+      RawStream::verbose(0);
     }
+    if (lvalidate&(1<<31))
+      event->dump();
   }
-  count = -1;
 
-  if (reportRate)
-    pthread_join(thr,NULL);
-  free(data);
-  //  sleep(5);
-  //  close(fd);
-  return 0;
+  if (ilv)
+    ilv->next(reinterpret_cast<const char*>(data),size,lane);
+
+}
+
+void record_event(const uint32_t* data, unsigned size, unsigned dest)
+{
+  unsigned lane   = (dest>>5)&7;
+
+  if (writeFile && size >= 32) {
+    //  write the lane into a copy of the event header
+    //  leaving the DMA buffer untouched for the other stages
+    uint32_t hdr[8];
+    memcpy(hdr, data, sizeof(hdr));
+    hdr[6] |= (lane<<20);
+    Pds::HSD::IndexEntry entry;
+    entry.fill(data, size);
+    entry.lane = lane;
+    writeFile->write(hdr, sizeof(hdr), data+8, size-sizeof(hdr), &entry);
+  }
+
+  if (summaryFile) {
+    fwrite(data,sizeof(Pds::HSD::EventHeader),1,summaryFile);
+  }
+}
+
+//
+//  The event reduced to the hit lists of its raw streams
+//
+void record_hits(const uint32_t* data, unsigned size, unsigned dest)
+{
+  static std::vector<uint16_t> hits;
+
+  if (!hitFile)
+    return;
+
+  unsigned len = hitFinder->encode(data, size, hits);
+  if (!len)
+    return;
+  const uint32_t* p = reinterpret_cast<const uint32_t*>(hits.data());
+  Pds::HSD::IndexEntry entry;
+  entry.fill(p, len);
+  entry.lane = (dest>>5)&7;
+  hitFile->write(p, sizeof(Pds::HSD::EventHeader),
+                 p+8, len-sizeof(Pds::HSD::EventHeader), &entry);
+}
+
+bool publish_accept(const uint32_t* data, unsigned dest)
+{
+  static unsigned tsec=0;
+
+  unsigned lane   = (dest>>5)&7;
+  if (pv && tsec != data[3] && lane==0) {
+    tsec = data[3];
+    return true;
+  }
+  return false;
+}
+
+void publish_event(uint32_t* data)
+{
+  {
+    Pds::HSD::EventHeader& evhdr = *reinterpret_cast<Pds::HSD::EventHeader*>(data);
+
+    Pds::HSD::StreamHeader& rawhdr = *new(&evhdr+1) Pds::HSD::StreamHeader;
+
+    const uint16_t* raw = reinterpret_cast<const uint16_t*>(&rawhdr+1) + rawhdr.boffs();
+    pvd::shared_vector<const unsigned> pvrawvecin;
+    pvraw->getVectorAs(pvrawvecin);
+    pvd::shared_vector<unsigned> pvrawvecout(thaw(pvrawvecin));
+    for(unsigned i=0; i<rawhdr.samples() && i<pvraw->nelem(); i++)
+      pvrawvecout[i] = raw[i];
+    pvraw->putFromVector(freeze(pvrawvecout));
+
+    void* next = const_cast<uint16_t*>(&raw[rawhdr.samples()]);
+
+    Pds::HSD::StreamHeader& fexhdr = *new(next) Pds::HSD::StreamHeader;
+
+    const uint16_t* fex = reinterpret_cast<const uint16_t*>(&fexhdr+1) + fexhdr.boffs();
+    static std::vector<uint16_t> expanded;
+    expanded.resize(pvfex->nelem());
+    int nexp = Pds::HSD::Decompress::run(fex, fexhdr.samples(),
+                                         expanded.data(), expanded.size(),
+                                         0x200);
+    if (nexp < 0)
+      nexp = expanded.size();
+    pvd::shared_vector<const unsigned> pvfexvecin;
+    pvfex->getVectorAs(pvfexvecin);
+    pvd::shared_vector<unsigned> pvfexvecout(thaw(pvfexvecin));
+    for(unsigned i=0; i<pvfex->nelem(); i++)
+      pvfexvecout[i] = i < unsigned(nexp) ? expanded[i] : 0x200;
+    pvfex->putFromVector(freeze(pvfexvecout));
+  }
 }
 
 void* countThread(void* args)
 {
   timespec tv;
   clock_gettime(CLOCK_REALTIME,&tv);
-  unsigned opolls = polls;
-  unsigned ocount = count;
-  int64_t  obytes = bytes;
+  unsigned opolls = polls.value();
+  unsigned ocount = count.value();
+  int64_t  obytes = bytes.value();
   while(1) {
     usleep(1000000);
     timespec otv = tv;
     clock_gettime(CLOCK_REALTIME,&tv);
-    unsigned npolls = polls;
-    unsigned ncount = count;
-    int64_t  nbytes = bytes;
+    unsigned npolls = polls.value();
+    unsigned ncount = count.value();
+    int64_t  nbytes = bytes.value();
 
     double dt     = double( tv.tv_sec - otv.tv_sec) + 1.e-9*(double(tv.tv_nsec)-double(otv.tv_nsec));
     double prate  = double(npolls-opolls)/dt;
+    double epoll  = (npolls==opolls) ? 0 : double(ncount-ocount)/double(npolls-opolls);
     double rate   = double(ncount-ocount)/dt;
     double dbytes = double(nbytes-obytes)/dt;
     unsigned dbsc = 0, rsc=0, prsc=0;
 
-    if (count < 0) break;
+    if (lstop) break;
 
     static const char scchar[] = { ' ', 'k', 'M' };
 
@@ -460,12 +908,24 @@ void* countThread(void* args)
       dbytes *= 1.e-3;
     }
 
-    printf("Rate %7.2f %cHz [%u]:  Size %7.2f %cBps [%lld B]  lanes %02x  buffs %04x  errs %04x : polls %7.2f %cHz\n",
+    printf("Rate %7.2f %cHz [%u]:  Size %7.2f %cBps [%lld B]  lanes %02x  buffs %04x  errs %04x : polls %7.2f %cHz  evts/read %5.2f\n",
            rate  , scchar[rsc ], ncount,
-           dbytes, scchar[dbsc], (long long)nbytes, lanes, buffs, errs,
-           prate , scchar[prsc]);
-    lanes = 0;
-    buffs = 0;
+           dbytes, scchar[dbsc], (long long)nbytes,
+           unsigned(lanes.take()), unsigned(buffs.take()), unsigned(errs.value()),
+           prate , scchar[prsc], epoll);
+
+    metrics->publish();
+    if (waiter)
+      waiter->dump();
+    source->dump();
+    if (latency)
+      latency->dump();
+    if (pipeline)
+      pipeline->dump();
+    if (writeFile)
+      writeFile->dump();
+    if (hitFile)
+      hitFile->dump();
 
     opolls = npolls;
     ocount = ncount;
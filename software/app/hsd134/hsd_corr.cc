@@ -0,0 +1,309 @@
+/**
+ **  Baseline correction model: write stimulus and expected output for
+ **  the hsd_fex_corr_sim target, or verify the corrected samples of a
+ **  recording against its raw interleave
+ **/
+
+#include "BaselineCorr.hh"
+#include "RecordFile.hh"
+#include "Decompress.hh"
+#include "Event.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+using Pds::HSD::BaselineCorr;
+using Pds::HSD::RecordFile;
+using Pds::HSD::Decompress;
+using Pds::HSD::EventHeader;
+using Pds::HSD::StreamHeader;
+using Pds::HSD::StreamIndex;
+using Pds::HSD::Simd;
+
+void usage(const char* p) {
+  printf("Usage: %s [options]\n",p);
+  printf("Options: -a <accShift>     running sum of 2^accShift samples per lane [Default: 12]\n");
+  printf("         -B <baseline>     output baseline [Default: 0x4000]\n");
+  printf("         -s <isa>          scalar, sse4.2 or avx2 [Default: best supported]\n");
+  printf("Stimulus: -o <dir>         write <dir>/adcin.dat and the expected <dir>/adcout.dat\n");
+  printf("         -n <rows>         [Default: 1000]\n");
+  printf("         -l <l0,l1,l2,l3>  input level of each lane [Default: 0x7ff,0x800,0x801,0x802]\n");
+  printf("         -r <noise>        uniform noise amplitude [Default: 2]\n");
+  printf("         -p <rows>         rows between gate openings [Default: 600]\n");
+  printf("         -S <seed>\n");
+  printf("Verify:  -f <file>         recording with streams 2 and 3\n");
+  printf("         -j <threads>      [Default: 4]\n");
+}
+
+static uint32_t _random(uint32_t& s)
+{
+  s ^= s<<13; s ^= s>>17; s ^= s<<5;
+  return s;
+}
+
+static double seconds(const timespec& t0, const timespec& t1)
+{
+  return double(t1.tv_sec - t0.tv_sec) + 1.e-9*(double(t1.tv_nsec)-double(t0.tv_nsec));
+}
+
+//
+//  Lane levels with noise, and after each opening a few rows with a
+//  pulse, in the layout of hsdCorrGen.py.  The flag ending a line of
+//  adcin.dat opens a gate at the row's first super-sample.
+//  adcout.dat holds the corrector's output after each row, which the
+//  simulation writes one line later.
+//
+static int generate(const char* dir, const BaselineCorr::Config& cfg,
+                    unsigned rows, const unsigned* level, unsigned noise,
+                    unsigned period, uint32_t seed)
+{
+  const unsigned RS = BaselineCorr::RowSamples;
+  std::vector<uint16_t> adc (size_t(rows)*RS);
+  std::vector<uint8_t>  t   (size_t(rows)*BaselineCorr::RowSize, 0);
+  std::vector<uint16_t> out (adc.size());
+  std::vector<uint8_t>  tout(t.size());
+  std::vector<uint8_t>  oor (rows);
+
+  for(unsigned r=0; r<rows; r++) {
+    bool open  = period && r >= period && r%period==0;
+    bool pulse = period && r >= period && r%period < 4;
+    if (open)
+      t[r*BaselineCorr::RowSize] = 1;
+    for(unsigned k=0; k<RS; k++) {
+      int v = level[k&3];
+      if (noise)
+        v += int(_random(seed)%(2*noise+1)) - int(noise);
+      if (pulse && k>=4 && k<12)
+        v += 0x100 - 0x10*int(k-4);
+      adc[r*RS+k] = v < 0 ? 0 : v > 0xfff ? 0xfff : v;
+    }
+  }
+
+  BaselineCorr corr(cfg);
+  timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  unsigned noor = corr.run(adc.data(), t.data(), rows, out.data(), tout.data(), oor.data());
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double dt = seconds(t0, t1);
+  printf("%u rows in %.3f s :  %.1f Mrows/s  %.1f MS/s,  %u rows out of range\n",
+         rows, dt, dt > 0 ? 1.e-6*rows/dt : 0., dt > 0 ? 1.e-6*rows*RS/dt : 0., noor);
+
+  std::string in  = std::string(dir) + "/adcin.dat";
+  std::string res = std::string(dir) + "/adcout.dat";
+  FILE* fin  = fopen(in .c_str(), "w");
+  FILE* fout = fopen(res.c_str(), "w");
+  if (!fin || !fout) {
+    perror(!fin ? in.c_str() : res.c_str());
+    if (fin ) fclose(fin);
+    if (fout) fclose(fout);
+    return -1;
+  }
+  for(unsigned r=0; r<rows; r++) {
+    for(unsigned k=0; k<RS; k++)
+      fprintf(fin, " %03x", adc[r*RS+k]);
+    fprintf(fin, " %u\n", t[r*BaselineCorr::RowSize]&1);
+    for(unsigned k=0; k<RS; k++)
+      fprintf(fout, " %04x", out[r*RS+k]);
+    fprintf(fout, " %u\n", tout[r*BaselineCorr::RowSize]&1);
+  }
+  fclose(fin);
+  fclose(fout);
+  printf("Wrote %s, %s\n", in.c_str(), res.c_str());
+  return 0;
+}
+
+//
+//  Per thread buffers and counts
+//
+class Task {
+public:
+  std::vector<uint16_t> gate;
+  std::vector<uint16_t> fex;
+  uint64_t events;
+  uint64_t samples;    // compared
+  uint64_t mismatched;
+  uint64_t outOfRange;
+  uint64_t unchecked;
+  int64_t  first;      // first mismatched event
+};
+
+class Job {
+public:
+  std::vector<Task> tasks;
+  uint16_t          baseline;
+};
+
+//
+//  Stream 3 starts with the opening super-sample, which carries the
+//  corrections; they correct stream 2, which the samples stream 3
+//  kept must equal.
+//
+static void verify(const EventHeader& event, unsigned size, unsigned index,
+                   unsigned thread, void* arg)
+{
+  Job&  job  = *reinterpret_cast<Job*>(arg);
+  Task& task = job.tasks[thread];
+  StreamIndex streams(&event, size);
+  const StreamHeader* raw = streams.valid() ? streams.stream(2) : 0;
+  const StreamHeader* fex = streams.valid() ? streams.stream(3) : 0;
+  task.events++;
+  unsigned n = raw ? raw->samples() : 0;
+  if (!fex || n < BaselineCorr::Ilv || fex->samples() < BaselineCorr::Ilv ||
+      (fex->data()[0] & 0x8000)) {
+    task.unchecked++;
+    return;
+  }
+
+  uint16_t corr[BaselineCorr::Ilv];
+  BaselineCorr::corrections(fex->data(), corr);
+  if (task.gate.size() < n) {
+    task.gate.resize(n);
+    task.fex .resize(n);
+  }
+  task.outOfRange += BaselineCorr::gate(raw->data(), n, corr, job.baseline, task.gate.data());
+
+  //  Suppressed samples are left at 0xffff
+  int m = Decompress::run(fex->data(), fex->samples(), task.fex.data(), n, 0xffff, 0xffff);
+  bool ok = m == int(n);
+  for(unsigned i=0; ok && i<n; i++)
+    if (task.fex[i] != 0xffff && task.fex[i] != task.gate[i])
+      ok = false;
+  task.samples += n;
+  if (!ok) {
+    task.mismatched++;
+    if (task.first < 0 || index < task.first)
+      task.first = index;
+  }
+}
+
+static int check(const char* fname, const BaselineCorr::Config& cfg, unsigned nthreads)
+{
+  RecordFile file;
+  if (!file.open(fname))
+    return -1;
+
+  Job job;
+  job.baseline = cfg.baseline;
+  if (!nthreads)
+    nthreads = 1;
+  job.tasks.resize(nthreads);
+  for(unsigned t=0; t<nthreads; t++) {
+    Task& task = job.tasks[t];
+    task.events = task.samples = task.mismatched = task.outOfRange = task.unchecked = 0;
+    task.first  = -1;
+  }
+
+  timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  file.parallel_for(verify, &job, nthreads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  Task sum;
+  sum.events = sum.samples = sum.mismatched = sum.outOfRange = sum.unchecked = 0;
+  sum.first  = -1;
+  for(unsigned t=0; t<nthreads; t++) {
+    const Task& task = job.tasks[t];
+    sum.events     += task.events;
+    sum.samples    += task.samples;
+    sum.mismatched += task.mismatched;
+    sum.outOfRange += task.outOfRange;
+    sum.unchecked  += task.unchecked;
+    if (task.first >= 0 && (sum.first < 0 || task.first < sum.first))
+      sum.first = task.first;
+  }
+
+  double dt = seconds(t0, t1);
+  printf("%s: %llu events  mismatched %llu  unchecked %llu  samples out of range %llu\n",
+         fname,
+         (unsigned long long)sum.events,
+         (unsigned long long)sum.mismatched,
+         (unsigned long long)sum.unchecked,
+         (unsigned long long)sum.outOfRange);
+  if (sum.first >= 0)
+    printf("first mismatch in event %lld\n", (long long)sum.first);
+  printf("%.3f s :  %.1f events/s  %.1f MS/s\n", dt,
+         dt > 0 ? double(sum.events)/dt : 0.,
+         dt > 0 ? 1.e-6*double(sum.samples)/dt : 0.);
+  return sum.mismatched ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+
+  extern char* optarg;
+  char* endptr;
+
+  int c;
+  bool lUsage = false;
+  const char* dir      = 0;
+  const char* fname    = 0;
+  const char* isa      = 0;
+  unsigned    accShift = BaselineCorr::MaxAccum;
+  unsigned    baseline = 0x4000;
+  unsigned    rows     = 1000;
+  unsigned    level[]  = { 0x7ff, 0x800, 0x801, 0x802 };
+  unsigned    noise    = 2;
+  unsigned    period   = 600;
+  uint32_t    seed     = 1;
+  unsigned    nthreads = 4;
+
+  while ( (c=getopt( argc, argv, "a:B:s:o:n:l:r:p:S:f:j:h")) != EOF ) {
+    switch(c) {
+    case 'a': accShift = strtoul(optarg,NULL,0); break;
+    case 'B': baseline = strtoul(optarg,NULL,0); break;
+    case 's': isa      = optarg; break;
+    case 'o': dir      = optarg; break;
+    case 'n': rows     = strtoul(optarg,NULL,0); break;
+    case 'r': noise    = strtoul(optarg,NULL,0); break;
+    case 'p': period   = strtoul(optarg,NULL,0); break;
+    case 'S': seed     = strtoul(optarg,NULL,0); break;
+    case 'f': fname    = optarg; break;
+    case 'j': nthreads = strtoul(optarg,NULL,0); break;
+    case 'l':
+      endptr = optarg;
+      for(unsigned i=0; i<4; i++) {
+        level[i] = strtoul(endptr,&endptr,0);
+        if (i<3 && *endptr++!=',')
+          lUsage = true;
+      }
+      break;
+    case 'h':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (lUsage || (!dir && !fname) ||
+      accShift < BaselineCorr::FracBits || accShift > BaselineCorr::MaxAccum) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  if (isa) {
+    unsigned v;
+    for(v=0; v<Simd::NumberOf; v++)
+      if (!strcmp(isa, Simd::name(Simd::Isa(v))))
+        break;
+    if (v==Simd::NumberOf || !BaselineCorr::select(Simd::Isa(v))) {
+      printf("Instruction set %s not supported\n", isa);
+      return -1;
+    }
+  }
+
+  BaselineCorr::Config cfg(accShift, baseline);
+  printf("accShift %u  baseline 0x%x  %s\n", accShift, baseline,
+         Simd::name(BaselineCorr::isa()));
+
+  int result = 0;
+  if (dir && generate(dir, cfg, rows, level, noise, period, seed ? seed : 1))
+    result = -1;
+  if (fname && !result)
+    result = check(fname, cfg, nthreads);
+  return result;
+}
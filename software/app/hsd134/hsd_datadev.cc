@@ -21,7 +21,14 @@
 #include "Module134.hh"
 #include "Fmc134Ctrl.hh"
 #include "Event.hh"
+#include "Decompress.hh"
+#include "Validate.hh"
+#include "Sparsifier.hh"
+#include "BaselineCorr.hh"
 #include "DmaDriver.h"
+#include "DmaSource.hh"
+#include "DmaEmulator.hh"
+#include "Numa.hh"
 #include "Reg.hh"
 #include "OptFmc.hh"
 #include "TriggerEventManager2.hh"
@@ -33,30 +40,20 @@ extern int optind;
 void usage(const char* p) {
     printf("Usage: %s [options]\n",p);
     printf("Options:\n");
-    printf("\t-d <dev>    : device file (default /dev/datadev_0)\n");
+    printf("\t-d <dev>    : device file (default /dev/datadev_0), or emu[:options] for the software emulator\n");
     printf("\t-e <evtcode>: eventcode for triggering (default 45)\n");
     printf("\t-r <marker> : fixed rate marker for triggering\n");
     printf("\t-a <marker,timeslots> : AC rate marker and timeslot bit-mask [0-based] for triggering\n");
     printf("\t-g <group>  : readout group for triggering\n");
     printf("\t-n <events> : acquire <nevents> events\n");
     printf("\t-L <samples>: samples to acquire\n");
-    printf("\t-T <lo,hi>  : sparsification range\n");
+    printf("\t-T <lo,hi>  : sparsification range, in baseline corrected units\n");
     printf("\t-P          : enable ramp test pattern\n");
     printf("\t-R          : enable raw data\n");
     printf("\t-D          : decompress fex data\n");
-}
-
-const std::vector<uint16_t> _decompress(const uint16_t* data, unsigned length, uint16_t filler)
-{
-    std::vector<uint16_t> a(length);
-    for(unsigned j=0, i=0; j<length; i++) {
-        if (data[i]&0x8000)
-            for(unsigned k=0; k<(data[i]&0x7fff) && j<length; k++)
-                a[j++] = filler;
-        else
-            a[j++] = data[i]&0x3fff;
-    }
-    return a;
+    printf("\t-F          : check fex data against the sparsifier model of the baseline corrected raw data\n");
+    printf("\t-S          : shadow configuration registers\n");
+    printf("\t-A <prio>   : buffer and thread on the card's NUMA node; SCHED_FIFO at prio if >0\n");
 }
 
 void sigHandler( int signal ) {
@@ -69,7 +66,11 @@ int main(int argc, char** argv) {
     int c;
     bool lUsage = false;
     bool lDecompress = false;
+    bool lModel      = false;
+    bool lShadow     = false;
     bool lPattern    = false;
+    bool lNuma       = false;
+    int  fifoPriority= 0;
     unsigned length  = 40;  
     unsigned nevents = 10;
     unsigned eventcode = 45;
@@ -86,7 +87,7 @@ int main(int argc, char** argv) {
     q.rows_after  =2;
     char* endptr;
   
-    while ( (c=getopt( argc, argv, "a:d:e:g:r:n:hDL:PRT:")) != EOF ) {
+    while ( (c=getopt( argc, argv, "a:A:d:e:g:r:n:hDFL:PRST:")) != EOF ) {
         switch(c) {
         case 'a':
             acrate = strtoul(optarg,&endptr,0);
@@ -98,6 +99,10 @@ int main(int argc, char** argv) {
                 exit(1);
             }
             break;
+        case 'A':
+            lNuma = true;
+            fifoPriority = strtol(optarg,NULL,0);
+            break;
         case 'd':
             dev = optarg;
             break;
@@ -116,6 +121,13 @@ int main(int argc, char** argv) {
         case 'D':
             lDecompress = true;
             break;
+        case 'F':
+            lModel = true;
+            streams |= 0x44;
+            break;
+        case 'S':
+            lShadow = true;
+            break;
         case 'L':
             length = strtoul(optarg,NULL,0);
             break;
@@ -156,65 +168,115 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
-    int fd = open(dev, O_RDWR);
-    if (fd<0) {
-        perror("Could not open");
+    //
+    //  The emulator stands in for the card, configured from the same
+    //  options; "emu:" options set its rate and lanes
+    //
+    DmaSource* src = 0;
+    Module134* p   = 0;
+    if (strncmp(dev,"emu",3)==0) {
+        DmaEmulator::Config c;
+        if (dev[3]==':' && !c.parse(dev+4))
+            return -1;
+        c.streams    = (streams | (streams>>4)) & 0xf;
+        c.length     = length;
+        c.pattern    = lPattern ? DmaEmulator::Ramp : DmaEmulator::Pulse;
+        c.lo         = q.lo_threshold;
+        c.hi         = q.hi_threshold;
+        c.rowsBefore = q.rows_before;
+        c.rowsAfter  = q.rows_after;
+        DmaEmulator* e = new DmaEmulator(c);
+        length = e->config().length;
+        src    = e;
+    }
+    else if (!(src = DmaSource::open(dev))) {
+        printf("Could not open %s\n", dev);
         return -1;
     }
+    else {
+        p = Module134::create(src->fd());
+        if (lShadow)
+            Pds::Mmhw::Reg::shadow(true);
+        p->dumpMap();
+        p->optfmc().dump();
 
-    Module134* p = Module134::create(fd);
-    p->dumpMap();
-    p->optfmc().dump();
-
-    if (lPattern)
-        p->enable_test_pattern(Module134::Ramp);
-    else
-        p->disable_test_pattern();
+        if (lPattern)
+            p->enable_test_pattern(Module134::Ramp);
+        else
+            p->disable_test_pattern();
 
-    printf("channel 0: %u \n",unsigned(p->tem().evr().channel(0)._counts));
-    printf("channel 1: %u \n",unsigned(p->tem().evr().channel(1)._counts));
+        printf("channel 0: %u \n",unsigned(p->tem().evr().channel(0)._counts));
+        printf("channel 1: %u \n",unsigned(p->tem().evr().channel(1)._counts));
 
-    p->stop();
+        p->stop();
 
-    // "Rows" of data 
-    // 1 row = 8 samples four channel mode or 
-    //        32 samples one channel mode)
+        // "Rows" of data 
+        // 1 row = 8 samples four channel mode or 
+        //        32 samples one channel mode)
 
-    //  Acquire all 4 streams for each chip
-    //     0 : 3200m channel 0
-    //     1 : 3200m channel 1
-    //     2 : 6400m
-    //     3 : 6400m sparsified
-    length = 32*(length/32);
-    //  One channel readout (interleaved)
-    // (length,delay,prescale,input(unused),stream_mask,sparsify)
-    p->sample_init(length, 1, 2, 0, streams, q);
+        //  Acquire all 4 streams for each chip
+        //     0 : 3200m channel 0
+        //     1 : 3200m channel 1
+        //     2 : 6400m
+        //     3 : 6400m sparsified
+        length = 32*(length/32);
+        //  One channel readout (interleaved)
+        // (length,delay,prescale,input(unused),stream_mask,sparsify)
+        p->sample_init(length, 1, 2, 0, streams, q);
 
-    //  Setup trigger
-    if (rate>=0)
-        p->trig_rate( rate );
-    else if (acrate>=0)
-        p->trig_acrate( acrate, tsmask );
-    else if (group>=0)
-        p->trig_group( group );
-    else
-        p->trig_lcls( eventcode );
+        //  Setup trigger
+        if (rate>=0)
+            p->trig_rate( rate );
+        else if (acrate>=0)
+            p->trig_acrate( acrate, tsmask );
+        else if (group>=0)
+            p->trig_group( group );
+        else
+            p->trig_lcls( eventcode );
+    }
 
     const unsigned maxSize = 1<<24;
-    uint32_t* data = new uint32_t[maxSize];
+    uint32_t* data = 0;
+    if (lNuma) {
+        int node = Numa::node(dev);
+        printf("%s on NUMA node %d\n", dev, node);
+        Numa::pin(Numa::cpus(node), fifoPriority);
+        data = reinterpret_cast<uint32_t*>(Numa::allocate(maxSize*sizeof(uint32_t), node));
+        if (!data)
+            printf("Buffer not allocated on the node; using the heap\n");
+    }
+    //  Released as it was allocated
+    bool lNumaData = data != 0;
+    if (!data)
+        data = new uint32_t[maxSize];
+    std::vector<uint16_t> decompressed(length);
     unsigned flags;
     unsigned error;
     unsigned dest;
     ssize_t  nb;
 
     //  Enable
-    p->start();
+    if (p)
+        p->start();
 
     printf("===========\n");
     printf("===========\n");
 
     std::map<unsigned,unsigned> sizeMap;
 
+    //  The gate phase within the sparsifier's row is found per event,
+    //  starting from the last one found.  The firmware corrects the
+    //  baseline ahead of the sparsifier, so the model is given stream 2
+    //  corrected by the values heading stream 3.
+    Sparsifier* model = 0;
+    unsigned    phase = 0;
+    unsigned    nraw  = 0;
+    std::vector<uint16_t> gate;
+    const uint16_t baseline = BaselineCorr::Config().baseline;
+    if (lModel)
+        model = new Sparsifier(Sparsifier::Config(q.lo_threshold, q.hi_threshold,
+                                                  q.rows_before, q.rows_after));
+
     bool lprint=true;
 
     for(unsigned ievt = 0; ievt < nevents; ) {
@@ -222,12 +284,19 @@ int main(int argc, char** argv) {
         bool lErr=false;
         const uint16_t SMP_LO = 0x000, SMP_HI = 0x1000;
         const uint16_t* sdata[4];
-        if ((nb = dmaRead(fd, data, maxSize, &flags, &error, &dest))>0) {
+        if ((nb = src->read(data, maxSize, &flags, &error, &dest))>0) {
             sizeMap[nb]++;
             ievt++;
             const EventHeader* eh = reinterpret_cast<const EventHeader*>(data);
-            StreamIterator it = eh->streams();
-            for(const StreamHeader* sh = it.first(); sh; sh=it.next()) {
+            StreamIndex index(eh, nb);
+            if (!index.valid()) {
+                printf("Event of %zd bytes: %s\n", nb, StreamIndex::name(index.error()));
+                lErr=true;
+            }
+            for(unsigned id=0; id<StreamIndex::MaxStreams; id++) {
+                const StreamHeader* sh = index.stream(id);
+                if (!sh)
+                    continue;
                 if (lprint)
                     sh->dump();
                 uint16_t s0=0;
@@ -236,24 +305,34 @@ int main(int argc, char** argv) {
                 //  No sparsification in other streams
                 if (sh->stream_id()<3) {
                     sdata[sh->stream_id()] = samples;
-                    for(unsigned i=0; i<sh->samples(); i++) {
-                        if (samples[i]&0x8000) {
-                            printf("Found skip samples in unsparsified stream\n");
-                            lErr=true;
-                        }
-                        // Check pattern
-                        if (lPattern) {
-                            if (i==0 && sh->stream_id()==0)
-                                s0 = samples[i];
-                            else if (sh->stream_id()<2 && samples[i] != ((s0+i)&0x7ff)) {
-                                printf("Pattern error at sample %d (%x/%x)\n",
-                                       i, samples[i], ((s0+i)&0x7ff));
+                    unsigned n = sh->samples();
+                    if (sh->stream_id()==2)
+                        nraw = n;
+                    Validate::Result r = Validate::skip(samples, n);
+                    if (!r.ok()) {
+                        printf("Found %u skip samples in unsparsified stream (first at %d)\n",
+                               r.errors, r.first);
+                        lErr=true;
+                    }
+                    // Check pattern
+                    if (lPattern) {
+                        if (sh->stream_id()==0 && n)
+                            s0 = samples[0];
+                        if (sh->stream_id()<2) {
+                            r = Validate::ramp(samples, n, s0, 0x7ff, sh->stream_id()==0 ? 1:0);
+                            if (!r.ok()) {
+                                printf("Pattern error at sample %d (%x/%x), %u errors\n",
+                                       r.first, samples[r.first], ((s0+r.first)&0x7ff), r.errors);
                                 lErr=true;
                             }
                         }
-                        // Check range
-                        else if (samples[i]<SMP_LO || samples[i]>SMP_HI) {
-                            printf("Found samples out of range\n");
+                    }
+                    // Check range
+                    else {
+                        r = Validate::range(samples, n, SMP_LO, SMP_HI);
+                        if (!r.ok()) {
+                            printf("Found %u samples out of range (first %x at %d)\n",
+                                   r.errors, samples[r.first], r.first);
                             lErr=true;
                         }
                     }
@@ -278,12 +357,31 @@ int main(int argc, char** argv) {
                         }
                     }                
                 }
+                if (sh->stream_id()==3 && model && index.stream(2) &&
+                    nraw >= BaselineCorr::Ilv && sh->samples() >= BaselineCorr::Ilv &&
+                    !(samples[0]&0x8000)) {
+                    uint16_t corr[BaselineCorr::Ilv];
+                    BaselineCorr::corrections(samples, corr);
+                    gate.resize(nraw);
+                    BaselineCorr::gate(sdata[2], nraw, corr, baseline, gate.data());
+                    int p = model->match(gate.data(), nraw, samples, sh->samples(), phase);
+                    if (p < 0) {
+                        printf("Fex data disagrees with the sparsifier model\n");
+                        lErr=true;
+                    }
+                    else
+                        phase = p;
+                }
                 if (sh->stream_id()==3 && lDecompress && lprint) {
                     //  decompress
                     printf("  --decompressed\n");
-                    const std::vector<uint16_t> s = _decompress(samples,length,(q.lo_threshold+q.hi_threshold)/2);
-                    for(unsigned i=0; i<s.size(); i++)
-                        printf(" %04x", s[i]);
+                    int n = Decompress::run(samples, sh->samples(),
+                                            decompressed.data(), length,
+                                            (q.lo_threshold+q.hi_threshold)/2);
+                    if (n < 0)
+                        printf("  exceeds %u samples\n", length);
+                    for(int i=0; i<n; i++)
+                        printf(" %04x", decompressed[i]);
                     printf("\n");
                 }
             }
@@ -291,7 +389,10 @@ int main(int argc, char** argv) {
                 printf("---\n");
                 printf("Read %zu bytes:  Dest 0x%x  %s\n",nb, dest, (dest>>8)?"A2/3":"A0/1");
                 eh->dump();
-                for(const StreamHeader* sh = it.first(); sh; sh=it.next()) {
+                for(unsigned id=0; id<StreamIndex::MaxStreams; id++) {
+                    const StreamHeader* sh = index.stream(id);
+                    if (!sh)
+                        continue;
                     sh->dump();
                     const uint16_t* samples = sh->data();
                     for(unsigned i=0; i<sh->samples(); i++)
@@ -306,9 +407,15 @@ int main(int argc, char** argv) {
         }
     }
 
-    p->stop();
+    if (p)
+        p->stop();
+    delete src;
+    delete model;
 
-    delete[] data;
+    if (lNumaData)
+        Numa::release(data, maxSize*sizeof(uint32_t));
+    else
+        delete[] data;
 
     for(std::map<unsigned,unsigned>::iterator it=sizeMap.begin(); it!=sizeMap.end(); it++) {
         printf("sizeMap[%u] : %u\n", it->first, it->second);
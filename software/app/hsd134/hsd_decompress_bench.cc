@@ -0,0 +1,120 @@
+/**
+ **  Throughput of the fex stream decompression kernels
+ **/
+
+#include "Decompress.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using Pds::HSD::Decompress;
+using Pds::HSD::Simd;
+
+void usage(const char* p) {
+  printf("Usage: %s [options]\n",p);
+  printf("Options: -n <samples>   gate length [Default: 4096]\n");
+  printf("         -o <percent>   fraction of samples kept [Default: 10]\n");
+  printf("         -s <samples>   mean length of a kept run [Default: 16]\n");
+  printf("         -r <repeats>   [Default: 100000]\n");
+}
+
+//
+//  Build a sparsified stream alternating kept runs and skip words
+//
+static unsigned generate(std::vector<uint16_t>& in, unsigned gate,
+                         unsigned occupancy, unsigned runLength)
+{
+  unsigned j=0;
+  while(j < gate) {
+    unsigned run = 1 + rand()%(2*runLength);
+    for(unsigned k=0; k<run && j<gate; k++, j++)
+      in.push_back(rand()&0x3fff);
+    if (j == gate)
+      break;
+    unsigned skip = occupancy ? run*(100-occupancy)/occupancy : gate;
+    skip = 1 + rand()%(2*skip+1);
+    if (skip > 0x7fff) skip = 0x7fff;
+    if (skip > gate-j) skip = gate-j;
+    in.push_back(0x8000|skip);
+    j += skip;
+  }
+  return in.size();
+}
+
+int main(int argc, char** argv) {
+
+  extern char* optarg;
+
+  int c;
+  bool lUsage = false;
+  unsigned gate      = 4096;
+  unsigned occupancy = 10;
+  unsigned runLength = 16;
+  unsigned repeats   = 100000;
+
+  while ( (c=getopt( argc, argv, "n:o:s:r:h")) != EOF ) {
+    switch(c) {
+    case 'n': gate      = strtoul(optarg,NULL,0); break;
+    case 'o': occupancy = strtoul(optarg,NULL,0); break;
+    case 's': runLength = strtoul(optarg,NULL,0); break;
+    case 'r': repeats   = strtoul(optarg,NULL,0); break;
+    case 'h':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (lUsage || occupancy > 100 || !runLength) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  std::vector<uint16_t> in;
+  unsigned nin = generate(in, gate, occupancy, runLength);
+  std::vector<uint16_t> ref(gate), out(gate);
+
+  Decompress::select(Simd::Scalar);
+  if (Decompress::run(in.data(), nin, ref.data(), gate, 0x200) != int(gate)) {
+    printf("Reference expansion failed\n");
+    return -1;
+  }
+
+  printf("gate %u samples  input %u words  occupancy %u%%\n", gate, nin, occupancy);
+  printf("%8.8s %12.12s %10.10s %10.10s\n", "isa", "ns/call", "GB/s out", "GB/s in");
+  for(unsigned v=0; v<Simd::NumberOf; v++) {
+    Simd::Isa isa = Simd::Isa(v);
+    if (!Decompress::select(isa)) {
+      printf("%8.8s  unsupported\n", Simd::name(isa));
+      continue;
+    }
+    memset(out.data(), 0, gate*sizeof(uint16_t));
+    if (Decompress::run(in.data(), nin, out.data(), gate, 0x200) != int(gate) ||
+        memcmp(out.data(), ref.data(), gate*sizeof(uint16_t))) {
+      printf("%8.8s  output disagrees with scalar\n", Simd::name(isa));
+      continue;
+    }
+
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int64_t sum = 0;
+    for(unsigned r=0; r<repeats; r++)
+      sum += Decompress::run(in.data(), nin, out.data(), gate, 0x200);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double dt = double(t1.tv_sec-t0.tv_sec) + 1.e-9*double(t1.tv_nsec-t0.tv_nsec);
+    if (sum != int64_t(gate)*repeats)
+      printf("  unexpected length sum\n");
+    printf("%8.8s %12.1f %10.2f %10.2f\n",
+           Simd::name(isa),
+           1.e9*dt/double(repeats),
+           double(gate)*2*repeats/dt*1.e-9,
+           double(nin)*2*repeats/dt*1.e-9);
+  }
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ **  Query the index sidecar of a recorded data file
+ **/
+
+#include "EventIndex.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using Pds::HSD::IndexReader;
+
+void usage(const char* p) {
+  printf("Usage: %s -f <file.idx> [options]\n",p);
+  printf("Options: -e <event>           start at recorded event number\n");
+  printf("         -t <sec[.nsec]>      start at timestamp\n");
+  printf("         -n <entries>         number of entries to print [Default: 10]\n");
+  printf("         -d <datafile>        also dump the first words of each event\n");
+}
+
+int main(int argc, char** argv) {
+
+  extern char* optarg;
+  char* endptr;
+
+  int c;
+  bool lUsage = false;
+  const char* fname = 0;
+  const char* dname = 0;
+  int64_t  event = -1;
+  uint64_t tstamp = 0;
+  bool     ltime = false;
+  unsigned nprint = 10;
+
+  while ( (c=getopt( argc, argv, "f:e:t:n:d:h")) != EOF ) {
+    switch(c) {
+    case 'f':
+      fname = optarg;
+      break;
+    case 'd':
+      dname = optarg;
+      break;
+    case 'e':
+      event = strtoul(optarg,NULL,0);
+      break;
+    case 't':
+      tstamp = uint64_t(strtoul(optarg,&endptr,0))<<32;
+      if (*endptr=='.')
+        tstamp |= strtoul(endptr+1,NULL,10);
+      ltime = true;
+      break;
+    case 'n':
+      nprint = strtoul(optarg,NULL,0);
+      break;
+    case 'h':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (!fname)
+    lUsage = true;
+
+  if (lUsage) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  IndexReader idx;
+  if (!idx.open(fname))
+    return -1;
+
+  printf("%s: %u entries\n", fname, idx.entries());
+
+  unsigned first = 0;
+  if (event >= 0)
+    first = idx.findEvent(event);
+  else if (ltime)
+    first = idx.findTime(tstamp);
+
+  if (first >= idx.entries()) {
+    printf("No matching entry\n");
+    return 0;
+  }
+
+  FILE* f = 0;
+  if (dname && !(f = fopen(dname,"r"))) {
+    perror(dname);
+    return -1;
+  }
+
+  printf("%10.10s  %14.14s  %8.8s  %20.20s  %14.14s  %s  %s  %27.27s\n",
+         "event", "offset", "size", "timestamp", "pulseId", "l", "sm", "samples");
+  for(unsigned i=first; i<first+nprint && i<idx.entries(); i++) {
+    idx[i].dump();
+    if (f) {
+      uint32_t w[8];
+      if (fseeko(f, idx[i].offset, SEEK_SET) ||
+          fread(w, sizeof(w), 1, f) != 1) {
+        perror("Reading data file");
+        break;
+      }
+      printf("\t");
+      for(unsigned j=0; j<8; j++)
+        printf("%08x%c", w[j], j==7 ? '\n' : ' ');
+    }
+  }
+
+  if (f)
+    fclose(f);
+
+  return 0;
+}
@@ -10,17 +10,22 @@
 #include <arpa/inet.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/wait.h>
 #include <new>
 
 #include "Module134.hh"
 #include "I2c134.hh"
 #include "Fmc134Cpld.hh"
 #include "TprCore.hh"
+#include "RegProxy.hh"
+#include "Bringup.hh"
+#include "CalibCache.hh"
 #include "SysLog.hh"
 
 #define logging psalg::SysLog
 
 #include <string>
+#include <vector>
 
 extern int optind;
 
@@ -28,45 +33,170 @@ using namespace Pds::HSD;
 
 void usage(const char* p) {
     printf("Usage: %s [options]\n",p);
-    printf("Options: -d <dev> [device file    ; default: /dev/datadev_0]\n");
+    printf("Options: -d <dev> [device file    ; default: /dev/datadev_0; repeat for more cards]\n");
     printf("         -1(2)    [single (dual) channel       ; default: 1]\n");
     printf("         -A(B)    [A0/2 (A1/3) is primary input; default: A]\n");
+    printf("         -i       [register access through ioctl; default: mapped]\n");
+    printf("         -s <us>  [delay after each FMC SPI command; default: 0]\n");
+    printf("         -V       [verify clock tree and ADC programming by readback]\n");
+    printf("         -C <dir> [reuse the ADC calibration cached in dir]\n");
+    printf("         -T <C>   [recalibrate if the board temperature differs by more; default: 5]\n");
+    printf("         -F       [force recalibration, replacing the cached one]\n");
+}
+
+class Options {
+public:
+    bool      reset;
+    bool      lDualCh;
+    InputChan inputCh;
+    bool      lInternalTiming;
+    bool      lIoctl;
+    unsigned  spiSettle;
+    bool      lVerify;
+    const char* calibDir;
+    double    calibTolerance;
+    bool      lRecalibrate;
+};
+
+static double now()
+{
+    timespec tv;
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+    return double(tv.tv_sec)+1.e-9*double(tv.tv_nsec);
+}
+
+static int init_card(const char* dev, const Options& o)
+{
+    int fd = open(dev, O_RDWR);
+    if (fd<0) {
+        perror("Open device failed");
+        return -1;
+    }
+
+    Module134* m = Module134::create(fd);
+    if (o.lIoctl)
+        Pds::Mmhw::Reg::backend(Pds::Mmhw::Reg::Ioctl);
+    Fmc134Cpld::spiSettle   (o.spiSettle);
+    Fmc134Cpld::verifyTables(o.lVerify);
+    m->dumpMap();
+    printf("--board status--\n");
+    m->board_status();
+    printf("--timing--\n");
+    m->setup_timing();
+
+    if (o.reset) {
+        m->tpr().resetRxPll();
+        usleep(1000000);
+        m->tpr().resetBB();
+        m->tpr().resetCounts();
+    }
+
+    printf("tem remote id: %08x\n",m->remote_id());
+
+    //  Skip the ADC foreground calibration if one was taken under the
+    //  same conditions
+    std::string adc0, adc1;
+    CalibCache* cache = 0;
+    CalibCache::Key key;
+    double temperature = 0;
+    if (o.calibDir) {
+        cache = new CalibCache(o.calibDir, o.calibTolerance);
+        key.board     = m->fmc_id();
+        key.clockmode = o.lInternalTiming ?
+            Fmc134Cpld::CLOCKTREE_CLKSRC_INTERNAL :
+            Fmc134Cpld::CLOCKTREE_REFSRC_EXTERNAL;
+        key.lDualCh   = o.lDualCh;
+        key.inputCh   = o.inputCh;
+        temperature   = m->mon().boardTemp;
+        if (!o.lRecalibrate)
+            cache->lookup(key, temperature, adc0, adc1);
+    }
+
+    std::string cached0(adc0), cached1(adc1);
+    m->setup_jesd(false,adc0,adc1,o.lDualCh,o.inputCh,o.lInternalTiming);
+
+    if (cache) {
+        if (adc0 != cached0 || adc1 != cached1)
+            cache->store(key, temperature, adc0, adc1);
+        delete cache;
+    }
+
+    unsigned busId = strtoul(dev+strlen(dev)-2,NULL,16);
+    m->set_local_id(busId);
+
+    Pds::Mmhw::RegProxy::dumpStats();
+    Pds::HSD::Bringup::report(dev);
+
+#if 0
+    //  Name the remote partner on the timing link
+    { unsigned upaddr = m->remote_id();
+        std::string paddr = Psdaq::AppUtils::parse_paddr(upaddr);
+        printf("paddr [0x%x] [%s]\n", upaddr, paddr.c_str());
+    }
+#endif
+
+    return 0;
 }
 
 int main(int argc, char** argv) {
 
     extern char* optarg;
 
-    const char* dev="/dev/datadev_0";
-    bool reset = false;
-    bool lDualCh = false;
-    InputChan inputCh = CHAN_A0_2;
-    bool lInternalTiming = false;
+    std::vector<const char*> devs;
+    Options o;
+    o.reset = false;
+    o.lDualCh = false;
+    o.inputCh = CHAN_A0_2;
+    o.lInternalTiming = false;
+    o.lIoctl = false;
+    o.spiSettle = 0;
+    o.lVerify = false;
+    o.calibDir = 0;
+    o.calibTolerance = 5.;
+    o.lRecalibrate = false;
     int c;
     bool lUsage = false;
 
-    while ( (c=getopt( argc, argv, "d:12ABIrh")) != EOF ) {
+    while ( (c=getopt( argc, argv, "d:12ABIirs:VC:T:Fh")) != EOF ) {
         switch(c) {
         case 'd':
-            dev = optarg;
+            devs.push_back(optarg);
             break;
         case 'r':
-            reset = true;
+            o.reset = true;
             break;
         case '1':
-            lDualCh = false;
+            o.lDualCh = false;
             break;
         case '2':
-            lDualCh = true;
+            o.lDualCh = true;
             break;
         case 'A':
-            inputCh = CHAN_A0_2;
+            o.inputCh = CHAN_A0_2;
             break;
         case 'B':
-            inputCh = CHAN_A1_3;
+            o.inputCh = CHAN_A1_3;
             break;
         case 'I':
-            lInternalTiming = true;
+            o.lInternalTiming = true;
+            break;
+        case 'i':
+            o.lIoctl = true;
+            break;
+        case 's':
+            o.spiSettle = strtoul(optarg,NULL,0);
+            break;
+        case 'V':
+            o.lVerify = true;
+            break;
+        case 'C':
+            o.calibDir = optarg;
+            break;
+        case 'T':
+            o.calibTolerance = strtod(optarg,NULL);
+            break;
+        case 'F':
+            o.lRecalibrate = true;
             break;
         case '?':
         default:
@@ -80,43 +210,53 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
+    if (devs.empty())
+        devs.push_back("/dev/datadev_0");
+
     logging::init(0,LOG_DEBUG);
 
-    int fd = open(dev, O_RDWR);
-    if (fd<0) {
-        perror("Open device failed");
-        return -1;
-    }
+    if (devs.size()==1)
+        return init_card(devs[0], o);
 
-    Module134* m = Module134::create(fd);
-    m->dumpMap();
-    printf("--board status--\n");
-    m->board_status();
-    printf("--timing--\n");
-    m->setup_timing();
-
-    if (reset) {
-        m->tpr().resetRxPll();
-        usleep(1000000);
-        m->tpr().resetBB();
-        m->tpr().resetCounts();
+    //
+    //  Bring up the cards concurrently, one process per card since the
+    //  register access is set up per process.
+    //
+    double t0 = now();
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    fflush(stdout);
+    std::vector<pid_t> pids(devs.size(), -1);
+    for(unsigned i=0; i<devs.size(); i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int rc = init_card(devs[i], o);
+            fflush(stdout);
+            _exit(rc ? 1 : 0);
+        }
+        if (pid < 0)
+            perror("fork");
+        pids[i] = pid;
     }
 
-    printf("tem remote id: %08x\n",m->remote_id());
-
-    std::string adccal;
-    m->setup_jesd(false,adccal,adccal,lDualCh,inputCh,lInternalTiming);
-
-    unsigned busId = strtoul(dev+strlen(dev)-2,NULL,16);
-    m->set_local_id(busId);
+    int result = 0;
+    std::vector<int> status(devs.size(), -1);
+    for(unsigned n=0; n<devs.size(); n++) {
+        int st;
+        pid_t pid = wait(&st);
+        if (pid < 0)
+            break;
+        for(unsigned i=0; i<devs.size(); i++)
+            if (pids[i]==pid)
+                status[i] = st;
+    }
 
-#if 0
-    //  Name the remote partner on the timing link
-    { unsigned upaddr = m->remote_id();
-        std::string paddr = Psdaq::AppUtils::parse_paddr(upaddr);
-        printf("paddr [0x%x] [%s]\n", upaddr, paddr.c_str());
+    printf("--bring-up summary-- %.1f s\n", now()-t0);
+    for(unsigned i=0; i<devs.size(); i++) {
+        bool ok = pids[i]>0 && WIFEXITED(status[i]) && WEXITSTATUS(status[i])==0;
+        printf("  %-20.20s %s\n", devs[i], ok ? "ok" : "FAILED");
+        if (!ok)
+            result = 1;
     }
-#endif
 
-    return 0;
+    return result;
 }
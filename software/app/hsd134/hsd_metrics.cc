@@ -0,0 +1,59 @@
+/**
+ **  Monitor of the metrics a readout tool exports to shared memory
+ **/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include "Metrics.hh"
+
+using Pds::HSD::Metrics;
+
+extern int optind;
+
+void usage(const char* p) {
+  printf("Usage: %s [options] <segment>\n",p);
+  printf("Options: -p <sec>  [update period; default: 1]\n");
+  printf("         -n <n>    [updates; default: forever]\n");
+}
+
+int main(int argc, char** argv) {
+  extern char* optarg;
+  unsigned period = 1;
+  unsigned n      = unsigned(-1);
+  int c;
+  while ( (c=getopt( argc, argv, "p:n:h")) != EOF ) {
+    switch(c) {
+    case 'p':
+      period = strtoul(optarg,NULL,0);
+      break;
+    case 'n':
+      n = strtoul(optarg,NULL,0);
+      break;
+    case 'h':
+    default:
+      usage(argv[0]);
+      return c=='h' ? 0 : 1;
+    }
+  }
+
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Metrics* m = Metrics::attach(argv[optind]);
+  if (!m)
+    return 1;
+
+  m->dump();
+  while(n--) {
+    sleep(period);
+    printf("--------------\n");
+    m->dump();
+  }
+
+  delete m;
+  return 0;
+}
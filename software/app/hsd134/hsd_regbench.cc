@@ -0,0 +1,123 @@
+/**
+ **  Latency of register accesses through each Reg backend
+ **/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "Reg.hh"
+#include "DmaDriver.h"
+
+using Pds::Mmhw::Reg;
+
+extern int optind;
+
+void usage(const char* p) {
+  printf("Usage: %s [options]\n",p);
+  printf("Options: -d <dev>      [device file; default: /dev/datadev_0]\n");
+  printf("         -a <addr>     [register to access; default: 0x4 (AxiVersion scratchpad)]\n");
+  printf("         -n <accesses> [default: 100000]\n");
+  printf("         -m <bytes>    [size of the mapped register space; default: 0x100000]\n");
+  printf("         -w            [include writes]\n");
+}
+
+static double seconds(const timespec& t0, const timespec& t1)
+{
+  return double(t1.tv_sec-t0.tv_sec) + 1.e-9*double(t1.tv_nsec-t0.tv_nsec);
+}
+
+static void measure(const char* name, Reg& reg, unsigned n, bool lWrite)
+{
+  timespec t0, t1;
+  unsigned v = 0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(unsigned i=0; i<n; i++)
+    v += unsigned(reg);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  printf("%8.8s read  : %10.1f ns/access  [%x]\n", name, 1.e9*seconds(t0,t1)/double(n), v);
+
+  if (lWrite) {
+    unsigned save = reg;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(unsigned i=0; i<n; i++)
+      reg = i;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%8.8s write : %10.1f ns/access\n", name, 1.e9*seconds(t0,t1)/double(n));
+    //  Writes may be posted; a read flushes them
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(unsigned i=0; i<n; i++) {
+      reg = i;
+      v += unsigned(reg);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%8.8s w+r   : %10.1f ns/pair\n", name, 1.e9*seconds(t0,t1)/double(n));
+    reg = save;
+  }
+}
+
+int main(int argc, char** argv) {
+  extern char* optarg;
+  const char* dev = "/dev/datadev_0";
+  unsigned addr  = 4;
+  unsigned n     = 100000;
+  unsigned size  = 0x100000;
+  bool lWrite    = false;
+
+  int c;
+  bool lUsage = false;
+  while ( (c=getopt( argc, argv, "d:a:n:m:wh")) != EOF ) {
+    switch(c) {
+    case 'd':
+      dev = optarg;
+      break;
+    case 'a':
+      addr = strtoul(optarg,NULL,0);
+      break;
+    case 'n':
+      n = strtoul(optarg,NULL,0);
+      break;
+    case 'm':
+      size = strtoul(optarg,NULL,0);
+      break;
+    case 'w':
+      lWrite = true;
+      break;
+    case 'h':
+      usage(argv[0]);
+      exit(0);
+    case '?':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (lUsage || !n) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  int fd = open(dev, O_RDWR);
+  if (fd<0) {
+    perror("Could not open");
+    return -1;
+  }
+
+  Reg& reg = *reinterpret_cast<Reg*>(addr);
+
+  Reg::set(fd);
+  measure("ioctl", reg, n, lWrite);
+
+  if (Reg::map(fd, size))
+    measure("mapped", reg, n, lWrite);
+  else
+    printf("  mapped : unavailable\n");
+
+  Reg::unmap();
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ **  Throughput of the readout pipeline stages on a replayed recording
+ **/
+
+#include "DmaSource.hh"
+#include "DmaWait.hh"
+#include "Pipeline.hh"
+#include "Event.hh"
+#include "Validate.hh"
+#include "Decompress.hh"
+#include "HitFinder.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using Pds::HSD::DmaSource;
+using Pds::HSD::DmaWait;
+using Pds::HSD::Pipeline;
+using Pds::HSD::EventHeader;
+using Pds::HSD::StreamHeader;
+using Pds::HSD::StreamIndex;
+using Pds::HSD::Validate;
+using Pds::HSD::Decompress;
+using Pds::HSD::HitFinder;
+
+void usage(const char* p) {
+  printf("Usage: %s -f <file> [options]\n",p);
+  printf("Options: -s <speed>     multiple of the recorded rate, 0 for max [Default: 0]\n");
+  printf("         -l <loops>     passes over the file, 0 for no end [Default: 1]\n");
+  printf("         -b <buffers>   DMA buffers [Default: 256]\n");
+  printf("         -B <n>         events per read [Default: 64]\n");
+  printf("         -p             preload the file before starting\n");
+  printf("         -N <events>    stop after this many events\n");
+  printf("         -r             report every second\n");
+  printf("         -H <options>   hit finder options (see HitFinder.hh)\n");
+}
+
+//
+//  Locate the streams of each event
+//
+class IndexStage : public Pipeline::Stage {
+public:
+  IndexStage() : Pipeline::Stage("index"), invalid(0) {}
+public:
+  void process(const Pipeline::Event& ev)
+  { StreamIndex index(reinterpret_cast<const EventHeader*>(ev.data), ev.size);
+    if (!index.valid())
+      invalid++; }
+public:
+  uint64_t invalid;
+};
+
+//
+//  Raw streams have no skip words and samples within 12 bits
+//
+class ValidateStage : public Pipeline::Stage {
+public:
+  ValidateStage() : Pipeline::Stage("validate"), errors(0) {}
+public:
+  void process(const Pipeline::Event& ev)
+  { StreamIndex index(reinterpret_cast<const EventHeader*>(ev.data), ev.size);
+    for(unsigned i=0; i<3; i++) {
+      const StreamHeader* s = index.stream(i);
+      if (!s)
+        continue;
+      errors += Validate::skip (s->data(), s->samples()).errors;
+      errors += Validate::range(s->data(), s->samples(), 0, 0xfff).errors;
+    } }
+public:
+  uint64_t errors;
+};
+
+//
+//  Expand the sparsified stream to the length of the raw interleave
+//
+class DecompressStage : public Pipeline::Stage {
+public:
+  DecompressStage() : Pipeline::Stage("decompress"), samples(0), overruns(0), _out(0x40000) {}
+public:
+  void process(const Pipeline::Event& ev)
+  { StreamIndex index(reinterpret_cast<const EventHeader*>(ev.data), ev.size);
+    const StreamHeader* s = index.stream(3);
+    if (!s)
+      return;
+    const StreamHeader* r = index.stream(2);
+    unsigned gate = r && r->samples() < _out.size() ? r->samples() : _out.size();
+    int n = Decompress::run(s->data(), s->samples(), _out.data(), gate, 0);
+    if (n < 0)
+      overruns++;
+    else
+      samples += n; }
+public:
+  uint64_t samples;
+  uint64_t overruns;
+private:
+  std::vector<uint16_t> _out;
+};
+
+//
+//  Reduce the raw streams to their hit lists
+//
+class HitStage : public Pipeline::Stage {
+public:
+  HitStage(const HitFinder::Config& c) : Pipeline::Stage("hits"), bytes(0), _finder(c) {}
+public:
+  void process(const Pipeline::Event& ev)
+  { bytes += _finder.encode(ev.data, ev.size, _out); }
+  const HitFinder& finder() const { return _finder; }
+public:
+  uint64_t bytes;    // of the hit lists
+private:
+  HitFinder             _finder;
+  std::vector<uint16_t> _out;
+};
+
+static void release_buffers(void* arg, uint32_t* indices, unsigned n)
+{
+  reinterpret_cast<DmaSource*>(arg)->release(n, indices);
+}
+
+static double seconds(const timespec& t0, const timespec& t1)
+{
+  return double(t1.tv_sec - t0.tv_sec) + 1.e-9*(double(t1.tv_nsec)-double(t0.tv_nsec));
+}
+
+int main(int argc, char** argv) {
+
+  extern char* optarg;
+
+  int c;
+  bool lUsage = false;
+  const char* fname   = 0;
+  double      speed   = 0;
+  unsigned    loops   = 1;
+  unsigned    buffers = 256;
+  unsigned    nbulk   = 64;
+  bool        preload = false;
+  bool        report  = false;
+  uint64_t    nevents = uint64_t(-1);
+  HitFinder::Config hitConfig;
+
+  while ( (c=getopt( argc, argv, "f:s:l:b:B:N:H:prh")) != EOF ) {
+    switch(c) {
+    case 'f': fname   = optarg; break;
+    case 's': speed   = strtod (optarg,NULL); break;
+    case 'l': loops   = strtoul(optarg,NULL,0); break;
+    case 'b': buffers = strtoul(optarg,NULL,0); break;
+    case 'B': nbulk   = strtoul(optarg,NULL,0); break;
+    case 'N': nevents = strtoull(optarg,NULL,0); break;
+    case 'p': preload = true; break;
+    case 'r': report  = true; break;
+    case 'H':
+      if (!hitConfig.parse(optarg))
+        lUsage = true;
+      break;
+    case 'h':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (lUsage || !fname || !nbulk) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char name[512];
+  snprintf(name, sizeof(name), "replay:%s,speed=%g,loops=%u,buffers=%u,preload=%u",
+           fname, speed, loops, buffers, preload ? 1:0);
+  DmaSource* src = DmaSource::open(name);
+  if (!src)
+    return -1;
+
+  uint32_t dmaCount, dmaSize;
+  void** dmaBuffers = src->map(&dmaCount, &dmaSize);
+
+  IndexStage*      index      = new IndexStage;
+  ValidateStage*   validate   = new ValidateStage;
+  DecompressStage* decompress = new DecompressStage;
+  HitStage*        hits       = new HitStage(hitConfig);
+  Pipeline pipeline(dmaCount, dmaCount, release_buffers, src);
+  pipeline.add(index);
+  pipeline.add(validate);
+  pipeline.add(decompress);
+  pipeline.add(hits);
+  pipeline.start();
+
+  //  Buffers come back to the source only when this thread reclaims
+  //  them from the stages, so it must not block while they are all out
+  DmaWait waiter(src->fd(), speed > 0 ? DmaWait::Adaptive : DmaWait::Spin);
+
+  std::vector<int32_t>  dmaRet  (nbulk);
+  std::vector<uint32_t> dmaIndex(nbulk);
+  std::vector<uint32_t> rxDest  (nbulk);
+
+  uint64_t events = 0, bytes = 0;
+  timespec tstart, treport, tv;
+  clock_gettime(CLOCK_MONOTONIC, &tstart);
+  treport = tstart;
+
+  while(events < nevents) {
+    if (!waiter.wait())
+      break;
+    ssize_t bret = src->readBulk(nbulk, dmaRet.data(), dmaIndex.data(), 0, 0, rxDest.data());
+    if (bret < 0) {
+      perror("Reading buffers");
+      break;
+    }
+    waiter.read(bret);
+    if (!bret && src->finished())
+      break;
+
+    for(ssize_t i=0; i<bret; i++) {
+      Pipeline::Event ev;
+      ev.data  = reinterpret_cast<uint32_t*>(dmaBuffers[dmaIndex[i]]);
+      ev.size  = dmaRet[i];
+      ev.dest  = rxDest[i];
+      ev.error = 0;
+      ev.index = dmaIndex[i];
+      pipeline.dispatch(ev);
+      bytes += dmaRet[i];
+    }
+    events += bret;
+    pipeline.reclaim();
+
+    if (report) {
+      clock_gettime(CLOCK_MONOTONIC, &tv);
+      if (seconds(treport, tv) >= 1) {
+        treport = tv;
+        src->dump();
+        pipeline.dump();
+      }
+    }
+  }
+
+  pipeline.stop();
+  clock_gettime(CLOCK_MONOTONIC, &tv);
+  double dt = seconds(tstart, tv);
+
+  printf("Replayed %llu events  %llu bytes  in %.3f s :  %.1f events/s  %.2f MB/s\n",
+         (unsigned long long)events, (unsigned long long)bytes, dt,
+         dt > 0 ? double(events)/dt : 0.,
+         dt > 0 ? double(bytes)/dt*1.e-6 : 0.);
+  pipeline.dump();
+  printf("index: %llu invalid  validate: %llu errors  decompress: %llu samples  %llu overruns\n",
+         (unsigned long long)index->invalid,
+         (unsigned long long)validate->errors,
+         (unsigned long long)decompress->samples,
+         (unsigned long long)decompress->overruns);
+  printf("hits: %llu pulses  %llu over the limit  %llu bytes  (%.1f%% of the events)\n",
+         (unsigned long long)hits->finder().pulses,
+         (unsigned long long)hits->finder().truncated,
+         (unsigned long long)hits->bytes,
+         bytes ? 100.*double(hits->bytes)/double(bytes) : 0.);
+
+  src->unmap(dmaBuffers);
+  delete src;
+  return 0;
+}
@@ -1,5 +1,6 @@
 /**
- **  Read simulated data file and validate sparsification
+ **  Read simulated data file, validate sparsification and convert it
+ **  into a recording for the tools that read hsdRead -f files
  **/
 
 #include <stdio.h>
@@ -7,7 +8,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <new>
+#include <time.h>
+
+#include "SimDump.hh"
+#include "Recorder.hh"
+#include "EventIndex.hh"
+
+using Pds::HSD::SimDump;
+using Pds::HSD::Recorder;
+using Pds::HSD::IndexEntry;
 
 extern int optind;
 
@@ -61,7 +70,146 @@ public:
 
 void usage(const char* p) {
   printf("Usage: %s [options]\n",p);
-  printf("Options: -f <filename>\n");
+  printf("Options: -f <filename>     simulation dump, one event per line\n");
+  printf("         -o <filename>     write the events as an indexed recording\n");
+  printf("         -j <threads>      parser threads [Default: 4]\n");
+  printf("         -q                do not print the events\n");
+}
+
+class Sim {
+public:
+  Recorder* writer;
+  bool      print;
+  unsigned  FMIN, FMAX;
+  unsigned  events;
+  unsigned  truncated;   // shorter than the event header
+  uint64_t  bytes;
+};
+
+static void dump(const uint32_t* event, unsigned words)
+{
+  printf("Event: %08x.%08x %08x.%08x\n",
+         event[0], event[1], event[2], event[3]);
+
+  unsigned streams = (event[6]>>20)&0xf;
+
+  const Stream* strm = reinterpret_cast<const Stream*>(&event[8]);
+  const Stream* last = reinterpret_cast<const Stream*>(event+words)-1;
+
+  while(streams && strm <= last) {
+    strm->dump();
+
+    streams &= ~(1<<strm->alg);
+    strm = strm->next();
+
+#if 0
+    const uint16_t* s = reinterpret_cast<const uint16_t*>(&event[12]);
+    uint16_t* c = compr;
+    int toffs=-1;
+    { 
+      const uint16_t* s_beg = s + (f[1]&0xff);
+      const uint16_t* s_end = s + (f[0]-8)+((f[1]>>8)&0xff)-1;
+      printf("\tRaw: %08x.%08x.%08x.%08x\n", f[0], f[1], f[2], f[3]);
+      printf("\t\t%04x.%04x [%ld]\n",*s_beg,*s_end,(s_end-s_beg)+1);
+
+      //  Compress the raw data
+      int skip=-1;
+      for(const uint16_t* q = s_beg; q<=s_end; q++) {
+        if (*q < FMIN || *q > FMAX) {
+          if (toffs<0)
+            toffs = q-s_beg;
+          if (skip>=0) {
+            *c++ = 0x8000 | (skip&0x3fff);
+            skip = -1;
+          }
+          *c++ = *q;
+        }
+        else if (toffs>=0) {
+          skip++;
+        }
+      }
+    }
+
+    s += event[8];
+    f = reinterpret_cast<const uint32_t*>(s);
+    printf("\tFex: %08x.%08x.%08x.%08x\n", f[0], f[1], f[2], f[3]);
+
+    if (f[0]) {
+      s += 8; // skip header
+      const uint16_t* s_beg = s + (f[1]&0xff);
+      const uint16_t* s_end = s + (f[0]-8)+((f[1]>>8)&0xff)-1;
+      uint16_t fex_beg = *s_beg;
+      uint16_t fex_end = *s_end;
+      printf("\t\t%04x.%04x [%ld]\n", fex_beg, fex_end, (s_end-s_beg)+1);
+    
+      //  Compare the header
+      if (unsigned(toffs) != f[2])
+        printf("\t\t\ttoffs[%u]  header[%u]\n", toffs, f[2]);
+
+      if (unsigned(c-compr) != s_end-s_beg+1) 
+        printf("\t\t\tfexl[%ld] cmpl[%ld]\n",
+               s_end-s_beg+1, c-compr );
+
+      //  Compare the words
+      bool lErr=false;
+      c = compr;
+      int skipRem = 0;
+      for(s = s_beg; s <= s_end; s++, c++) {
+        //  handle consecutive skip characters carefully
+        while ((*s>>15)==1) {
+          skipRem += (*s&0x3fff)+1;
+          s++;
+          if (s >= s_end)
+            break;
+        }
+
+        while ((*c>>15)==1) {
+          skipRem -= (*c&0x3fff)+1;
+          c++;
+        }
+
+        if (skipRem)
+          printf("\t\tSkip sequences disagree %d @ %ld\n", skipRem, s-s_beg);
+
+        if (*s != *c) {
+          printf("\t\t\tfex[%04x] cmp[%04x] @ %ld\n",
+                 *s, *c, s-s_beg);
+          lErr=true;
+        }
+      }
+
+      if (lErr) {
+        for(unsigned i=0; i<=(s_end-s_beg); i+=4) {
+          printf("\t\t%04x %04x %04x %04x   %04x %04x %04x %04x  [%u]\n",
+                 s_beg[i+0],s_beg[i+1],s_beg[i+2],s_beg[i+3],
+                 compr[i+0],compr[i+1],compr[i+2],compr[i+3], i);
+        }
+      }
+    }
+#endif
+  }
+}
+
+static void process(const uint32_t* event, unsigned words, unsigned index, void* arg)
+{
+  Sim& sim = *reinterpret_cast<Sim*>(arg);
+  if (words < 8) {
+    sim.truncated++;
+    return;
+  }
+  sim.events++;
+  sim.bytes += words*sizeof(uint32_t);
+
+  if (sim.print)
+    dump(event, words);
+
+  if (sim.writer) {
+    IndexEntry entry;
+    entry.fill(event, words*sizeof(uint32_t));
+    entry.lane = 0;
+    sim.writer->write(event, 8*sizeof(uint32_t),
+                      event+8, (words-8)*sizeof(uint32_t), &entry);
+  }
 }
 
 int main(int argc, char** argv) {
@@ -72,18 +220,36 @@ int main(int argc, char** argv) {
   int c;
   bool lUsage = false;
   const char* fname = 0;
-  unsigned FMIN=0x41, FMAX=0x3bf;
+  const char* oname = 0;
+  unsigned nthreads = 4;
+  Sim sim;
+  sim.writer    = 0;
+  sim.print     = true;
+  sim.FMIN      = 0x41;
+  sim.FMAX      = 0x3bf;
+  sim.events    = 0;
+  sim.truncated = 0;
+  sim.bytes     = 0;
 
-  while ( (c=getopt( argc, argv, "f:m:M:h")) != EOF ) {
+  while ( (c=getopt( argc, argv, "f:o:j:qm:M:h")) != EOF ) {
     switch(c) {
     case 'f':
       fname = optarg;
       break;
+    case 'o':
+      oname = optarg;
+      break;
+    case 'j':
+      nthreads = strtoul(optarg,&endptr,0);
+      break;
+    case 'q':
+      sim.print = false;
+      break;
     case 'm':
-      FMIN = strtoul(optarg,&endptr,0);
+      sim.FMIN = strtoul(optarg,&endptr,0);
       break;
     case 'M':
-      FMAX = strtoul(optarg,&endptr,0);
+      sim.FMAX = strtoul(optarg,&endptr,0);
       break;
     case '?':
     default:
@@ -92,135 +258,45 @@ int main(int argc, char** argv) {
     }
   }
 
-  if(FMIN < FMAX){}; // REDUNDANT LINE IS ADDED TO GET RID OF COMPILER WARNINGS ABOUT NOT USED FMIN, FMAX
-
-  if (lUsage) {
+  if (lUsage || !fname) {
     usage(argv[0]);
     exit(1);
   }
 
-  FILE* f = fopen(fname,"r");
-  if (!f) {
-    perror("Unable to open input file");
+  SimDump file;
+  if (!file.open(fname))
     return -1;
-  }
-
-  uint32_t* event = new uint32_t[0x100000];
 
-  const unsigned linesz = 40960;
-  char* line = new char[linesz];
-
-  while(1) {  // event loop
-    if ( !fgets(line, linesz, f) )
-      break;
-
-    uint32_t* u = event;
-    char* p = line;
-    while(*p) {
-      *u++ = strtoul(p,&endptr,16);
-      p = endptr+1;
+  if (oname) {
+    sim.writer = new Recorder(oname);
+    sim.writer->index(true);
+    if (!sim.writer->open()) {
+      perror("Unable to open output file");
+      return -1;
     }
+  }
 
-    printf("Event: %08x.%08x %08x.%08x\n",
-           event[0], event[1], event[2], event[3]);
-
-    unsigned streams = (event[6]>>20)&0xf;
-
-    Stream* strm = new (&event[8]) Stream;
-
-    while(streams) {
-      strm->dump();
-
-      streams &= ~(1<<strm->alg);
-      strm = strm->next();
-
-#if 0
-      const uint16_t* s = reinterpret_cast<const uint16_t*>(&event[12]);
-      uint16_t* c = compr;
-      int toffs=-1;
-      { 
-        const uint16_t* s_beg = s + (f[1]&0xff);
-        const uint16_t* s_end = s + (f[0]-8)+((f[1]>>8)&0xff)-1;
-        printf("\tRaw: %08x.%08x.%08x.%08x\n", f[0], f[1], f[2], f[3]);
-        printf("\t\t%04x.%04x [%ld]\n",*s_beg,*s_end,(s_end-s_beg)+1);
-
-        //  Compress the raw data
-        int skip=-1;
-        for(const uint16_t* q = s_beg; q<=s_end; q++) {
-          if (*q < FMIN || *q > FMAX) {
-            if (toffs<0)
-              toffs = q-s_beg;
-            if (skip>=0) {
-              *c++ = 0x8000 | (skip&0x3fff);
-              skip = -1;
-            }
-            *c++ = *q;
-          }
-          else if (toffs>=0) {
-            skip++;
-          }
-        }
-      }
-
-      s += event[8];
-      f = reinterpret_cast<const uint32_t*>(s);
-      printf("\tFex: %08x.%08x.%08x.%08x\n", f[0], f[1], f[2], f[3]);
-
-      if (f[0]) {
-        s += 8; // skip header
-        const uint16_t* s_beg = s + (f[1]&0xff);
-        const uint16_t* s_end = s + (f[0]-8)+((f[1]>>8)&0xff)-1;
-        uint16_t fex_beg = *s_beg;
-        uint16_t fex_end = *s_end;
-        printf("\t\t%04x.%04x [%ld]\n", fex_beg, fex_end, (s_end-s_beg)+1);
-      
-        //  Compare the header
-        if (unsigned(toffs) != f[2])
-          printf("\t\t\ttoffs[%u]  header[%u]\n", toffs, f[2]);
-
-        if (unsigned(c-compr) != s_end-s_beg+1) 
-          printf("\t\t\tfexl[%ld] cmpl[%ld]\n",
-                 s_end-s_beg+1, c-compr );
-
-        //  Compare the words
-        bool lErr=false;
-        c = compr;
-        int skipRem = 0;
-        for(s = s_beg; s <= s_end; s++, c++) {
-          //  handle consecutive skip characters carefully
-          while ((*s>>15)==1) {
-            skipRem += (*s&0x3fff)+1;
-            s++;
-            if (s >= s_end)
-              break;
-          }
-
-          while ((*c>>15)==1) {
-            skipRem -= (*c&0x3fff)+1;
-            c++;
-          }
-
-          if (skipRem)
-            printf("\t\tSkip sequences disagree %d @ %ld\n", skipRem, s-s_beg);
+  timespec tv_begin, tv_end;
+  clock_gettime(CLOCK_MONOTONIC, &tv_begin);
+  file.read(process, &sim, nthreads);
+  if (sim.writer)
+    sim.writer->close();
+  clock_gettime(CLOCK_MONOTONIC, &tv_end);
 
-          if (*s != *c) {
-            printf("\t\t\tfex[%04x] cmp[%04x] @ %ld\n",
-                   *s, *c, s-s_beg);
-            lErr=true;
-          }
-        }
-
-        if (lErr) {
-          for(unsigned i=0; i<=(s_end-s_beg); i+=4) {
-            printf("\t\t%04x %04x %04x %04x   %04x %04x %04x %04x  [%u]\n",
-                   s_beg[i+0],s_beg[i+1],s_beg[i+2],s_beg[i+3],
-                   compr[i+0],compr[i+1],compr[i+2],compr[i+3], i);
-          }
-        }
-      }
-#endif
-    }
+  double dt = double(tv_end.tv_sec - tv_begin.tv_sec) +
+    1.e-9*(double(tv_end.tv_nsec) - double(tv_begin.tv_nsec));
+  printf("%s: %u events  %llu bytes  in %.3f s :  %.1f MB/s of text\n",
+         fname, sim.events, (unsigned long long)sim.bytes, dt,
+         dt > 0 ? 1.e-6*double(file.bytes())/dt : 0.);
+  if (sim.truncated)
+    printf("%u events shorter than the event header skipped\n", sim.truncated);
+  if (file.malformed())
+    printf("%u malformed lines skipped, the first at line %llu\n",
+           file.malformed(), (unsigned long long)file.firstMalformed());
+  if (sim.writer) {
+    sim.writer->dump();
+    delete sim.writer;
   }
 
-  return 1;
+  return (file.malformed() || sim.truncated) ? 1 : 0;
 }
@@ -0,0 +1,358 @@
+/**
+ **  Regenerate the sparsified stream of a recording from its raw
+ **  interleave: diff against the recorded stream 3, or sweep the
+ **  thresholds to predict the compression
+ **/
+
+#include "RecordFile.hh"
+#include "Sparsifier.hh"
+#include "BaselineCorr.hh"
+#include "Event.hh"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+using Pds::HSD::RecordFile;
+using Pds::HSD::Sparsifier;
+using Pds::HSD::BaselineCorr;
+using Pds::HSD::EventHeader;
+using Pds::HSD::StreamHeader;
+using Pds::HSD::StreamIndex;
+using Pds::HSD::Simd;
+
+void usage(const char* p) {
+  printf("Usage: %s -f <file> [options]\n",p);
+  printf("Options: -t <lo,hi>        sparsification thresholds [Default: 0x3f00,0x4100]\n");
+  printf("         -w <pre,post>     super-samples kept before/after a crossing [Default: 2,2]\n");
+  printf("         -c <baseline>     baseline of the correction applied to stream 2, from the corrections heading stream 3 [Default: 0x4000]\n");
+  printf("         -u                uncorrected stream 2, as firmware without the corrector (thresholds in ADC units)\n");
+  printf("         -S <step,n>       sweep n bands, each widened by step on both sides\n");
+  printf("         -p <phase>        gate phase in its row for the sweep [Default: 0]\n");
+  printf("         -j <threads>      [Default: 4]\n");
+  printf("         -N <events>       stop after this many events\n");
+  printf("         -n <mismatches>   mismatches to print [Default: 10]\n");
+  printf("         -s <isa>          scalar, sse4.2 or avx2 [Default: best supported]\n");
+}
+
+//
+//  Per thread models and counts.  The diff uses the first model only;
+//  the sweep has one per band.
+//
+class Task {
+public:
+  std::vector<Sparsifier*> models;
+  std::vector<uint16_t>    out;
+  std::vector<uint16_t>    gate;       // corrected stream 2
+  std::vector<uint64_t>    words;      // per band
+  std::vector<unsigned>    mismatch;   // events, the first few
+  uint64_t                 events;
+  uint64_t                 samples;
+  uint64_t                 matched;
+  uint64_t                 mismatched;
+  uint64_t                 unchecked;
+  uint64_t                 phases[Sparsifier::RowSize];
+  unsigned                 phase;      // of the last match
+};
+
+class Job {
+public:
+  std::vector<Task> tasks;
+  bool              sweep;
+  int               baseline;   // of the correction, -1 for none
+  unsigned          phase;
+  unsigned          nprint;
+};
+
+static void diff(const EventHeader& event, unsigned size, unsigned index,
+                 unsigned thread, void* arg)
+{
+  Job&  job  = *reinterpret_cast<Job*>(arg);
+  Task& task = job.tasks[thread];
+  StreamIndex streams(&event, size);
+  const StreamHeader* raw = streams.valid() ? streams.stream(2) : 0;
+  const StreamHeader* fex = streams.valid() ? streams.stream(3) : 0;
+  task.events++;
+  if (!raw || !fex) {
+    task.unchecked++;
+    return;
+  }
+  const uint16_t* x = raw->data();
+  if (job.baseline >= 0) {
+    if (raw->samples() < BaselineCorr::Ilv || fex->samples() < BaselineCorr::Ilv ||
+        (fex->data()[0] & 0x8000)) {
+      task.unchecked++;
+      return;
+    }
+    uint16_t corr[BaselineCorr::Ilv];
+    BaselineCorr::corrections(fex->data(), corr);
+    task.gate.resize(raw->samples());
+    BaselineCorr::gate(x, raw->samples(), corr, job.baseline, task.gate.data());
+    x = task.gate.data();
+  }
+  int p = task.models[0]->match(x, raw->samples(),
+                                fex->data(), fex->samples(), task.phase);
+  if (p < 0) {
+    task.mismatched++;
+    if (task.mismatch.size() < job.nprint)
+      task.mismatch.push_back(index);
+  }
+  else {
+    task.matched++;
+    task.phases[p]++;
+    task.phase = p;
+  }
+}
+
+static void sweep(const EventHeader& event, unsigned size, unsigned,
+                  unsigned thread, void* arg)
+{
+  Job&  job  = *reinterpret_cast<Job*>(arg);
+  Task& task = job.tasks[thread];
+  StreamIndex streams(&event, size);
+  const StreamHeader* raw = streams.valid() ? streams.stream(2) : 0;
+  const StreamHeader* fex = streams.valid() ? streams.stream(3) : 0;
+  task.events++;
+  if (!raw || raw->samples() % Sparsifier::Ilv) {
+    task.unchecked++;
+    return;
+  }
+  const uint16_t* x = raw->data();
+  if (job.baseline >= 0) {
+    if (!fex || fex->samples() < BaselineCorr::Ilv || (fex->data()[0] & 0x8000)) {
+      task.unchecked++;
+      return;
+    }
+    uint16_t corr[BaselineCorr::Ilv];
+    BaselineCorr::corrections(fex->data(), corr);
+    task.gate.resize(raw->samples());
+    BaselineCorr::gate(x, raw->samples(), corr, job.baseline, task.gate.data());
+    x = task.gate.data();
+  }
+  for(unsigned i=0; i<task.models.size(); i++) {
+    task.out.clear();
+    task.words[i] += task.models[i]->stream(x, raw->samples(), job.phase, task.out);
+  }
+  task.samples += raw->samples();
+}
+
+//
+//  The phase whose output agrees longest with the recorded stream
+//
+static void explain(const RecordFile& file, unsigned i, Sparsifier& model, int baseline)
+{
+  StreamIndex streams(&file.event(i), file.size(i));
+  const StreamHeader* raw = streams.stream(2);
+  const StreamHeader* fex = streams.stream(3);
+  const uint16_t* f = fex->data();
+  unsigned nf = fex->samples();
+
+  std::vector<uint16_t> gate(raw->data(), raw->data()+raw->samples());
+  if (baseline >= 0) {
+    uint16_t corr[BaselineCorr::Ilv];
+    BaselineCorr::corrections(f, corr);
+    BaselineCorr::gate(raw->data(), raw->samples(), corr, baseline, gate.data());
+  }
+
+  std::vector<uint16_t> out;
+  unsigned best = 0, bestPhase = 0, bestWords = 0;
+  int      bestN = -1;
+  for(unsigned p=0; p<Sparsifier::RowSize; p++) {
+    out.clear();
+    int n = model.stream(gate.data(), gate.size(), p, out);
+    unsigned k=0;
+    while(k < out.size() && k < nf && out[k]==f[k])
+      k++;
+    if (bestN < 0 || k > best) {
+      best      = k;
+      bestN     = n;
+      bestPhase = p;
+      bestWords = out.size();
+    }
+  }
+
+  printf("event %u: stream 3 %u words, model %d words (phase %u), ",
+         i, nf, bestN, bestPhase);
+  out.clear();
+  model.stream(gate.data(), gate.size(), bestPhase, out);
+  if (best < nf && best < bestWords)
+    printf("first difference at word %u (%04x/%04x)\n", best, f[best], out[best]);
+  else
+    printf("agree over %u words\n", best);
+}
+
+static double seconds(const timespec& t0, const timespec& t1)
+{
+  return double(t1.tv_sec - t0.tv_sec) + 1.e-9*(double(t1.tv_nsec)-double(t0.tv_nsec));
+}
+
+int main(int argc, char** argv) {
+
+  extern char* optarg;
+  char* endptr;
+
+  int c;
+  bool lUsage = false;
+  const char* fname    = 0;
+  unsigned    lo       = 0x3f00;
+  unsigned    hi       = 0x4100;
+  unsigned    tpre     = 2;
+  unsigned    tpost    = 2;
+  unsigned    step     = 0;
+  unsigned    nbands   = 0;
+  unsigned    phase    = 0;
+  unsigned    nthreads = 4;
+  unsigned    nevents  = unsigned(-1);
+  unsigned    nprint   = 10;
+  int         baseline = BaselineCorr::Config().baseline;
+  const char* isa      = 0;
+
+  while ( (c=getopt( argc, argv, "f:t:w:c:uS:p:j:N:n:s:h")) != EOF ) {
+    switch(c) {
+    case 'f': fname    = optarg; break;
+    case 'p': phase    = strtoul(optarg,NULL,0); break;
+    case 'j': nthreads = strtoul(optarg,NULL,0); break;
+    case 'N': nevents  = strtoul(optarg,NULL,0); break;
+    case 'n': nprint   = strtoul(optarg,NULL,0); break;
+    case 's': isa      = optarg; break;
+    case 'c': baseline = strtoul(optarg,NULL,0); break;
+    case 'u': baseline = -1; break;
+    case 't':
+      lo = strtoul(optarg,&endptr,0);
+      if (*endptr!=',')
+        lUsage = true;
+      else
+        hi = strtoul(endptr+1,NULL,0);
+      break;
+    case 'w':
+      tpre = strtoul(optarg,&endptr,0);
+      if (*endptr!=',')
+        lUsage = true;
+      else
+        tpost = strtoul(endptr+1,NULL,0);
+      break;
+    case 'S':
+      step = strtoul(optarg,&endptr,0);
+      if (*endptr!=',')
+        lUsage = true;
+      else
+        nbands = strtoul(endptr+1,NULL,0);
+      break;
+    case 'h':
+    default:
+      lUsage = true;
+      break;
+    }
+  }
+
+  if (lUsage || !fname || phase >= Sparsifier::RowSize) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  if (isa) {
+    unsigned v;
+    for(v=0; v<Simd::NumberOf; v++)
+      if (!strcmp(isa, Simd::name(Simd::Isa(v))))
+        break;
+    if (v==Simd::NumberOf || !Sparsifier::select(Simd::Isa(v))) {
+      printf("Instruction set %s not supported\n", isa);
+      return -1;
+    }
+  }
+
+  RecordFile file;
+  if (!file.open(fname))
+    return -1;
+
+  Job job;
+  job.sweep    = nbands > 0;
+  job.baseline = baseline;
+  job.phase  = phase;
+  job.nprint = nprint;
+  if (!nthreads)
+    nthreads = 1;
+  job.tasks.resize(nthreads);
+  unsigned nmodels = job.sweep ? nbands : 1;
+  for(unsigned t=0; t<nthreads; t++) {
+    Task& task = job.tasks[t];
+    for(unsigned i=0; i<nmodels; i++) {
+      unsigned w = i*step;
+      Sparsifier::Config cfg(lo > w ? lo-w : 0, hi+w, tpre, tpost);
+      task.models.push_back(new Sparsifier(cfg));
+    }
+    task.words.assign(nmodels, 0);
+    task.events = task.samples = task.matched = task.mismatched = task.unchecked = 0;
+    memset(task.phases, 0, sizeof(task.phases));
+    task.phase = 0;
+  }
+
+  const Sparsifier::Config& cfg = job.tasks[0].models[0]->config();
+  printf("%s: %u events  lo 0x%x  hi 0x%x  pre %u  post %u  %s\n",
+         fname, file.events(), cfg.xlo, cfg.xhi, cfg.tpre, cfg.tpost,
+         Simd::name(Sparsifier::isa()));
+
+  timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  file.parallel_for(job.sweep ? sweep : diff, &job, nthreads, 0, nevents);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  Task sum;
+  sum.words.assign(nmodels, 0);
+  sum.events = sum.samples = sum.matched = sum.mismatched = sum.unchecked = 0;
+  memset(sum.phases, 0, sizeof(sum.phases));
+  for(unsigned t=0; t<nthreads; t++) {
+    const Task& task = job.tasks[t];
+    for(unsigned i=0; i<nmodels; i++)
+      sum.words[i] += task.words[i];
+    sum.events     += task.events;
+    sum.samples    += task.samples;
+    sum.matched    += task.matched;
+    sum.mismatched += task.mismatched;
+    sum.unchecked  += task.unchecked;
+    for(unsigned p=0; p<Sparsifier::RowSize; p++)
+      sum.phases[p] += task.phases[p];
+    sum.mismatch.insert(sum.mismatch.end(), task.mismatch.begin(), task.mismatch.end());
+  }
+  std::sort(sum.mismatch.begin(), sum.mismatch.end());
+
+  double dt = seconds(t0, t1);
+  if (job.sweep) {
+    //  Words of stream 3 per sample of stream 2
+    printf("%8.8s %8.8s %14.14s %10.10s %8.8s\n", "lo", "hi", "words", "words/evt", "ratio");
+    uint64_t n = sum.events - sum.unchecked;
+    for(unsigned i=0; i<nmodels; i++) {
+      const Sparsifier::Config& c = job.tasks[0].models[i]->config();
+      printf("%8x %8x %14llu %10.1f %8.4f\n", c.xlo, c.xhi,
+             (unsigned long long)sum.words[i],
+             n ? double(sum.words[i])/double(n) : 0.,
+             sum.samples ? double(sum.words[i])/double(sum.samples) : 0.);
+    }
+    printf("unchecked %llu\n", (unsigned long long)sum.unchecked);
+  }
+  else {
+    printf("matched %llu  mismatched %llu  unchecked %llu\n",
+           (unsigned long long)sum.matched,
+           (unsigned long long)sum.mismatched,
+           (unsigned long long)sum.unchecked);
+    printf("phase  ");
+    for(unsigned p=0; p<Sparsifier::RowSize; p++)
+      printf(" %8llu", (unsigned long long)sum.phases[p]);
+    printf("\n");
+    for(unsigned i=0; i<sum.mismatch.size() && i<nprint; i++)
+      explain(file, sum.mismatch[i], *job.tasks[0].models[0], baseline);
+  }
+  printf("%llu events in %.3f s :  %.1f events/s\n",
+         (unsigned long long)sum.events, dt, dt > 0 ? double(sum.events)/dt : 0.);
+
+  for(unsigned t=0; t<nthreads; t++)
+    for(unsigned i=0; i<nmodels; i++)
+      delete job.tasks[t].models[i];
+
+  return sum.mismatched ? 1 : 0;
+}
@@ -6,6 +6,7 @@
 #include <poll.h>
 #include "psdaq/hsd/Validator.hh"
 #include "DataDriver.h"
+#include "DmaSource.hh"
 #include "xtcdata/xtc/Dgram.hh"
 
 static FILE* f = 0;
@@ -39,7 +40,7 @@ static void* diagnostics(void*)
 static void show_usage(const char* p)
 {
   printf("Usage: %s [options]\n",p);
-  printf("Options: -d <device>\n");
+  printf("Options: -d <device>  (emu[:options] for the software emulator)\n");
   printf("         -f <output file>\n");
   printf("         -s <nskip> (analyze 1, skip n, ..)\n");
   printf("         -w <wait us>\n");
@@ -116,23 +117,24 @@ int main(int argc, char* argv[])
     }
   }
 
-  char err[256];
-  int fd = open( pgpcard,  O_RDWR );
-  if (fd < 0) {
-    sprintf(err, "%s opening %s failed", argv[0], pgpcard);
-    perror(err);
+  Pds::HSD::DmaSource* src = Pds::HSD::DmaSource::open(pgpcard);
+  if (!src) {
+    printf("%s opening %s failed\n", argv[0], pgpcard);
     return 1;
   }
+  int fd = src->fd();
 
-  uint8_t mask[DMA_MASK_SIZE];
-  dmaInitMaskBytes(mask);
-  for(unsigned i=0; i<8; i++)
-    if (lanem & (1<<i))
-      dmaAddMaskBytes(mask, dmaDest(i,0));
+  if (src->device()) {
+    uint8_t mask[DMA_MASK_SIZE];
+    dmaInitMaskBytes(mask);
+    for(unsigned i=0; i<8; i++)
+      if (lanem & (1<<i))
+        dmaAddMaskBytes(mask, dmaDest(i,0));
 
-  if (ioctl(fd, DMA_Set_MaskBytes, mask)<0) {
-    perror("DMA_Set_MaskBytes");
-    return -1;
+    if (ioctl(fd, DMA_Set_MaskBytes, mask)<0) {
+      perror("DMA_Set_MaskBytes");
+      return -1;
+    }
   }
 
   Validator& val = l134 ? 
@@ -144,9 +146,9 @@ int main(int argc, char* argv[])
   int32_t  dmaRet  [MAX_CNT];
   uint32_t dmaIndex[MAX_CNT];
   uint32_t rxFlags [MAX_CNT];
-  unsigned dmaCount, dmaSize;
+  uint32_t dmaCount, dmaSize;
   void**   dmaBuffers;
-  if ( (dmaBuffers = dmaMapDma(fd,&dmaCount,&dmaSize)) == NULL ) {
+  if ( (dmaBuffers = src->map(&dmaCount,&dmaSize)) == NULL ) {
     printf("Failed to map dma buffers\n");
     return -1;
   }
@@ -166,7 +168,7 @@ int main(int argc, char* argv[])
       return -1;
     }
 
-    int bret = dmaReadBulkIndex(fd,getCnt,dmaRet,dmaIndex,rxFlags,NULL,NULL);
+    int bret = src->readBulk(getCnt,dmaRet,dmaIndex,rxFlags,NULL,NULL);
 
     for(int idg=0; idg<bret; idg++) {
 
@@ -203,7 +205,7 @@ int main(int argc, char* argv[])
     }
 
     if (bret>0)
-      dmaRetIndexes(fd,bret,dmaIndex);
+      src->release(bret,dmaIndex);
 
   } while (1);
 
@@ -227,11 +227,13 @@ ssize_t PcieAdc_Read(struct file *filp, char *buffer, size_t count, loff_t *f_po
     if (((struct PcieAdcReg*)adcDevice->minor.reg)->irqStatus & 1) 
       adcDevice->minor.irqFalse++;
 
-    if (wait_event_interruptible_timeout(adcDevice->inq,
-                                         test_rxpend(adcDevice),
-                                         HZ/1000)) {
-      return (-EAGAIN);
-    }
+    //  Sleep until the interrupt; the timeout (at least one jiffy,
+    //  HZ/1000 is zero for HZ<1000) only guards against a missed one.
+    ret = wait_event_interruptible_timeout(adcDevice->inq,
+                                           test_rxpend(adcDevice),
+                                           HZ/1000 ? HZ/1000 : 1);
+    if (ret < 0)
+      return ret;
   }
 
   desc = (struct RxDesc*)rxn->buffer;